@@ -11,26 +11,127 @@ start:
     mov sp, 0x7C00
     sti
     
+    ; Start from an all-zero BootInfo (AX is still 0)
+    cld
+    mov di, BOOT_INFO
+    mov cx, BOOT_INFO_SIZE
+    rep stosb
+    
+    ; Boot timing starts here; the kernel reports it
+    rdtsc
+    mov [BOOT_INFO_TSC_BOOT], eax
+    mov [BOOT_INFO_TSC_BOOT + 4], edx
+    
     ; Print start message
     mov si, msg_start
     call print
-
-    xor ax, ax
-    mov dl, 0x80        
-    int 0x13
-    jc disk_error
     
-    mov ah, 0x02        
-    mov al, 32          
-    mov cx, 0x0002      
-    mov dh, 0x00        
-    mov dl, 0x80        
-    mov bx, 0x1000      
-    int 0x13
+    ; Kernel header (LBA 1): load address, length and checksum
+    call read_sectors
+    cmp dword [HEADER], KERNEL_MAGIC
+    jne bad_kernel
     
-    jc disk_error
-    mov si, msg_loaded
-    call print
+    ; Enable A20 (fast gate) so the kernel can be copied above 1 MB
+    in al, 0x92
+    or al, 2
+    and al, 0xFE                ; Bit 0 would reset the machine
+    out 0x92, al
+    
+    ; Load the image in CHUNK_SECTORS pieces through a bounce buffer
+    ; below 64 KB, summing it on the way, and copy each piece to its
+    ; 32-bit destination from unreal mode
+    lgdt [gdt_descriptor]
+    mov dword [dap_buffer], BOUNCE  ; Offset BOUNCE, segment 0
+    inc dword [dap_lba]
+    mov edi, [HEADER + 4]       ; Destination
+    mov ebp, [HEADER + 8]       ; Sectors left
+    xor edx, edx                ; Checksum
+.load:
+    mov eax, CHUNK_SECTORS
+    cmp ebp, eax
+    jae .chunk
+    mov eax, ebp
+.chunk:
+    mov [dap_count], ax
+    call read_sectors
+    
+    ; Unreal mode: reload ES in protected mode for a 4 GB limit, which
+    ; it keeps back in real mode. Redone per chunk because the BIOS may
+    ; reset segment limits.
+    cli
+    mov eax, cr0
+    or al, 1
+    mov cr0, eax
+    push DATA_SEG
+    pop es
+    and al, 0xFE
+    mov cr0, eax
+    push ds
+    pop es
+    
+    mov cx, [dap_count]
+    shl cx, 7                   ; Dwords
+    mov si, BOUNCE
+.copy:
+    lodsd
+    add edx, eax
+    a32 stosd
+    loop .copy
+    sti
+    
+    movzx eax, word [dap_count]
+    add [dap_lba], eax
+    sub ebp, eax
+    jnz .load
+    
+    cmp edx, [HEADER + 12]
+    jne bad_kernel
+    
+    mov eax, [HEADER + 16]
+    mov [BOOT_INFO_KERNEL_SIZE], eax
+    rdtsc
+    mov [BOOT_INFO_TSC_LOADED], eax
+    mov [BOOT_INFO_TSC_LOADED + 4], edx
+    
+    ; Collect the BIOS memory map (int 15h EAX=E820h) for the kernel's
+    ; page allocator. ES:DI walks the BootInfo entry array.
+    mov di, BOOT_INFO_E820
+    xor ebx, ebx
+    xor ebp, ebp                ; Entries stored
+.e820_next:
+    mov eax, 0xE820
+    mov edx, 0x534D4150         ; 'SMAP'
+    mov ecx, 24
+    mov dword [di + 20], 1      ; ACPI 3.0 attributes: valid unless the BIOS says otherwise
+    int 0x15
+    jc .e820_done               ; Unsupported, or past the last entry
+    cmp eax, 0x534D4150
+    jne .e820_done
+    jcxz .e820_skip             ; Empty entry
+    inc ebp
+    add di, 24
+    cmp ebp, E820_MAX
+    je .e820_done
+.e820_skip:
+    test ebx, ebx
+    jnz .e820_next
+.e820_done:
+    mov [BOOT_INFO_E820_COUNT], ebp
+    
+%ifdef VIN_FB
+    ; Framebuffer build: hand the kernel the ROM 8x8 font, then mode 13h
+    mov ax, 0x1130
+    mov bh, 0x03        ; 8x8 font, characters 0-127 -> ES:BP
+    int 0x10
+    xor eax, eax
+    mov ax, es
+    shl eax, 4
+    movzx ebx, bp
+    add eax, ebx
+    mov [BOOT_INFO_FONT], eax
+    mov ax, 0x0013
+    int 0x10
+%endif
     
     cli
     lgdt [gdt_descriptor]
@@ -41,13 +142,28 @@ start:
     
     jmp CODE_SEG:init_pm
 
+bad_kernel:
+    mov si, msg_bad
+    jmp halt
 disk_error:
     mov si, msg_error
+halt:
     call print
 .hang:
     hlt
     jmp .hang
 
+; Read with the disk address packet below, DAP values in place
+read_sectors:
+    pushad
+    mov ah, 0x42
+    mov dl, 0x80
+    mov si, kernel_dap
+    int 0x13
+    jc disk_error
+    popad
+    ret
+
 print:
     pusha
     mov ah, 0x0E
@@ -90,6 +206,17 @@ gdt_descriptor:
     dd gdt_start
 
 CODE_SEG equ gdt_code - gdt_start
+
+; BootInfo block for the kernel (kernel/include/bootinfo.h)
+BOOT_INFO equ 0x0500
+BOOT_INFO_FONT equ BOOT_INFO + 0
+BOOT_INFO_E820_COUNT equ BOOT_INFO + 4
+BOOT_INFO_E820 equ BOOT_INFO + 8     ; 24-byte entries
+E820_MAX equ 32
+BOOT_INFO_TSC_BOOT equ BOOT_INFO_E820 + E820_MAX * 24
+BOOT_INFO_TSC_LOADED equ BOOT_INFO_TSC_BOOT + 8
+BOOT_INFO_KERNEL_SIZE equ BOOT_INFO_TSC_LOADED + 8
+BOOT_INFO_SIZE equ BOOT_INFO_KERNEL_SIZE + 4 + 6 * 4 - BOOT_INFO
 DATA_SEG equ gdt_data - gdt_start
 
 [bits 32]
@@ -104,12 +231,29 @@ init_pm:
     mov ebp, 0x90000
     mov esp, ebp
     
-    jmp 0x1000
+    mov ebx, BOOT_INFO          ; kernel_main(BootInfo*)
+    jmp [HEADER + 4]
 
 [bits 16]
+; Disk address packet for int 13h AH=42h, first set up for the header
+kernel_dap:
+    db 0x10, 0
+dap_count:
+    dw 1
+dap_buffer:
+    dw HEADER, 0                    ; offset, segment
+dap_lba:
+    dq 1                            ; Header right after the boot sector
+
+; Kernel header sector (kernel/include/bootinfo.h, tools/mkkernel.c)
+HEADER equ 0x7E00
+KERNEL_MAGIC equ 0x4B4E4956         ; 'VINK'
+BOUNCE equ 0x8000
+CHUNK_SECTORS equ 64                ; 32 KB, up to the kernel at 0x10000
+
 msg_start: db 'VIN OS Boot', 13, 10, 0
-msg_loaded: db 'Loaded', 13, 10, 0
 msg_error: db 'Disk Error!', 13, 10, 0
+msg_bad: db 'Bad kernel', 13, 10, 0
 
 times 510-($-$$) db 0
 dw 0xAA55
\ No newline at end of file
@@ -3,107 +3,104 @@
 #include "include/window.h"
 #include "include/keyboard.h"
 #include "include/filesystem.h"
+#include "include/bcache.h"
+#include "include/heap.h"
+#include "include/paging.h"
+#include "include/timer.h"
+#include "include/vga.h"
+#include "include/kernel.h"
+#include "include/sched.h"
+#include "include/string.h"
+#ifdef VIN_FB
+#include "include/fb.h"
+#endif
 
-#define VGA_COLOR(fg, bg) ((bg << 4) | fg)
+#define REDRAW_FRAMES 200
 
-static Calculator calculators[5];
-static Notepad notepads[5];
-static Terminal terminals[5];
-static FileManager filemanagers[5];
+// One slab cache per app type; the counts are live instances, used to
+// cascade new windows
+static KmemCache calculator_cache;
+static KmemCache notepad_cache;
+static KmemCache terminal_cache;
+static KmemCache filemanager_cache;
 static int calc_count = 0;
 static int notepad_count = 0;
 static int terminal_count = 0;
 static int fm_count = 0;
 
-static void str_copy(char* dest, const char* src, int max_len) {
-    int i = 0;
-    while (src[i] != '\0' && i < max_len - 1) {
-        dest[i] = src[i];
-        i++;
-    }
-    dest[i] = '\0';
-}
-
-static int str_len(const char* str) {
-    int len = 0;
-    while (str[len] != '\0') len++;
-    return len;
-}
+static void filemanager_refresh(FileManager* fm);
+static void terminal_write(void* ctx, const char* data, uint32_t len);
+static void terminal_clear(void* ctx);
+static void register_terminal_commands(void);
 
 void init_apps(void) {
+    kmem_cache_init(&calculator_cache, "calculator", sizeof(Calculator));
+    kmem_cache_init(&notepad_cache, "notepad", sizeof(Notepad));
+    kmem_cache_init(&terminal_cache, "terminal", sizeof(Terminal));
+    kmem_cache_init(&filemanager_cache, "filemanager", sizeof(FileManager));
+    
     calc_count = 0;
     notepad_count = 0;
     terminal_count = 0;
     fm_count = 0;
     
-    // Initialize all instances
-    for (int i = 0; i < 5; i++) {
-        calculators[i].window_id = -1;
-        notepads[i].window_id = -1;
-        terminals[i].window_id = -1;
-        filemanagers[i].window_id = -1;
-    }
+    register_terminal_commands();
 }
 
-// Instance getters
-Calculator* get_calculator_instance(void) {
-    if (calc_count >= 5) return 0;
-    return &calculators[calc_count];
+static void destroy_calculator(void* app) {
+    kmem_cache_free(&calculator_cache, app);
+    calc_count--;
 }
 
-Notepad* get_notepad_instance(void) {
-    if (notepad_count >= 5) return 0;
-    return &notepads[notepad_count];
+static void destroy_notepad(void* app) {
+    text_free(&((Notepad*)app)->text);
+    kmem_cache_free(&notepad_cache, app);
+    notepad_count--;
 }
 
-Terminal* get_terminal_instance(void) {
-    if (terminal_count >= 5) return 0;
-    return &terminals[terminal_count];
+static void destroy_terminal(void* app) {
+    kfree(((Terminal*)app)->lines);
+    kmem_cache_free(&terminal_cache, app);
+    terminal_count--;
 }
 
-FileManager* get_filemanager_instance(void) {
-    if (fm_count >= 5) return 0;
-    return &filemanagers[fm_count];
+static void destroy_filemanager(void* app) {
+    FileManager* fm = (FileManager*)app;
+    for (int i = 0; i < fm->file_count; i++) {
+        fs_close(fm->handles[i]);
+    }
+    kmem_cache_free(&filemanager_cache, fm);
+    fm_count--;
 }
 
-// Simple integer to string conversion
-static void int_to_str(int num, char* str) {
-    if (num == 0) {
-        str[0] = '0';
-        str[1] = '\0';
-        return;
-    }
+// Full-screen repaints (compositor plus VGA copy) with the VGA window in
+// the given memory type; returns microseconds per frame. The caller holds
+// wm_lock, so no other thread draws in between.
+static uint32_t time_redraws(int cache_type) {
+    paging_set_vga_cache(cache_type);
     
-    int is_negative = 0;
-    if (num < 0) {
-        is_negative = 1;
-        num = -num;
+    uint32_t start = uptime_ms();
+    for (int i = 0; i < REDRAW_FRAMES; i++) {
+        wm_damage(0, 1, VGA_WIDTH, VGA_HEIGHT - 1);
+        draw_all_windows();
+        vga_invalidate();
+        vga_present();
     }
-    
-    char temp[20];
-    int i = 0;
-    while (num > 0) {
-        temp[i++] = '0' + (num % 10);
-        num /= 10;
-    }
-    
-    int j = 0;
-    if (is_negative) str[j++] = '-';
-    
-    while (i > 0) {
-        str[j++] = temp[--i];
-    }
-    str[j] = '\0';
+    return (uptime_ms() - start) * 1000 / REDRAW_FRAMES;
 }
 
-int launch_calculator(void) {
-    if (calc_count >= 5) return -1;
+static Calculator* launch_calculator(void) {
+    int offset = (calc_count % 5) * 2;
+    Calculator* calc = (Calculator*)kmem_cache_alloc(&calculator_cache);
+    if (calc == 0) return 0;
     
-    int win_id = create_window(10 + calc_count * 2, 5 + calc_count * 2, 
+    int win_id = create_window(10 + offset, 5 + offset,
                                28, 12, " Calculator ", VGA_COLOR(0, 15));
-    if (win_id < 0) return -1;
+    if (win_id < 0) {
+        kmem_cache_free(&calculator_cache, calc);
+        return 0;
+    }
     
-    Calculator* calc = &calculators[calc_count];
     calc->window_id = win_id;
     calc->display[0] = '0';
     calc->display[1] = '\0';
@@ -114,80 +111,110 @@ int launch_calculator(void) {
     calc->new_number = 1;
     
     calc_count++;
-    return win_id;
+    return calc;
 }
 
-int launch_notepad(void) {
-    if (notepad_count >= 5) return -1;
+static Notepad* launch_notepad(void) {
+    int offset = (notepad_count % 5) * 2;
+    Notepad* notepad = (Notepad*)kmem_cache_alloc(&notepad_cache);
+    if (notepad == 0) return 0;
     
-    int win_id = create_window(15 + notepad_count * 2, 8 + notepad_count * 2,
+    int win_id = create_window(15 + offset, 8 + offset,
                                50, 15, " Notepad ", VGA_COLOR(0, 11));
-    if (win_id < 0) return -1;
+    if (win_id < 0) {
+        kmem_cache_free(&notepad_cache, notepad);
+        return 0;
+    }
+    
+    if (text_init(&notepad->text) < 0) {
+        close_window(win_id);
+        kmem_cache_free(&notepad_cache, notepad);
+        return 0;
+    }
     
-    Notepad* notepad = &notepads[notepad_count];
     notepad->window_id = win_id;
-    notepad->line_count = 1;
-    notepad->current_line = 0;
-    notepad->cursor_pos = 0;
+    notepad->cursor = 0;
+    notepad->goal_column = 0;
+    notepad->top_line = 0;
+    notepad->left_column = 0;
+    notepad->dirty_from = 0;
+    notepad->dirty_to = 0;
+    notepad->shown = 0;
     notepad->has_filename = 0;
     notepad->save_mode = 0;
     notepad->save_cursor = 0;
     notepad->filename[0] = '\0';
     notepad->save_buffer[0] = '\0';
     
-    for (int i = 0; i < 20; i++) {
-        for (int j = 0; j < 60; j++) {
-            notepad->lines[i][j] = '\0';
-        }
-    }
-    
     notepad_count++;
-    return win_id;
+    return notepad;
 }
 
-int launch_terminal(void) {
-    if (terminal_count >= 5) return -1;
+static Terminal* launch_terminal(void) {
+    int offset = (terminal_count % 5) * 2;
+    Terminal* term = (Terminal*)kmem_cache_alloc(&terminal_cache);
+    if (term == 0) return 0;
     
-    int win_id = create_window(8 + terminal_count * 2, 4 + terminal_count * 2,
+    term->lines = (char (*)[TERMINAL_COLUMNS])kmalloc(TERMINAL_SCROLLBACK * TERMINAL_COLUMNS);
+    if (term->lines == 0) {
+        kmem_cache_free(&terminal_cache, term);
+        return 0;
+    }
+    
+    int win_id = create_window(8 + offset, 4 + offset,
                                60, 18, " VIN Terminal ", VGA_COLOR(15, 0));
-    if (win_id < 0) return -1;
+    if (win_id < 0) {
+        kfree(term->lines);
+        kmem_cache_free(&terminal_cache, term);
+        return 0;
+    }
     
-    Terminal* term = &terminals[terminal_count];
     term->window_id = win_id;
-    term->line_count = 0;
+    term->first_line = 0;
+    term->next_line = 0;
+    term->scroll = 0;
+    term->column = 0;
+    term->out.write = terminal_write;
+    term->out.clear = terminal_clear;
+    term->out.ctx = term;
     term->input_len = 0;
+    term->search_mode = 0;
+    term->search_len = 0;
+    term->match_found = 0;
+    term->shown = 0;
     
-    for (int i = 0; i < 18; i++) {
-        for (int j = 0; j < 60; j++) {
-            term->lines[i][j] = '\0';
-        }
-    }
     for (int i = 0; i < 60; i++) {
         term->input[i] = '\0';
     }
     
     terminal_count++;
-    return win_id;
+    return term;
 }
 
-int launch_filemanager(void) {
-    if (fm_count >= 5) return -1;
+static FileManager* launch_filemanager(void) {
+    int offset = (fm_count % 5) * 2;
+    FileManager* fm = (FileManager*)kmem_cache_alloc(&filemanager_cache);
+    if (fm == 0) return 0;
     
-    int win_id = create_window(12 + fm_count * 2, 6 + fm_count * 2,
+    int win_id = create_window(12 + offset, 6 + offset,
                                55, 18, " File Manager ", VGA_COLOR(15, 3));
-    if (win_id < 0) return -1;
+    if (win_id < 0) {
+        kmem_cache_free(&filemanager_cache, fm);
+        return 0;
+    }
     
-    FileManager* fm = &filemanagers[fm_count];
     fm->window_id = win_id;
     fm->selected_file = 0;
-    fm->file_count = fs_list_files(fm->filenames, 20);
+    fm->file_count = 0;
+    fm->generation = fs_generation() - 1;  // Force the first listing
+    filemanager_refresh(fm);
     
     fm_count++;
-    return win_id;
+    return fm;
 }
 
-void handle_calculator_key(Calculator* calc, uint8_t scancode) {
-    char c = scancode_to_char(scancode);
+static void handle_calculator_key(Calculator* calc, uint16_t scancode, uint8_t modifiers) {
+    char c = scancode_to_char(scancode, modifiers);
     
     if (c >= '0' && c <= '9') {
         if (calc->new_number) {
@@ -220,9 +247,7 @@ void handle_calculator_key(Calculator* calc, uint8_t scancode) {
         else if (calc->operation == '*') result = calc->value1 * calc->value2;
         else if (calc->operation == '/' && calc->value2 != 0) result = calc->value1 / calc->value2;
         
-        int_to_str(result, calc->display);
-        calc->display_len = 0;
-        while (calc->display[calc->display_len] != '\0') calc->display_len++;
+        calc->display_len = fmt_int(calc->display, result);
         calc->new_number = 1;
     }
     else if (c == 'c' || c == 'C') {
@@ -236,28 +261,92 @@ void handle_calculator_key(Calculator* calc, uint8_t scancode) {
     }
 }
 
-void handle_notepad_key(Notepad* notepad, uint8_t scancode) {
+static void notepad_save(Notepad* notepad) {
+    TextBuffer* text = &notepad->text;
+    uint32_t length = text_length(text);
+    fs_write_file(notepad->filename, text_contiguous(text), length);
+}
+
+// Column of the cursor in its line
+static uint32_t notepad_column(Notepad* notepad) {
+    uint32_t line = text_line_of(&notepad->text, notepad->cursor);
+    return notepad->cursor - text_line_start(&notepad->text, line);
+}
+
+// Cursor to the given line, as close to goal_column as it is long
+static void notepad_goto_line(Notepad* notepad, uint32_t line) {
+    TextBuffer* text = &notepad->text;
+    uint32_t last = text_line_count(text) - 1;
+    if (line > last) line = last;
+    
+    uint32_t column = notepad->goal_column;
+    uint32_t length = text_line_length(text, line);
+    if (column > length) column = length;
+    notepad->cursor = text_line_start(text, line) + column;
+}
+
+// Mark lines [from, to) for the next render
+static void notepad_dirty(Notepad* notepad, uint32_t from, uint32_t to) {
+    if (notepad->dirty_from >= notepad->dirty_to) {
+        notepad->dirty_from = from;
+        notepad->dirty_to = to;
+        return;
+    }
+    if (from < notepad->dirty_from) notepad->dirty_from = from;
+    if (to > notepad->dirty_to) notepad->dirty_to = to;
+}
+
+// Scroll the view so the cursor stays in it
+static void notepad_scroll(Notepad* notepad, uint32_t columns) {
+    uint32_t line = text_line_of(&notepad->text, notepad->cursor);
+    uint32_t column = notepad_column(notepad);
+    
+    if (line < notepad->top_line) notepad->top_line = line;
+    if (line >= notepad->top_line + NOTEPAD_ROWS) notepad->top_line = line - NOTEPAD_ROWS + 1;
+    if (column < notepad->left_column) notepad->left_column = column;
+    if (column >= notepad->left_column + columns) notepad->left_column = column - columns + 1;
+}
+
+// Cursor movement within a line and text changes
+static void handle_notepad_edit(Notepad* notepad, uint16_t scancode, char c, uint32_t line) {
+    TextBuffer* text = &notepad->text;
+    
+    if (scancode == KEY_LEFT && notepad->cursor > 0) {
+        notepad->cursor--;
+    }
+    else if (scancode == KEY_RIGHT && notepad->cursor < text_length(text)) {
+        notepad->cursor++;
+    }
+    else if (scancode == KEY_HOME) {
+        notepad->cursor = text_line_start(text, line);
+    }
+    else if (scancode == KEY_END) {
+        notepad->cursor = text_line_start(text, line) + text_line_length(text, line);
+    }
+    else if ((c >= 32 && c <= 126) || c == '\n') {
+        if (text_insert(text, notepad->cursor, c) == 0) {
+            notepad->cursor++;
+        }
+    }
+    else if (c == '\b' && notepad->cursor > 0) {
+        notepad->cursor--;
+        text_delete(text, notepad->cursor);
+    }
+}
+
+static void handle_notepad_key(Notepad* notepad, uint16_t scancode, uint8_t modifiers) {
+    TextBuffer* text = &notepad->text;
+    
     // F2 = Save, F3 = Save As
     if (scancode == KEY_F2) {
         if (notepad->has_filename) {
-            // Save to existing file
-            char buffer[2048];
-            int pos = 0;
-            for (int i = 0; i < notepad->line_count && pos < 2000; i++) {
-                int j = 0;
-                while (notepad->lines[i][j] != '\0' && pos < 2000) {
-                    buffer[pos++] = notepad->lines[i][j++];
-                }
-                if (i < notepad->line_count - 1) {
-                    buffer[pos++] = '\n';
-                }
-            }
-            fs_write_file(notepad->filename, buffer, pos);
+            notepad_save(notepad);
         } else {
             // Enter save mode
             notepad->save_mode = 1;
             notepad->save_cursor = 0;
             notepad->save_buffer[0] = '\0';
+            notepad->shown = 0;
         }
         return;
     }
@@ -267,32 +356,22 @@ void handle_notepad_key(Notepad* notepad, uint8_t scancode) {
         notepad->save_mode = 1;
         notepad->save_cursor = 0;
         notepad->save_buffer[0] = '\0';
+        notepad->shown = 0;
         return;
     }
     
     if (notepad->save_mode) {
+        // The dialog replaces the text; leaving it redraws everything
+        notepad->shown = 0;
         // Handle save dialog input
-        char c = scancode_to_char(scancode);
+        char c = scancode_to_char(scancode, modifiers);
         
         if (c == '\n') {
             // Confirm save
             if (notepad->save_cursor > 0) {
-                str_copy(notepad->filename, notepad->save_buffer, 32);
+                strlcpy(notepad->filename, notepad->save_buffer, 32);
                 notepad->has_filename = 1;
-                
-                // Save file
-                char buffer[2048];
-                int pos = 0;
-                for (int i = 0; i < notepad->line_count && pos < 2000; i++) {
-                    int j = 0;
-                    while (notepad->lines[i][j] != '\0' && pos < 2000) {
-                        buffer[pos++] = notepad->lines[i][j++];
-                    }
-                    if (i < notepad->line_count - 1) {
-                        buffer[pos++] = '\n';
-                    }
-                }
-                fs_write_file(notepad->filename, buffer, pos);
+                notepad_save(notepad);
             }
             notepad->save_mode = 0;
         }
@@ -310,139 +389,476 @@ void handle_notepad_key(Notepad* notepad, uint8_t scancode) {
         return;
     }
     
-    // Normal edit mode
-    char c = scancode_to_char(scancode);
+    // Normal edit mode: up and down keep the column the cursor had
+    uint32_t line = text_line_of(text, notepad->cursor);
+    uint32_t lines = text_line_count(text);
+    char c = scancode_to_char(scancode, modifiers);
     
-    if (c >= 32 && c <= 126 && notepad->cursor_pos < 55) {
-        notepad->lines[notepad->current_line][notepad->cursor_pos++] = c;
-        notepad->lines[notepad->current_line][notepad->cursor_pos] = '\0';
+    if (scancode == KEY_UP || scancode == KEY_PGUP) {
+        uint32_t step = scancode == KEY_UP ? 1 : NOTEPAD_ROWS;
+        notepad_goto_line(notepad, line > step ? line - step : 0);
     }
-    else if (c == '\b' && notepad->cursor_pos > 0) {
-        notepad->cursor_pos--;
-        notepad->lines[notepad->current_line][notepad->cursor_pos] = '\0';
+    else if (scancode == KEY_DOWN || scancode == KEY_PGDN) {
+        uint32_t step = scancode == KEY_DOWN ? 1 : NOTEPAD_ROWS;
+        notepad_goto_line(notepad, line + step);
     }
-    else if (c == '\n' && notepad->current_line < 19) {
-        notepad->current_line++;
-        notepad->cursor_pos = 0;
-        if (notepad->current_line >= notepad->line_count) {
-            notepad->line_count = notepad->current_line + 1;
+    else {
+        handle_notepad_edit(notepad, scancode, c, line);
+        notepad->goal_column = notepad_column(notepad);
+    }
+    
+    // Redraw the lines the cursor left and entered; a line break added
+    // or removed also moves every line below it
+    uint32_t now = text_line_of(text, notepad->cursor);
+    uint32_t from = now < line ? now : line;
+    uint32_t to = (now > line ? now : line) + 1;
+    if (text_line_count(text) != lines) to = NOTEPAD_ALL_LINES;
+    notepad_dirty(notepad, from, to);
+}
+
+// Finish the line being written, dropping the oldest one when the
+// scrollback is full. Nothing reads the scrollback while a command runs,
+// so the line can be built over the oldest one's slot.
+static void terminal_end_line(Terminal* term) {
+    term->lines[term->next_line & (TERMINAL_SCROLLBACK - 1)][term->column] = '\0';
+    if (term->next_line - term->first_line == TERMINAL_SCROLLBACK) {
+        term->first_line++;
+    }
+    term->next_line++;
+    term->column = 0;
+}
+
+// Shell output: a byte stream split into lines at newlines and wrapped
+// at the line width
+static void terminal_write(void* ctx, const char* data, uint32_t len) {
+    Terminal* term = (Terminal*)ctx;
+    char* line = term->lines[term->next_line & (TERMINAL_SCROLLBACK - 1)];
+    
+    for (uint32_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            terminal_end_line(term);
+            line = term->lines[term->next_line & (TERMINAL_SCROLLBACK - 1)];
+            continue;
+        }
+        if (c == '\r') continue;
+        if (c < 32 || c > 126) c = c == '\t' ? ' ' : '.';
+        
+        line[term->column++] = c;
+        if (term->column == TERMINAL_COLUMNS - 1) {
+            terminal_end_line(term);
+            line = term->lines[term->next_line & (TERMINAL_SCROLLBACK - 1)];
+        }
+    }
+}
+
+static void terminal_clear(void* ctx) {
+    Terminal* term = (Terminal*)ctx;
+    term->first_line = term->next_line;
+    term->column = 0;
+}
+
+static void terminal_print(Terminal* term, const char* text) {
+    terminal_write(term, text, strlen(text));
+    terminal_end_line(term);
+}
+
+static const char* terminal_line(Terminal* term, uint32_t line) {
+    return term->lines[line & (TERMINAL_SCROLLBACK - 1)];
+}
+
+// How far the view can scroll back from the newest line
+static uint32_t terminal_max_scroll(Terminal* term) {
+    uint32_t count = term->next_line - term->first_line;
+    return count > TERMINAL_ROWS ? count - TERMINAL_ROWS : 0;
+}
+
+static int line_contains(const char* line, const char* pattern, int len) {
+    for (int i = 0; line[i] != '\0'; i++) {
+        int k = 0;
+        while (k < len && line[i + k] == pattern[k]) k++;
+        if (k == len) return 1;
+    }
+    return 0;
+}
+
+// Newest line at or before `from` holding the search pattern; the view
+// scrolls so that it is the last line shown
+static void terminal_search(Terminal* term, uint32_t from) {
+    term->match_found = 0;
+    if (term->next_line == term->first_line) return;
+    
+    for (uint32_t line = from + 1; line-- > term->first_line;) {
+        if (line_contains(terminal_line(term, line), term->search, term->search_len)) {
+            term->match_found = 1;
+            term->match_line = line;
+            term->scroll = term->next_line - 1 - line;
+            return;
         }
     }
 }
 
-void handle_terminal_key(Terminal* term, uint8_t scancode) {
-    char c = scancode_to_char(scancode);
+// Ctrl+F search mode. A longer pattern only matches lines the shorter one
+// matched, so typing continues from the current match instead of the end;
+// Ctrl+F again finds the next older match.
+static void handle_terminal_search(Terminal* term, uint16_t scancode, char c) {
+    uint32_t newest = term->next_line - 1;
+    
+    if (c == '\n' || scancode == KEY_ESC) {
+        term->search_mode = 0;
+        if (scancode == KEY_ESC) term->scroll = 0;
+    }
+    else if (c == 6) {
+        if (term->match_found && term->match_line > term->first_line) {
+            uint32_t match = term->match_line;
+            terminal_search(term, match - 1);
+            if (!term->match_found) term->match_found = 1;  // Keep the last one
+        }
+    }
+    else if (c == '\b' && term->search_len > 0) {
+        term->search[--term->search_len] = '\0';
+        terminal_search(term, newest);
+    }
+    else if (c >= 32 && c <= 126 && term->search_len < 30) {
+        term->search[term->search_len++] = c;
+        term->search[term->search_len] = '\0';
+        if (term->match_found || term->search_len == 1) {
+            terminal_search(term, term->search_len == 1 ? newest : term->match_line);
+        }
+    }
+}
+
+// ---- Terminal commands, registered with the shell by init_apps ----
+
+static int cmd_help(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    shell_print(out, "Available commands:");
+    for (const ShellCommand* command = shell_commands(); command; command = command->order) {
+        char line[60] = "  ";
+        strlcpy(line + 2, command->name, 20);
+        int k = strlen(line);
+        do {
+            line[k++] = ' ';
+        } while (k < 8);
+        strlcpy(line + k, "- ", 3);
+        strlcpy(line + k + 2, command->help, 60 - k - 2);
+        shell_print(out, line);
+    }
+    shell_print(out, "PgUp/PgDn: Scroll  Ctrl+F: Search");
+    return 0;
+}
+
+static int cmd_ver(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    shell_print(out, "VIN OS v0.4 - File System Edition");
+    return 0;
+}
+
+static int cmd_clear(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    if (out->clear) out->clear(out->ctx);
+    return 0;
+}
+
+// Files in the root directory or the one given
+static int cmd_ls(ShellOutput* out, int argc, char** argv) {
+    char filenames[20][32];
+    int count = argc > 1 ? fs_list_dir(argv[1], filenames, 20) : fs_list_files(filenames, 20);
     
+    if (count < 0) {
+        shell_print(out, "ls: no such directory");
+        return -1;
+    }
+    if (count == 0) {
+        shell_print(out, "No files found.");
+    }
+    for (int f = 0; f < count; f++) {
+        shell_print(out, filenames[f]);
+    }
+    return 0;
+}
+
+static int cmd_disk(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    BcacheStats stats;
+    bcache_get_stats(&stats);
+    
+    char line[60];
+    
+    strlcpy(line, "cache: ", 60);
+    shell_append_number(line, stats.hits, 60);
+    shell_append(line, " hits, ", 60);
+    shell_append_number(line, stats.misses, 60);
+    shell_append(line, " misses", 60);
+    shell_print(out, line);
+    
+    strlcpy(line, "disk: ", 60);
+    shell_append_number(line, stats.bytes_read / 1024, 60);
+    shell_append(line, " KB read, ", 60);
+    shell_append_number(line, stats.bytes_written / 1024, 60);
+    shell_append(line, " KB written", 60);
+    shell_print(out, line);
+    return 0;
+}
+
+static int cmd_mem(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    HeapStats stats;
+    heap_get_stats(&stats);
+    
+    char line[60];
+    
+    strlcpy(line, "heap: ", 60);
+    shell_append_number(line, stats.active, 60);
+    shell_append(line, " live, ", 60);
+    shell_append_number(line, stats.bytes_in_use / 1024, 60);
+    shell_append(line, " KB, ", 60);
+    shell_append_number(line, stats.allocs, 60);
+    shell_append(line, " allocs", 60);
+    shell_print(out, line);
+    
+    strlcpy(line, "pages: ", 60);
+    shell_append_number(line, stats.free_pages, 60);
+    shell_append(line, "/", 60);
+    shell_append_number(line, stats.total_pages, 60);
+    shell_append(line, " free, run ", 60);
+    shell_append_number(line, stats.largest_free_run, 60);
+    shell_append(line, ", slack ", 60);
+    shell_append_number(line, stats.bytes_slack / 1024, 60);
+    shell_append(line, " KB", 60);
+    shell_print(out, line);
+    return 0;
+}
+
+static int cmd_redraw(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    PagingInfo paging;
+    paging_get_info(&paging);
+    
+    wm_lock();
+    uint32_t wc_us = time_redraws(VGA_CACHE_WC);
+    uint32_t uc_us = time_redraws(VGA_CACHE_UC);
+    paging_set_vga_cache(paging.vga_cache);
+    wm_unlock();
+    
+    char line[60];
+    
+    strlcpy(line, "redraw: ", 60);
+    if (paging.pat) {
+        shell_append_number(line, wc_us, 60);
+        shell_append(line, " us WC, ", 60);
+    }
+    shell_append_number(line, uc_us, 60);
+    shell_append(line, " us uncached", 60);
+    shell_print(out, line);
+    
+    strlcpy(line, "paging: ", 60);
+    shell_append_number(line, paging.mapped_bytes >> 20, 60);
+    shell_append(line, " MB, ", 60);
+    shell_append_number(line, paging.large_pages, 60);
+    shell_append(line, " x 4 MB, ", 60);
+    shell_append_number(line, paging.small_pages, 60);
+    shell_append(line, " x 4 KB", 60);
+    shell_print(out, line);
+    return 0;
+}
+
+static int cmd_boot(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    const BootTimes* boot = get_boot_times();
+    
+    char line[60];
+    
+    // Without loader timestamps only the kernel's part is known
+    uint64_t start = boot->loader_start ? boot->loader_start : boot->kernel_entry;
+    strlcpy(line, "boot: ", 60);
+    shell_append_number(line, tsc_to_ms(boot->desktop_ready - start), 60);
+    shell_append(line, " ms to desktop, ", 60);
+    shell_append_number(line, boot->kernel_size / 1024, 60);
+    shell_append(line, " KB kernel", 60);
+    shell_print(out, line);
+    
+    strlcpy(line, "", 60);
+    if (boot->loader_start) {
+        strlcpy(line, "load ", 60);
+        shell_append_number(line, tsc_to_ms(boot->kernel_loaded - boot->loader_start), 60);
+        shell_append(line, " ms, setup ", 60);
+        shell_append_number(line, tsc_to_ms(boot->kernel_entry - boot->kernel_loaded), 60);
+        shell_append(line, " ms, ", 60);
+    }
+    shell_append(line, "init ", 60);
+    shell_append_number(line, tsc_to_ms(boot->desktop_ready - boot->kernel_entry), 60);
+    shell_append(line, " ms", 60);
+    shell_print(out, line);
+    return 0;
+}
+
+static int cmd_sched(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    SchedStats stats;
+    sched_get_stats(&stats);
+    
+    char line[60];
+    
+    strlcpy(line, "threads: ", 60);
+    shell_append_number(line, stats.threads, 60);
+    shell_append(line, ", ", 60);
+    shell_append_number(line, stats.switches, 60);
+    shell_append(line, " switches, ", 60);
+    shell_append_number(line, stats.preemptions, 60);
+    shell_append(line, " preempted", 60);
+    shell_print(out, line);
+    
+    strlcpy(line, "switch ", 60);
+    shell_append_number(line, stats.switch_cycles, 60);
+    shell_append(line, " cyc, wake ", 60);
+    shell_append_number(line, tsc_to_us(stats.latency_cycles), 60);
+    shell_append(line, " us (max ", 60);
+    shell_append_number(line, tsc_to_us(stats.max_latency_cycles), 60);
+    shell_append(line, ")", 60);
+    shell_print(out, line);
+    return 0;
+}
+
+static int cmd_kbd(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    KeyboardStats stats;
+    keyboard_get_stats(&stats);
+    
+    char line[60];
+    
+    strlcpy(line, "keys: ", 60);
+    shell_append_number(line, stats.presses, 60);
+    shell_append(line, " pressed, ", 60);
+    shell_append_number(line, stats.repeats, 60);
+    shell_append(line, " repeats, ", 60);
+    shell_append_number(line, stats.dropped, 60);
+    shell_append(line, " dropped", 60);
+    shell_print(out, line);
+    
+    strlcpy(line, "input queue: ", 60);
+    shell_append_number(line, event_dropped(), 60);
+    shell_append(line, " dropped", 60);
+    if (stats.modifiers & MOD_CAPS) shell_append(line, ", Caps", 60);
+    if (stats.modifiers & MOD_NUM) shell_append(line, ", Num", 60);
+    shell_print(out, line);
+    return 0;
+}
+
+#ifdef VIN_FB
+static int cmd_fbbench(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    FbBenchResult result;
+    wm_lock();
+    fb_benchmark(&result);
+    vga_invalidate();  // Benchmark drew over the desktop
+    wm_unlock();
+    
+    char line[60];
+    
+    strlcpy(line, "clear: ", 60);
+    shell_append_number(line, result.clear_fps, 60);
+    shell_append(line, " fps", 60);
+    shell_print(out, line);
+    
+    strlcpy(line, "text:  ", 60);
+    shell_append_number(line, result.text_fps, 60);
+    shell_append(line, " fps", 60);
+    shell_print(out, line);
+    return 0;
+}
+#endif
+
+static ShellCommand terminal_commands[] = {
+    { "help",   "Show this help", cmd_help, 0, 0 },
+    { "ver",    "Show version", cmd_ver, 0, 0 },
+    { "clear",  "Clear screen", cmd_clear, 0, 0 },
+    { "ls",     "List files", cmd_ls, 0, 0 },
+    { "disk",   "Disk cache stats", cmd_disk, 0, 0 },
+    { "mem",    "Kernel heap stats", cmd_mem, 0, 0 },
+    { "redraw", "Time full-screen redraws", cmd_redraw, 0, 0 },
+    { "boot",   "Boot time to desktop", cmd_boot, 0, 0 },
+    { "sched",  "Threads and switch timing", cmd_sched, 0, 0 },
+    { "kbd",    "Keyboard and input queue", cmd_kbd, 0, 0 },
+#ifdef VIN_FB
+    { "fbbench", "Time framebuffer drawing", cmd_fbbench, 0, 0 },
+#endif
+};
+
+static void register_terminal_commands(void) {
+    for (uint32_t i = 0; i < sizeof(terminal_commands) / sizeof(terminal_commands[0]); i++) {
+        shell_register(&terminal_commands[i]);
+    }
+}
+
+// Echo the command line, then run it with output into the scrollback
+static void terminal_run(Terminal* term) {
+    char cmd_line[60] = "> ";
+    strlcpy(cmd_line + 2, term->input, 58);
+    terminal_print(term, cmd_line);
+    
+    shell_run(&term->out, term->input);
+    if (term->column > 0) terminal_end_line(term);
+}
+
+static void handle_terminal_key(Terminal* term, uint16_t scancode, uint8_t modifiers) {
+    char c = scancode_to_char(scancode, modifiers);
+    
+    if (term->search_mode) {
+        handle_terminal_search(term, scancode, c);
+        return;
+    }
+    
+    if (scancode == KEY_PGUP) {
+        term->scroll += TERMINAL_ROWS;
+        if (term->scroll > terminal_max_scroll(term)) term->scroll = terminal_max_scroll(term);
+        return;
+    }
+    if (scancode == KEY_PGDN) {
+        term->scroll = term->scroll > TERMINAL_ROWS ? term->scroll - TERMINAL_ROWS : 0;
+        return;
+    }
+    if (c == 6) {
+        term->search_mode = 1;
+        term->search_len = 0;
+        term->search[0] = '\0';
+        term->match_found = 0;
+        return;
+    }
+    
+    // Typing returns to the newest output
     if (c == '\n') {
         if (term->input_len > 0) {
-            if (term->line_count < 16) {
-                char cmd_line[60] = "> ";
-                int k = 2;
-                for (int i = 0; i < term->input_len && k < 58; i++) {
-                    cmd_line[k++] = term->input[i];
-                }
-                cmd_line[k] = '\0';
-                
-                for (int i = 0; cmd_line[i] != '\0' && i < 60; i++) {
-                    term->lines[term->line_count][i] = cmd_line[i];
-                }
-                term->lines[term->line_count][term->input_len + 2] = '\0';
-                term->line_count++;
-            }
-            
-            // Command handling
-            if (term->input[0] == 'h' && term->input[1] == 'e' && 
-                term->input[2] == 'l' && term->input[3] == 'p') {
-                if (term->line_count < 16) {
-                    char* help1 = "Available commands:";
-                    char* help2 = "  help  - Show this help";
-                    char* help3 = "  ver   - Show version";
-                    char* help4 = "  clear - Clear screen";
-                    char* help5 = "  ls    - List files";
-                    
-                    int i;
-                    for (i = 0; help1[i] != '\0'; i++) term->lines[term->line_count][i] = help1[i];
-                    term->lines[term->line_count++][i] = '\0';
-                    
-                    for (i = 0; help2[i] != '\0'; i++) term->lines[term->line_count][i] = help2[i];
-                    term->lines[term->line_count++][i] = '\0';
-                    
-                    for (i = 0; help3[i] != '\0'; i++) term->lines[term->line_count][i] = help3[i];
-                    term->lines[term->line_count++][i] = '\0';
-                    
-                    for (i = 0; help4[i] != '\0'; i++) term->lines[term->line_count][i] = help4[i];
-                    term->lines[term->line_count++][i] = '\0';
-                    
-                    for (i = 0; help5[i] != '\0'; i++) term->lines[term->line_count][i] = help5[i];
-                    term->lines[term->line_count++][i] = '\0';
-                }
-            }
-            else if (term->input[0] == 'v' && term->input[1] == 'e' && 
-                     term->input[2] == 'r') {
-                if (term->line_count < 16) {
-                    char* ver = "VIN OS v0.4 - File System Edition";
-                    int i;
-                    for (i = 0; ver[i] != '\0'; i++) {
-                        term->lines[term->line_count][i] = ver[i];
-                    }
-                    term->lines[term->line_count++][i] = '\0';
-                }
-            }
-            else if (term->input[0] == 'l' && term->input[1] == 's') {
-                char filenames[20][32];
-                int count = fs_list_files(filenames, 20);
-                
-                if (count == 0) {
-                    char* msg = "No files found.";
-                    int i;
-                    for (i = 0; msg[i] != '\0'; i++) {
-                        term->lines[term->line_count][i] = msg[i];
-                    }
-                    term->lines[term->line_count++][i] = '\0';
-                } else {
-                    for (int f = 0; f < count && term->line_count < 16; f++) {
-                        int i;
-                        for (i = 0; filenames[f][i] != '\0'; i++) {
-                            term->lines[term->line_count][i] = filenames[f][i];
-                        }
-                        term->lines[term->line_count++][i] = '\0';
-                    }
-                }
-            }
-            else if (term->input[0] == 'c' && term->input[1] == 'l' && 
-                     term->input[2] == 'e' && term->input[3] == 'a' &&
-                     term->input[4] == 'r') {
-                term->line_count = 0;
-                for (int i = 0; i < 18; i++) {
-                    term->lines[i][0] = '\0';
-                }
-            }
-            else if (term->input_len > 0) {
-                if (term->line_count < 16) {
-                    char* unknown = "Unknown command. Type 'help'";
-                    int i;
-                    for (i = 0; unknown[i] != '\0'; i++) {
-                        term->lines[term->line_count][i] = unknown[i];
-                    }
-                    term->lines[term->line_count++][i] = '\0';
-                }
-            }
-            
+            term->scroll = 0;
+            terminal_run(term);
             term->input_len = 0;
             term->input[0] = '\0';
         }
     }
     else if (c == '\b' && term->input_len > 0) {
+        term->scroll = 0;
         term->input_len--;
         term->input[term->input_len] = '\0';
     }
     else if (c >= 32 && c <= 126 && term->input_len < 58) {
+        term->scroll = 0;
         term->input[term->input_len++] = c;
         term->input[term->input_len] = '\0';
     }
 }
 
-void handle_filemanager_key(FileManager* fm, uint8_t scancode) {
+// Returns the Notepad opened by ENTER, for the caller to register
+static Notepad* handle_filemanager_key(FileManager* fm, uint16_t scancode) {
     if (scancode == KEY_UP) {
         if (fm->selected_file > 0) {
             fm->selected_file--;
@@ -457,46 +873,363 @@ void handle_filemanager_key(FileManager* fm, uint8_t scancode) {
         // Delete selected file
         if (fm->file_count > 0) {
             fs_delete_file(fm->filenames[fm->selected_file]);
-            fm->file_count = fs_list_files(fm->filenames, 20);
-            if (fm->selected_file >= fm->file_count && fm->file_count > 0) {
-                fm->selected_file = fm->file_count - 1;
-            }
+            filemanager_refresh(fm);
         }
     }
     else if (scancode == KEY_ENTER) {
         // Open file in notepad
         if (fm->file_count > 0) {
-            Notepad* notepad = get_notepad_instance();
+            wm_lock();
+            Notepad* notepad = launch_notepad();
+            wm_unlock();
             if (notepad) {
-                int win_id = launch_notepad();
-                if (win_id >= 0) {
-                    // Load file content
-                    char buffer[2048];
-                    int size = fs_read_file(fm->filenames[fm->selected_file], buffer, 2048);
-                    
-                    if (size > 0) {
-                        str_copy(notepad->filename, fm->filenames[fm->selected_file], 32);
-                        notepad->has_filename = 1;
-                        
-                        // Parse buffer into lines
-                        int line = 0;
-                        int pos = 0;
-                        for (int i = 0; i < size && line < 20; i++) {
-                            if (buffer[i] == '\n') {
-                                notepad->lines[line][pos] = '\0';
-                                line++;
-                                pos = 0;
-                            } else if (pos < 59) {
-                                notepad->lines[line][pos++] = buffer[i];
-                            }
-                        }
-                        notepad->lines[line][pos] = '\0';
-                        notepad->line_count = line + 1;
-                        notepad->current_line = 0;
-                        notepad->cursor_pos = 0;
-                    }
+                // Load file content, whatever its size, straight from the
+                // cached blocks into the text. The name is only kept if it
+                // loaded, so F2 cannot overwrite the file with a partial copy.
+                int handle = fm->handles[fm->selected_file];
+                int size = fs_size(handle);
+                int loaded = size >= 0 && text_reserve(&notepad->text, size) == 0;
+                uint32_t offset = 0;
+                const char* data;
+                int got = 0;
+                
+                while (loaded && (got = fs_borrow(handle, offset, &data)) > 0) {
+                    loaded = text_append(&notepad->text, data, got) == 0;
+                    fs_release(data);
+                    offset += got;
+                }
+                if (got < 0 || offset != (uint32_t)size) loaded = 0;
+                if (!loaded) {
+                    text_set(&notepad->text, "", 0);
+                } else {
+                    strlcpy(notepad->filename, fm->filenames[fm->selected_file], 32);
+                    notepad->has_filename = 1;
                 }
             }
+            return notepad;
+        }
+    }
+    return 0;
+}
+
+// Relist the files, but only if names were created or removed since the
+// last listing. Sizes are read through the handles, so they stay current.
+static void filemanager_refresh(FileManager* fm) {
+    if (fm->generation == fs_generation()) return;
+    
+    for (int i = 0; i < fm->file_count; i++) {
+        fs_close(fm->handles[i]);
+    }
+    fm->file_count = fs_list_files(fm->filenames, 20);
+    for (int i = 0; i < fm->file_count; i++) {
+        fm->handles[i] = fs_open(fm->filenames[i]);
+    }
+    fm->generation = fs_generation();
+    
+    if (fm->selected_file >= fm->file_count && fm->file_count > 0) {
+        fm->selected_file = fm->file_count - 1;
+    }
+}
+
+// ---- Rendering: window text from the app state, with wm_lock held ----
+
+static void render_calculator(void* app) {
+    Calculator* calc = (Calculator*)app;
+    Window* win = get_window(calc->window_id);
+    if (win == 0) return;
+    
+    clear_window_text(calc->window_id);
+    
+    add_window_text(calc->window_id, "VIN Calculator v1.0");
+    add_window_text(calc->window_id, "--------------------");
+    
+    char display_line[30] = "Display: ";
+    shell_append(display_line, calc->display, sizeof(display_line));
+    add_window_text(calc->window_id, display_line);
+    
+    add_window_text(calc->window_id, "");
+    add_window_text(calc->window_id, "Use keyboard:");
+    add_window_text(calc->window_id, "  0-9: Numbers");
+    add_window_text(calc->window_id, "  +,-,*,/: Operators");
+    add_window_text(calc->window_id, "  =: Calculate");
+    add_window_text(calc->window_id, "  C: Clear");
+}
+
+static void render_notepad(void* app) {
+    Notepad* notepad = (Notepad*)app;
+    Window* win = get_window(notepad->window_id);
+    if (win == 0) return;
+    
+    if (notepad->save_mode) {
+        clear_window_text(notepad->window_id);
+        add_window_text(notepad->window_id, "Save As - Enter filename:");
+        add_window_text(notepad->window_id, "");
+        
+        char prompt[60] = "Filename: ";
+        shell_append(prompt, notepad->save_buffer, 50);
+        shell_append(prompt, "_", sizeof(prompt));
+        add_window_text(notepad->window_id, prompt);
+        add_window_text(notepad->window_id, "");
+        add_window_text(notepad->window_id, "Press ENTER to save, ESC to cancel");
+        return;
+    }
+    
+    TextBuffer* text = &notepad->text;
+    uint32_t columns = win->width - 3;
+    notepad_scroll(notepad, columns);
+    
+    if (!notepad->shown || notepad->left_column != notepad->shown_left) {
+        // Header and every visible line
+        if (!notepad->shown) {
+            clear_window_text(notepad->window_id);
+            if (notepad->has_filename) {
+                char title[60] = "File: ";
+                shell_append(title, notepad->filename, 50);
+                add_window_text(notepad->window_id, title);
+            } else {
+                add_window_text(notepad->window_id, "Unsaved Document");
+            }
+            add_window_text(notepad->window_id, "F2:Save  F3:Save As");
+            add_window_text(notepad->window_id, "----------------------------");
+        }
+        notepad_dirty(notepad, notepad->top_line, NOTEPAD_ALL_LINES);
+    } else if (notepad->top_line != notepad->shown_top) {
+        // Shift the rows that stay in view, draw the ones scrolled in
+        int delta = (int)notepad->top_line - (int)notepad->shown_top;
+        window_scroll_rows(notepad->window_id, NOTEPAD_FIRST_ROW,
+                           NOTEPAD_FIRST_ROW + NOTEPAD_ROWS, -delta);
+        if (delta > 0) {
+            notepad_dirty(notepad, notepad->shown_top + NOTEPAD_ROWS, notepad->top_line + NOTEPAD_ROWS);
+        } else {
+            notepad_dirty(notepad, notepad->top_line, notepad->shown_top);
+        }
+    }
+    
+    // Visible part of each changed line, with the cursor drawn as '_'
+    uint32_t cursor_line = text_line_of(text, notepad->cursor);
+    uint32_t cursor_column = notepad_column(notepad) - notepad->left_column;
+    uint32_t lines = text_line_count(text);
+    uint32_t first = notepad->dirty_from;
+    uint32_t end = notepad->dirty_to;
+    if (first < notepad->top_line) first = notepad->top_line;
+    if (end > notepad->top_line + NOTEPAD_ROWS) end = notepad->top_line + NOTEPAD_ROWS;
+    
+    for (uint32_t i = first; i < end; i++) {
+        char row[80];
+        uint32_t n = 0;
+        if (i < lines) {
+            uint32_t length = text_line_length(text, i);
+            if (length > notepad->left_column) {
+                n = length - notepad->left_column;
+                if (n > columns) n = columns;
+                text_copy(text, text_line_start(text, i) + notepad->left_column, row, n);
+            }
         }
+        
+        if (i == cursor_line) {
+            for (uint32_t k = n; k > cursor_column; k--) {
+                row[k] = row[k - 1];
+            }
+            row[cursor_column] = '_';
+            n++;
+        }
+        window_set_row(notepad->window_id, NOTEPAD_FIRST_ROW + (i - notepad->top_line), row, n);
+    }
+    
+    notepad->dirty_from = 0;
+    notepad->dirty_to = 0;
+    notepad->shown_top = notepad->top_line;
+    notepad->shown_left = notepad->left_column;
+    notepad->shown = 1;
+}
+
+static void render_terminal(void* app) {
+    Terminal* term = (Terminal*)app;
+    Window* win = get_window(term->window_id);
+    if (win == 0) return;
+    
+    // View: TERMINAL_ROWS lines ending `scroll` lines before the newest
+    if (term->scroll > terminal_max_scroll(term)) term->scroll = terminal_max_scroll(term);
+    uint32_t end = term->next_line - term->scroll;
+    uint32_t start = end - term->first_line > TERMINAL_ROWS ? end - TERMINAL_ROWS : term->first_line;
+    
+    if (!term->shown) {
+        clear_window_text(term->window_id);
+        add_window_text(term->window_id, "VIN Terminal v0.4");
+        add_window_text(term->window_id, "Type 'help' for commands");
+        term->shown_end = term->shown_start;
+    } else if (start != term->shown_start) {
+        // Shift the lines that stay in view
+        window_scroll_rows(term->window_id, TERMINAL_FIRST_ROW, TERMINAL_FIRST_ROW + TERMINAL_ROWS,
+                           (int)(term->shown_start - start));
     }
-}
\ No newline at end of file
+    
+    // Status line: search pattern, scroll position or the rule
+    char status[60];
+    if (term->search_mode) {
+        strlcpy(status, "search: ", 60);
+        shell_append(status, term->search, 60);
+        shell_append(status, "_", 60);
+        if (term->search_len > 0 && !term->match_found) {
+            shell_append(status, "  (not found)", 60);
+        }
+    } else if (term->scroll > 0) {
+        strlcpy(status, "-- ", 60);
+        shell_append_number(status, term->scroll, 60);
+        shell_append(status, " lines below, PgDn --", 60);
+    } else {
+        strlcpy(status, "========================", 60);
+    }
+    window_set_row(term->window_id, 2, status, strlen(status));
+    
+    // Lines not in view as of the last render, then the input line right
+    // below the last one. Line numbers are never reused, so the lines that
+    // stayed in view are unchanged.
+    for (uint32_t i = start; i != end; i++) {
+        if (i - term->shown_start < term->shown_end - term->shown_start) continue;
+        const char* line = terminal_line(term, i);
+        window_set_row(term->window_id, TERMINAL_FIRST_ROW + (i - start), line, strlen(line));
+    }
+    
+    char input_line[62] = "> ";
+    shell_append(input_line, term->input, 61);
+    shell_append(input_line, "_", sizeof(input_line));
+    int input_row = TERMINAL_FIRST_ROW + (end - start);
+    window_set_row(term->window_id, input_row, input_line, strlen(input_line));
+    window_clear_rows(term->window_id, input_row + 1);
+    
+    term->shown_start = start;
+    term->shown_end = end;
+    term->shown = 1;
+}
+
+static void render_filemanager(void* app) {
+    FileManager* fm = (FileManager*)app;
+    Window* win = get_window(fm->window_id);
+    if (win == 0) return;
+    
+    clear_window_text(fm->window_id);
+    
+    add_window_text(fm->window_id, "VIN File Manager");
+    add_window_text(fm->window_id, "--------------------------------");
+    add_window_text(fm->window_id, "UP/DOWN: Navigate  ENTER: Open");
+    add_window_text(fm->window_id, "DELETE: Remove file");
+    add_window_text(fm->window_id, "");
+    
+    if (fm->file_count == 0) {
+        add_window_text(fm->window_id, "No files found.");
+        add_window_text(fm->window_id, "Create files in Notepad (F2)");
+    } else {
+        for (int i = 0; i < fm->file_count && i < 12; i++) {
+            char line[60];
+            strlcpy(line, i == fm->selected_file ? "> " : "  ", sizeof(line));
+            shell_append(line, fm->filenames[i], 50);
+            
+            int size = fs_size(fm->handles[i]);
+            if (size >= 0) {
+                shell_append(line, " (", sizeof(line));
+                shell_append_number(line, size, sizeof(line));
+                shell_append(line, "B)", sizeof(line));
+            }
+            add_window_text(fm->window_id, line);
+        }
+    }
+}
+
+// ---- Event handlers and the app table ----
+
+static int calculator_event(void* app, const Event* event) {
+    if (event->type != EVENT_KEY_DOWN) return 0;
+    handle_calculator_key((Calculator*)app, event->key, event->modifiers);
+    return 1;
+}
+
+// A redraw request repaints the whole window, other renders only what changed
+static int notepad_event(void* app, const Event* event) {
+    if (event->type == EVENT_REDRAW) ((Notepad*)app)->shown = 0;
+    if (event->type != EVENT_KEY_DOWN) return 0;
+    handle_notepad_key((Notepad*)app, event->key, event->modifiers);
+    return 1;
+}
+
+static int terminal_event(void* app, const Event* event) {
+    if (event->type == EVENT_REDRAW) ((Terminal*)app)->shown = 0;
+    if (event->type != EVENT_KEY_DOWN) return 0;
+    handle_terminal_key((Terminal*)app, event->key, event->modifiers);
+    return 1;
+}
+
+static const AppOps calculator_ops = {
+    "calculator", calculator_event, render_calculator, destroy_calculator
+};
+
+static const AppOps notepad_ops = {
+    "notepad", notepad_event, render_notepad, destroy_notepad
+};
+
+static const AppOps terminal_ops = {
+    "terminal", terminal_event, render_terminal, destroy_terminal
+};
+
+// The timer event picks up files other apps created or deleted
+static int filemanager_event(void* app, const Event* event) {
+    FileManager* fm = (FileManager*)app;
+    uint32_t generation = fm->generation;
+    
+    if (event->type == EVENT_KEY_DOWN) {
+        Notepad* opened = handle_filemanager_key(fm, event->key);
+        if (opened) {
+            AppInstance instance = { &notepad_ops, opened, opened->window_id };
+            app_register(&instance);
+        }
+        filemanager_refresh(fm);
+        return 1;
+    }
+    if (event->type == EVENT_TIMER) {
+        filemanager_refresh(fm);
+        return fm->generation != generation;
+    }
+    return 0;
+}
+
+static const AppOps filemanager_ops = {
+    "filemanager", filemanager_event, render_filemanager, destroy_filemanager
+};
+
+int app_launch(int index, AppInstance* out) {
+    switch (index) {
+        case 0: {
+            Calculator* calc = launch_calculator();
+            if (calc == 0) return -1;
+            out->ops = &calculator_ops;
+            out->data = calc;
+            out->window_id = calc->window_id;
+            return 0;
+        }
+        case 1: {
+            Notepad* notepad = launch_notepad();
+            if (notepad == 0) return -1;
+            out->ops = &notepad_ops;
+            out->data = notepad;
+            out->window_id = notepad->window_id;
+            return 0;
+        }
+        case 2: {
+            Terminal* term = launch_terminal();
+            if (term == 0) return -1;
+            out->ops = &terminal_ops;
+            out->data = term;
+            out->window_id = term->window_id;
+            return 0;
+        }
+        case 3: {
+            FileManager* fm = launch_filemanager();
+            if (fm == 0) return -1;
+            out->ops = &filemanager_ops;
+            out->data = fm;
+            out->window_id = fm->window_id;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,199 @@
+// ata.c - ATA PIO driver for the primary IDE bus
+//
+// Polling only: the drive's interrupt is disabled (nIEN) and IRQ14 stays
+// masked at the PIC. When the drive supports it, transfers use READ/WRITE
+// MULTIPLE so one DRQ wait moves a whole block of sectors instead of one.
+#include "include/ata.h"
+#include "include/io.h"
+
+#define ATA_DATA       0x1F0
+#define ATA_ERROR      0x1F1
+#define ATA_SECCOUNT   0x1F2
+#define ATA_LBA_LOW    0x1F3
+#define ATA_LBA_MID    0x1F4
+#define ATA_LBA_HIGH   0x1F5
+#define ATA_DRIVE      0x1F6
+#define ATA_STATUS     0x1F7
+#define ATA_COMMAND    0x1F7
+#define ATA_CONTROL    0x3F6
+
+#define ATA_SR_BSY     0x80
+#define ATA_SR_DF      0x20
+#define ATA_SR_DRQ     0x08
+#define ATA_SR_ERR     0x01
+
+#define ATA_CMD_READ_SECTORS  0x20
+#define ATA_CMD_WRITE_SECTORS 0x30
+#define ATA_CMD_READ_MULTIPLE 0xC4
+#define ATA_CMD_WRITE_MULTIPLE 0xC5
+#define ATA_CMD_SET_MULTIPLE  0xC6
+#define ATA_CMD_CACHE_FLUSH   0xE7
+#define ATA_CMD_IDENTIFY      0xEC
+
+#define ATA_TIMEOUT 1000000
+
+static int present = 0;
+static uint32_t sector_count = 0;
+static uint32_t multiple = 1;       // Sectors per DRQ block
+static uint8_t read_command = ATA_CMD_READ_SECTORS;
+static uint8_t write_command = ATA_CMD_WRITE_SECTORS;
+static AtaStats stats;
+
+// Reading the alternate status register four times gives the drive the
+// 400ns it needs to update status after a command or drive select
+static void ata_delay(void) {
+    for (int i = 0; i < 4; i++) {
+        inb(ATA_CONTROL);
+    }
+}
+
+static int wait_not_busy(void) {
+    for (int i = 0; i < ATA_TIMEOUT; i++) {
+        if (!(inb(ATA_STATUS) & ATA_SR_BSY)) return 0;
+    }
+    return -1;
+}
+
+// End of a command: not busy, and neither error nor device fault set
+static int wait_done(void) {
+    for (int i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t status = inb(ATA_STATUS);
+        if (status & ATA_SR_BSY) continue;
+        return (status & (ATA_SR_ERR | ATA_SR_DF)) ? -1 : 0;
+    }
+    return -1;
+}
+
+static int wait_data_request(void) {
+    for (int i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t status = inb(ATA_STATUS);
+        if (status & ATA_SR_BSY) continue;
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) return -1;
+        if (status & ATA_SR_DRQ) return 0;
+    }
+    return -1;
+}
+
+static int issue_command(uint8_t command, uint32_t lba, uint8_t count) {
+    if (wait_not_busy() < 0) return -1;
+
+    outb(ATA_DRIVE, 0xE0 | ((lba >> 24) & 0x0F));  // Master, LBA mode
+    ata_delay();
+    outb(ATA_SECCOUNT, count);                      // 0 means 256
+    outb(ATA_LBA_LOW, lba & 0xFF);
+    outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
+    outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
+    outb(ATA_COMMAND, command);
+    ata_delay();
+    return 0;
+}
+
+int ata_init(void) {
+    uint16_t identify[256];
+
+    present = 0;
+    sector_count = 0;
+
+    outb(ATA_CONTROL, 0x02);  // nIEN: no interrupts, we poll
+
+    outb(ATA_DRIVE, 0xA0);
+    ata_delay();
+    outb(ATA_SECCOUNT, 0);
+    outb(ATA_LBA_LOW, 0);
+    outb(ATA_LBA_MID, 0);
+    outb(ATA_LBA_HIGH, 0);
+    outb(ATA_COMMAND, ATA_CMD_IDENTIFY);
+    ata_delay();
+
+    if (inb(ATA_STATUS) == 0) return -1;             // No drive
+    if (wait_not_busy() < 0) return -1;
+    if (inb(ATA_LBA_MID) || inb(ATA_LBA_HIGH)) return -1;  // ATAPI/SATA
+    if (wait_data_request() < 0) return -1;
+
+    insw(ATA_DATA, identify, 256);
+    sector_count = identify[60] | ((uint32_t)identify[61] << 16);
+    present = 1;
+
+    multiple = 1;
+    read_command = ATA_CMD_READ_SECTORS;
+    write_command = ATA_CMD_WRITE_SECTORS;
+
+    // Word 47 low byte: largest block READ/WRITE MULTIPLE supports
+    uint8_t max_multiple = identify[47] & 0xFF;
+    if (max_multiple > 1) {
+        issue_command(ATA_CMD_SET_MULTIPLE, 0, max_multiple);
+        if (wait_done() == 0) {
+            multiple = max_multiple;
+            read_command = ATA_CMD_READ_MULTIPLE;
+            write_command = ATA_CMD_WRITE_MULTIPLE;
+        }
+    }
+    return 0;
+}
+
+uint32_t ata_sector_count(void) {
+    return sector_count;
+}
+
+uint32_t ata_multiple_count(void) {
+    return multiple;
+}
+
+void ata_get_stats(AtaStats* out) {
+    *out = stats;
+}
+
+int ata_read(uint32_t lba, uint32_t count, void* buffer) {
+    if (!present) return -1;
+    uint8_t* p = (uint8_t*)buffer;
+
+    while (count > 0) {
+        uint32_t chunk = count > 256 ? 256 : count;
+        if (issue_command(read_command, lba, (uint8_t)chunk) < 0) return -1;
+        stats.read_commands++;
+
+        for (uint32_t done = 0; done < chunk; ) {
+            uint32_t block = chunk - done < multiple ? chunk - done : multiple;
+            if (wait_data_request() < 0) return -1;
+            insw(ATA_DATA, p, block * ATA_SECTOR_SIZE / 2);
+            p += block * ATA_SECTOR_SIZE;
+            done += block;
+        }
+
+        stats.sectors_read += chunk;
+        lba += chunk;
+        count -= chunk;
+    }
+    return 0;
+}
+
+int ata_write(uint32_t lba, uint32_t count, const void* buffer) {
+    if (!present) return -1;
+    const uint8_t* p = (const uint8_t*)buffer;
+
+    while (count > 0) {
+        uint32_t chunk = count > 256 ? 256 : count;
+        if (issue_command(write_command, lba, (uint8_t)chunk) < 0) return -1;
+        stats.write_commands++;
+
+        for (uint32_t done = 0; done < chunk; ) {
+            uint32_t block = chunk - done < multiple ? chunk - done : multiple;
+            if (wait_data_request() < 0) return -1;
+            outsw(ATA_DATA, p, block * ATA_SECTOR_SIZE / 2);
+            p += block * ATA_SECTOR_SIZE;
+            done += block;
+        }
+
+        // The drive is still writing the last block; the next command
+        // may only be issued once it is done, and it may have failed
+        if (wait_done() < 0) return -1;
+
+        stats.sectors_written += chunk;
+        lba += chunk;
+        count -= chunk;
+    }
+
+    outb(ATA_COMMAND, ATA_CMD_CACHE_FLUSH);
+    ata_delay();
+    return wait_done();
+}
@@ -0,0 +1,249 @@
+// bcache.c - LRU write-back sector cache
+//
+// Sectors are found through a small hash table and kept on a doubly linked
+// LRU list (head = most recently used). All links are slot indices.
+#include "include/bcache.h"
+#include "include/ata.h"
+#include "include/string.h"
+
+#define HASH_SIZE 64            // Power of two
+#define NONE 0xFFFF
+
+typedef struct {
+    uint32_t lba;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t pins;               // Outstanding bcache_pin calls, never evicted
+    uint16_t prev, next;        // LRU list
+    uint16_t hash_next;
+    uint32_t data[ATA_SECTOR_SIZE / 4];
+} CacheSlot;
+
+static CacheSlot slots[BCACHE_SECTORS];
+static uint16_t hash_heads[HASH_SIZE];
+static uint16_t lru_head, lru_tail;
+// Separate buffers: inserting read-ahead sectors can trigger a flush
+static uint32_t read_staging[BCACHE_READAHEAD * ATA_SECTOR_SIZE / 4];
+static uint32_t write_staging[BCACHE_BATCH * ATA_SECTOR_SIZE / 4];
+static BcacheStats stats;
+
+static void copy_sector(void* dest, const void* src) {
+    memcpy(dest, src, ATA_SECTOR_SIZE);
+}
+
+static uint32_t hash_lba(uint32_t lba) {
+    return (lba * 2654435761u) >> 26;   // Top 6 bits, HASH_SIZE == 64
+}
+
+static void lru_unlink(uint16_t i) {
+    if (slots[i].prev != NONE) slots[slots[i].prev].next = slots[i].next;
+    else lru_head = slots[i].next;
+    if (slots[i].next != NONE) slots[slots[i].next].prev = slots[i].prev;
+    else lru_tail = slots[i].prev;
+}
+
+static void lru_push_front(uint16_t i) {
+    slots[i].prev = NONE;
+    slots[i].next = lru_head;
+    if (lru_head != NONE) slots[lru_head].prev = i;
+    lru_head = i;
+    if (lru_tail == NONE) lru_tail = i;
+}
+
+static void hash_remove(uint16_t i) {
+    uint16_t* link = &hash_heads[hash_lba(slots[i].lba)];
+    while (*link != NONE) {
+        if (*link == i) {
+            *link = slots[i].hash_next;
+            return;
+        }
+        link = &slots[*link].hash_next;
+    }
+}
+
+static int find_slot(uint32_t lba) {
+    for (uint16_t i = hash_heads[hash_lba(lba)]; i != NONE; i = slots[i].hash_next) {
+        if (slots[i].lba == lba) return i;
+    }
+    return -1;
+}
+
+void bcache_init(void) {
+    for (int i = 0; i < HASH_SIZE; i++) {
+        hash_heads[i] = NONE;
+    }
+    lru_head = lru_tail = NONE;
+    for (uint16_t i = 0; i < BCACHE_SECTORS; i++) {
+        slots[i].valid = 0;
+        slots[i].dirty = 0;
+        slots[i].pins = 0;
+        slots[i].hash_next = NONE;
+        lru_push_front(i);
+    }
+    stats = (BcacheStats){0};
+}
+
+// Least recently used slot that is not pinned, emptied and ready for reuse
+static int evict(void) {
+    uint16_t i = lru_tail;
+    while (i != NONE && slots[i].pins) {
+        i = slots[i].prev;
+    }
+    if (i == NONE) return -1;
+    if (slots[i].dirty) {
+        // Write every dirty sector now rather than this one alone
+        if (bcache_flush() < 0) return -1;
+    }
+    if (slots[i].valid) {
+        hash_remove(i);
+        slots[i].valid = 0;
+    }
+    return i;
+}
+
+// data may be 0 when the caller fills the slot itself
+static int insert(uint32_t lba, const void* data) {
+    int i = evict();
+    if (i < 0) return -1;
+
+    slots[i].lba = lba;
+    slots[i].valid = 1;
+    slots[i].dirty = 0;
+    slots[i].hash_next = hash_heads[hash_lba(lba)];
+    hash_heads[hash_lba(lba)] = i;
+    if (data) copy_sector(slots[i].data, data);
+
+    lru_unlink(i);
+    lru_push_front(i);
+    return i;
+}
+
+// Look the sector up, reading it (and the uncached ones after it) on a miss
+static int lookup(uint32_t lba) {
+    int i = find_slot(lba);
+    if (i >= 0) {
+        stats.hits++;
+        lru_unlink(i);
+        lru_push_front(i);
+        return i;
+    }
+    stats.misses++;
+
+    uint32_t count = 1;
+    uint32_t end = ata_sector_count();
+    while (count < BCACHE_READAHEAD && lba + count < end && find_slot(lba + count) < 0) {
+        count++;
+    }
+
+    if (ata_read(lba, count, read_staging) < 0) return -1;
+    stats.disk_reads++;
+    stats.bytes_read += count * ATA_SECTOR_SIZE;
+
+    // Insert the read-ahead sectors first so the requested one ends up
+    // most recently used
+    for (uint32_t n = count; n-- > 1; ) {
+        if (insert(lba + n, read_staging + n * ATA_SECTOR_SIZE / 4) < 0) return -1;
+    }
+    return insert(lba, read_staging);
+}
+
+int bcache_read(uint32_t lba, void* buffer) {
+    int i = lookup(lba);
+    if (i < 0) return -1;
+    copy_sector(buffer, slots[i].data);
+    return 0;
+}
+
+int bcache_write(uint32_t lba, const void* buffer) {
+    int i = find_slot(lba);
+    if (i >= 0) {
+        stats.hits++;
+        lru_unlink(i);
+        lru_push_front(i);
+        copy_sector(slots[i].data, buffer);
+    } else {
+        // Whole-sector write: no need to read the old contents
+        stats.misses++;
+        i = insert(lba, buffer);
+        if (i < 0) return -1;
+    }
+
+    if (!slots[i].dirty) {
+        slots[i].dirty = 1;
+        stats.dirty++;
+    }
+    return 0;
+}
+
+void* bcache_pin(uint32_t lba, int mode) {
+    int i = mode == BCACHE_OVERWRITE ? find_slot(lba) : lookup(lba);
+    if (i >= 0 && mode == BCACHE_OVERWRITE) {
+        stats.hits++;
+        lru_unlink(i);
+        lru_push_front(i);
+    } else if (i < 0 && mode == BCACHE_OVERWRITE) {
+        stats.misses++;
+        i = insert(lba, 0);
+    }
+    if (i < 0) return 0;
+
+    slots[i].pins++;
+    return slots[i].data;
+}
+
+void bcache_unpin(const void* data, int dirty) {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* base = (const uint8_t*)slots;
+    if (p < base || p >= base + sizeof(slots)) return;
+
+    CacheSlot* slot = &slots[(p - base) / sizeof(CacheSlot)];
+    if (slot->pins) slot->pins--;
+    if (dirty && !slot->dirty) {
+        slot->dirty = 1;
+        stats.dirty++;
+    }
+}
+
+int bcache_flush(void) {
+    uint16_t order[BCACHE_SECTORS];
+    int count = 0;
+
+    // Dirty slots sorted by LBA (insertion sort, the list is short)
+    for (uint16_t i = 0; i < BCACHE_SECTORS; i++) {
+        if (!slots[i].valid || !slots[i].dirty) continue;
+        int j = count++;
+        while (j > 0 && slots[order[j - 1]].lba > slots[i].lba) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    // One write per run of consecutive sectors
+    int start = 0;
+    while (start < count) {
+        int run = 1;
+        while (start + run < count && run < BCACHE_BATCH &&
+               slots[order[start + run]].lba == slots[order[start]].lba + run) {
+            run++;
+        }
+
+        for (int n = 0; n < run; n++) {
+            copy_sector(write_staging + n * ATA_SECTOR_SIZE / 4, slots[order[start + n]].data);
+        }
+        if (ata_write(slots[order[start]].lba, run, write_staging) < 0) return -1;
+        stats.disk_writes++;
+        stats.bytes_written += run * ATA_SECTOR_SIZE;
+
+        for (int n = 0; n < run; n++) {
+            slots[order[start + n]].dirty = 0;
+        }
+        stats.dirty -= run;
+        start += run;
+    }
+    return 0;
+}
+
+void bcache_get_stats(BcacheStats* out) {
+    *out = stats;
+}
@@ -1,17 +1,71 @@
-; entry.asm - Kernel entry (already in protected mode from bootloader)
+; entry.asm - Kernel entry, from the VIN OS bootloader or a Multiboot loader
 [bits 32]
 
 global _start
 extern kernel_main
+extern multiboot_boot_info
+extern bss_start
+extern kernel_end
+
+MULTIBOOT_MAGIC equ 0x1BADB002
+MULTIBOOT_LOADER_MAGIC equ 0x2BADB002   ; In EAX when a Multiboot loader jumps here
+MULTIBOOT_MEMORY_INFO equ 1 << 1
+MULTIBOOT_VIDEO_MODE equ 1 << 2
+
+%ifdef VIN_FB
+MULTIBOOT_FLAGS equ MULTIBOOT_MEMORY_INFO | MULTIBOOT_VIDEO_MODE
+%else
+MULTIBOOT_FLAGS equ MULTIBOOT_MEMORY_INFO
+%endif
+
+KERNEL_STACK_TOP equ 0x90000            ; kernel/include/paging.h
 
 section .text
 _start:
-    ; We're already in protected mode with stack at 0x90000
-    ; Just call the kernel
+    jmp entry
+
+; Multiboot header: must be 4-byte aligned within the first 8 KB of the
+; file. The load address fields are unused, the loader reads the ELF
+; program headers instead.
+align 4
+multiboot_header:
+    dd MULTIBOOT_MAGIC
+    dd MULTIBOOT_FLAGS
+    dd -(MULTIBOOT_MAGIC + MULTIBOOT_FLAGS)
+    dd 0, 0, 0, 0, 0
+    dd 0                                ; Linear graphics mode, preferably...
+    dd 320, 200, 8                      ; ...320x200 with 8-bit color
+
+entry:
+    ; The bootloader leaves the stack at 0x90000 and the BootInfo pointer
+    ; in EBX. A Multiboot loader passes its own info block in EBX instead
+    ; and sets up no stack; convert its memory map and framebuffer into
+    ; BootInfo before .bss is touched.
+    cmp eax, MULTIBOOT_LOADER_MAGIC
+    jne .clear_bss
+    mov esp, KERNEL_STACK_TOP
+    mov ebp, esp
+    push ebx
+    call multiboot_boot_info
+    add esp, 4
+    mov ebx, eax
+    
+.clear_bss:
+    ; .bss is not in the flat binary, so whatever the BIOS left there is
+    ; still in memory: zero it before any C code runs
+    mov edi, bss_start
+    mov ecx, kernel_end
+    sub ecx, edi
+    xor eax, eax
+    cld
+    rep stosb
+    
+    ; EBX points at the BootInfo block, kernel_main's argument
+    push ebx
     call kernel_main
     
     ; If kernel returns, halt
     cli
 .hang:
     hlt
-    jmp .hang
\ No newline at end of file
+    jmp .hang
@@ -0,0 +1,67 @@
+// event.c - Event queues and the system input queue
+//
+// x86 keeps stores in program order, so a compiler barrier is all it
+// takes to publish a slot before the index that makes it visible.
+#include "include/event.h"
+#include "include/timer.h"
+
+#define barrier() __asm__ volatile ("" : : : "memory")
+
+static Event input_slots[INPUT_QUEUE_SIZE];
+static EventQueue input_queue;
+
+void event_queue_init(EventQueue* queue, Event* slots, uint32_t size) {
+    queue->slots = slots;
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->dropped = 0;
+}
+
+int event_queue_push(EventQueue* queue, const Event* event) {
+    uint32_t head = queue->head;
+    if (head - queue->tail > queue->mask) {
+        queue->dropped++;
+        return -1;
+    }
+
+    queue->slots[head & queue->mask] = *event;
+    barrier();
+    queue->head = head + 1;
+    return 0;
+}
+
+int event_queue_pop(EventQueue* queue, Event* event) {
+    uint32_t tail = queue->tail;
+    if (tail == queue->head) return 0;
+
+    barrier();
+    *event = queue->slots[tail & queue->mask];
+    barrier();
+    queue->tail = tail + 1;
+    return 1;
+}
+
+void event_init(void) {
+    event_queue_init(&input_queue, input_slots, INPUT_QUEUE_SIZE);
+}
+
+int event_post(uint8_t type, uint8_t modifiers, uint16_t key, uint32_t data) {
+    Event event;
+    event.type = type;
+    event.modifiers = modifiers;
+    event.key = key;
+    event.data = data;
+
+    int result = event_queue_push(&input_queue, &event);
+    event_signal();
+    return result;
+}
+
+int event_poll(Event* event) {
+    return event_queue_pop(&input_queue, event);
+}
+
+uint32_t event_dropped(void) {
+    return input_queue.dropped;
+}
@@ -0,0 +1,349 @@
+// fb.c - Mode 13h (320x200x8) framebuffer driver
+//
+// Everything draws into a RAM back buffer; fb_present() copies the rows
+// touched since the last present to the screen with 32-bit string moves.
+// The glyphs come from the VGA BIOS 8x8 ROM font, whose address the
+// bootloader stores in BootInfo before switching to mode 13h.
+//
+// Started by a Multiboot loader, the screen is the 8-bit framebuffer the
+// loader reports (the top-left 320x200 of it), or mode 13h set up here
+// through the VGA registers if the loader left text mode on.
+#include "include/fb.h"
+#include "include/bootinfo.h"
+#include "include/timer.h"
+#include "include/io.h"
+
+#define VGA_ADDRESS 0xA0000
+#define FONT_CHARS 128
+#define BENCH_FRAMES 100
+
+// Four pixels stored as one 32-bit word
+typedef uint32_t __attribute__((may_alias)) pixel4_t;
+
+static uint8_t back_buffer[FB_SIZE] __attribute__((aligned(4)));
+static uint8_t* screen = (uint8_t*)VGA_ADDRESS;
+static uint32_t screen_pitch = FB_WIDTH;
+static int dirty_y0 = FB_HEIGHT;   // Rows [dirty_y0, dirty_y1) need presenting
+static int dirty_y1 = 0;
+
+static uint8_t font[FONT_CHARS][8];         // Bit 7 = leftmost pixel
+static uint8_t narrow_font[FONT_CHARS][8];  // 4 px wide, bit 3 = leftmost
+static uint32_t expand4[16];                // 4-bit pixel mask -> byte mask
+
+static void mark_dirty(int y0, int y1) {
+    if (y0 < dirty_y0) dirty_y0 = y0;
+    if (y1 > dirty_y1) dirty_y1 = y1;
+}
+
+static void fill_dwords(void* dest, uint32_t value, uint32_t count) {
+    __asm__ volatile ("rep stosl"
+                      : "+D"(dest), "+c"(count)
+                      : "a"(value)
+                      : "memory");
+}
+
+static void copy_dwords(volatile void* dest, const void* src, uint32_t count) {
+    __asm__ volatile ("rep movsl"
+                      : "+D"(dest), "+S"(src), "+c"(count)
+                      :
+                      : "memory");
+}
+
+// Fill count pixels starting at p: byte stores up to a 4-byte boundary,
+// then whole dwords, then the tail
+static void fill_span(uint8_t* p, int count, uint8_t color) {
+    while (count > 0 && ((uint32_t)p & 3)) {
+        *p++ = color;
+        count--;
+    }
+    if (count >= 4) {
+        fill_dwords(p, color * 0x01010101u, count / 4);
+        p += count & ~3;
+        count &= 3;
+    }
+    while (count-- > 0) {
+        *p++ = color;
+    }
+}
+
+// Standard mode 13h register set
+static const uint8_t mode13_seq[5] = { 0x03, 0x01, 0x0F, 0x00, 0x0E };
+static const uint8_t mode13_crtc[25] = {
+    0x5F, 0x4F, 0x50, 0x82, 0x54, 0x80, 0xBF, 0x1F, 0x00, 0x41, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x9C, 0x0E, 0x8F, 0x28, 0x40, 0x96, 0xB9, 0xA3,
+    0xFF
+};
+static const uint8_t mode13_gc[9] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x05, 0x0F, 0xFF };
+static const uint8_t mode13_ac[21] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+    0x0C, 0x0D, 0x0E, 0x0F, 0x41, 0x00, 0x0F, 0x00, 0x00
+};
+
+// The 16 text colors (6-bit DAC values); the text mode DAC holds the
+// EGA palette instead
+static const uint8_t mode13_palette[16][3] = {
+    { 0, 0, 0 }, { 0, 0, 42 }, { 0, 42, 0 }, { 0, 42, 42 },
+    { 42, 0, 0 }, { 42, 0, 42 }, { 42, 21, 0 }, { 42, 42, 42 },
+    { 21, 21, 21 }, { 21, 21, 63 }, { 21, 63, 21 }, { 21, 63, 63 },
+    { 63, 21, 21 }, { 63, 21, 63 }, { 63, 63, 21 }, { 63, 63, 63 }
+};
+
+static void set_mode13(void) {
+    outb(0x3C2, 0x63);      // Miscellaneous output
+
+    for (int i = 0; i < 5; i++) {
+        outb(0x3C4, i);
+        outb(0x3C5, mode13_seq[i]);
+    }
+
+    // CRTC registers 0-7 are write protected by bit 7 of register 0x11
+    outb(0x3D4, 0x11);
+    outb(0x3D5, inb(0x3D5) & 0x7F);
+    for (int i = 0; i < 25; i++) {
+        outb(0x3D4, i);
+        outb(0x3D5, mode13_crtc[i]);
+    }
+
+    for (int i = 0; i < 9; i++) {
+        outb(0x3CE, i);
+        outb(0x3CF, mode13_gc[i]);
+    }
+
+    // Reading 0x3DA resets the attribute controller to its index state
+    for (int i = 0; i < 21; i++) {
+        inb(0x3DA);
+        outb(0x3C0, i);
+        outb(0x3C0, mode13_ac[i]);
+    }
+    inb(0x3DA);
+    outb(0x3C0, 0x20);      // Palette done, enable the display
+
+    outb(0x3C8, 0);
+    for (int i = 0; i < 16; i++) {
+        outb(0x3C9, mode13_palette[i][0]);
+        outb(0x3C9, mode13_palette[i][1]);
+        outb(0x3C9, mode13_palette[i][2]);
+    }
+}
+
+static void select_screen(void) {
+    volatile BootInfo* boot = get_boot_info();
+    if (!(boot->flags & BOOT_MULTIBOOT)) return;    // Bootloader set mode 13h
+
+    if (boot->fb_addr != 0 && boot->fb_bpp == 8 &&
+        boot->fb_width >= FB_WIDTH && boot->fb_height >= FB_HEIGHT) {
+        screen = (uint8_t*)boot->fb_addr;
+        screen_pitch = boot->fb_pitch;
+    } else {
+        set_mode13();
+    }
+}
+
+void fb_init() {
+    const uint8_t* rom = (const uint8_t*)get_boot_info()->font8x8;
+
+    select_screen();
+
+    for (int c = 0; c < FONT_CHARS; c++) {
+        for (int row = 0; row < 8; row++) {
+            uint8_t bits = rom ? rom[c * 8 + row] : 0xFF;
+            font[c][row] = bits;
+
+            // Squeeze 8 px into 4 by OR-ing column pairs, so 80 text
+            // columns fit into 320 pixels
+            uint8_t narrow = 0;
+            for (int px = 0; px < 4; px++) {
+                if (bits & (0xC0 >> (px * 2))) {
+                    narrow |= 0x08 >> px;
+                }
+            }
+            narrow_font[c][row] = narrow;
+        }
+    }
+
+    for (int n = 0; n < 16; n++) {
+        uint32_t mask = 0;
+        for (int px = 0; px < 4; px++) {
+            if (n & (0x08 >> px)) {
+                mask |= 0xFFu << (px * 8);
+            }
+        }
+        expand4[n] = mask;
+    }
+
+    fb_clear(COLOR_BLACK);
+}
+
+void fb_put_pixel(int x, int y, uint8_t color) {
+    if (x < 0 || y < 0 || x >= FB_WIDTH || y >= FB_HEIGHT) return;
+    back_buffer[y * FB_WIDTH + x] = color;
+    mark_dirty(y, y + 1);
+}
+
+void fb_clear(uint8_t color) {
+    fill_dwords(back_buffer, color * 0x01010101u, FB_SIZE / 4);
+    mark_dirty(0, FB_HEIGHT);
+}
+
+void fb_fill_rect(int x, int y, int width, int height, uint8_t color) {
+    int x_end = x + width;
+    int y_end = y + height;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x_end > FB_WIDTH) x_end = FB_WIDTH;
+    if (y_end > FB_HEIGHT) y_end = FB_HEIGHT;
+    if (x >= x_end || y >= y_end) return;
+
+    for (int row = y; row < y_end; row++) {
+        fill_span(&back_buffer[row * FB_WIDTH + x], x_end - x, color);
+    }
+    mark_dirty(y, y_end);
+}
+
+void fb_draw_rect(int x, int y, int width, int height, uint8_t color) {
+    fb_fill_rect(x, y, width, 1, color);
+    fb_fill_rect(x, y + height - 1, width, 1, color);
+    fb_fill_rect(x, y, 1, height, color);
+    fb_fill_rect(x + width - 1, y, 1, height, color);
+}
+
+// Bresenham, all octants
+void fb_draw_line(int x0, int y0, int x1, int y1, uint8_t color) {
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int dy = y1 > y0 ? y0 - y1 : y1 - y0;
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+
+    while (1) {
+        fb_put_pixel(x0, y0, color);
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+// Midpoint circle, plotting all eight octants per step
+void fb_draw_circle(int x, int y, int radius, uint8_t color) {
+    int dx = radius;
+    int dy = 0;
+    int err = 1 - radius;
+
+    while (dx >= dy) {
+        fb_put_pixel(x + dx, y + dy, color);
+        fb_put_pixel(x + dy, y + dx, color);
+        fb_put_pixel(x - dy, y + dx, color);
+        fb_put_pixel(x - dx, y + dy, color);
+        fb_put_pixel(x - dx, y - dy, color);
+        fb_put_pixel(x - dy, y - dx, color);
+        fb_put_pixel(x + dy, y - dx, color);
+        fb_put_pixel(x + dx, y - dy, color);
+
+        dy++;
+        if (err < 0) {
+            err += 2 * dy + 1;
+        } else {
+            dx--;
+            err += 2 * (dy - dx) + 1;
+        }
+    }
+}
+
+void fb_draw_char(char c, int x, int y, uint8_t fg_color, uint8_t bg_color) {
+    const uint8_t* glyph = font[(uint8_t)c & (FONT_CHARS - 1)];
+
+    if (x < 0 || y < 0 || x + 8 > FB_WIDTH || y + 8 > FB_HEIGHT) {
+        // Partially off screen: clip per pixel
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++) {
+                uint8_t color = (glyph[row] & (0x80 >> col)) ? fg_color : bg_color;
+                fb_put_pixel(x + col, y + row, color);
+            }
+        }
+        return;
+    }
+
+    uint8_t* p = &back_buffer[y * FB_WIDTH + x];
+    for (int row = 0; row < 8; row++) {
+        uint8_t bits = glyph[row];
+        for (int col = 0; col < 8; col++) {
+            p[col] = (bits & (0x80 >> col)) ? fg_color : bg_color;
+        }
+        p += FB_WIDTH;
+    }
+    mark_dirty(y, y + 8);
+}
+
+void fb_write_string(const char* str, int x, int y, uint8_t fg_color, uint8_t bg_color) {
+    for (int i = 0; str[i] != '\0'; i++) {
+        fb_draw_char(str[i], x + i * 8, y, fg_color, bg_color);
+    }
+}
+
+void fb_draw_text_cell(int col, int row, uint16_t entry) {
+    if (col < 0 || row < 0 || col >= FB_TEXT_COLS || row >= FB_TEXT_ROWS) return;
+
+    const uint8_t* glyph = narrow_font[entry & (FONT_CHARS - 1)];
+    uint32_t fg = ((entry >> 8) & 0x0F) * 0x01010101u;
+    uint32_t bg = ((entry >> 12) & 0x0F) * 0x01010101u;
+
+    // Cells are 4 px wide and dword aligned: one store per glyph row
+    int y = row * 8;
+    pixel4_t* p = (pixel4_t*)&back_buffer[y * FB_WIDTH + col * 4];
+    for (int r = 0; r < 8; r++) {
+        uint32_t mask = expand4[glyph[r]];
+        *p = (fg & mask) | (bg & ~mask);
+        p += FB_WIDTH / 4;
+    }
+    mark_dirty(y, y + 8);
+}
+
+void fb_present() {
+    if (dirty_y0 >= dirty_y1) return;
+
+    if (screen_pitch == FB_WIDTH) {
+        copy_dwords(screen + dirty_y0 * FB_WIDTH,
+                    &back_buffer[dirty_y0 * FB_WIDTH],
+                    (dirty_y1 - dirty_y0) * FB_WIDTH / 4);
+    } else {
+        for (int y = dirty_y0; y < dirty_y1; y++) {
+            copy_dwords(screen + y * screen_pitch, &back_buffer[y * FB_WIDTH], FB_WIDTH / 4);
+        }
+    }
+
+    dirty_y0 = FB_HEIGHT;
+    dirty_y1 = 0;
+}
+
+static uint32_t frames_per_second(uint32_t frames, uint32_t elapsed_ms) {
+    if (elapsed_ms == 0) elapsed_ms = 1;
+    return frames * 1000 / elapsed_ms;
+}
+
+void fb_benchmark(FbBenchResult* result) {
+    uint32_t start = uptime_ms();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        fb_clear(i & 0x0F);
+        fb_present();
+    }
+    result->clear_fps = frames_per_second(BENCH_FRAMES, uptime_ms() - start);
+
+    start = uptime_ms();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        uint16_t attr = (uint16_t)(((i & 7) << 4) | 0x0F) << 8;
+        for (int row = 0; row < FB_TEXT_ROWS; row++) {
+            for (int col = 0; col < FB_TEXT_COLS; col++) {
+                fb_draw_text_cell(col, row, attr | ('A' + (col + row + i) % 26));
+            }
+        }
+        fb_present();
+    }
+    result->text_fps = frames_per_second(BENCH_FRAMES, uptime_ms() - start);
+}
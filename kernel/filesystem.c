@@ -1,126 +1,1175 @@
-// filesystem.c - Simple in-memory file system implementation
+// filesystem.c - VinFS on-disk file system implementation
+//
+// Layout, in FS_BLOCK_SIZE blocks from FS_START_LBA:
+//   0                  superblock
+//   bitmap_start..     block allocation bitmap
+//   inode_start..      inode table
+//   data_start..       file and directory data
+//
+// Blocks go through the sector cache (bcache.c), and file data is copied
+// straight between the caller and the cached sector. Each public call that
+// changes the disk ends with bcache_flush, so its writes reach the disk as a
+// few batched transfers and files survive a reboot; blocks filled in place
+// through fs_extent are flushed when the handle is closed. The same code is
+// built into the host mkfs tool (tools/mkfs.c), which supplies its own ata_*
+// functions backed by the image file.
 #include "include/filesystem.h"
+#include "include/ata.h"
+#include "include/bcache.h"
+#include "include/heap.h"
+#include "include/sched.h"
+#include "include/string.h"
 
-static FileSystem fs;
+#define BITS_PER_BLOCK (FS_BLOCK_SIZE * 8)
 
-static void str_copy(char* dest, const char* src, int max_len) {
-    int i = 0;
-    while (src[i] != '\0' && i < max_len - 1) {
-        dest[i] = src[i];
-        i++;
+static Superblock sb;
+static int mounted = 0;
+static uint32_t generation = 0;     // Bumped whenever names are added or removed
+
+typedef struct {
+    uint32_t inode;             // 0 once the file has been deleted
+    int used;
+    int wrote;                  // Flush on close
+    char* extent;               // Pinned by fs_extent until fs_commit
+    uint32_t extent_offset;
+} FsHandle;
+
+static FsHandle* handles = 0;      // Grows as needed
+static int handle_capacity = 0;
+static Mutex fs_mutex;
+
+// ---- Block and superblock I/O ----
+
+static int read_block(uint32_t block, void* buffer) {
+    return bcache_read(FS_START_LBA + block, buffer);
+}
+
+static int write_block(uint32_t block, const void* buffer) {
+    return bcache_write(FS_START_LBA + block, buffer);
+}
+
+// The cached block itself; bcache_unpin it when done
+static void* pin_block(uint32_t block, int mode) {
+    return bcache_pin(FS_START_LBA + block, mode);
+}
+
+static int zero_block(uint32_t block) {
+    uint32_t zeros[FS_BLOCK_SIZE / 4];
+    memset(zeros, 0, sizeof(zeros));
+    return write_block(block, zeros);
+}
+
+static int write_superblock(void) {
+    uint32_t buffer[FS_BLOCK_SIZE / 4];
+    memset(buffer, 0, sizeof(buffer));
+    memcpy(buffer, &sb, sizeof(sb));
+    return write_block(0, buffer);
+}
+
+// ---- Block allocation ----
+
+// Returns a zeroed block, or 0 when the disk is full
+static uint32_t alloc_block(void) {
+    uint8_t bits[FS_BLOCK_SIZE];
+
+    if (sb.free_blocks == 0) return 0;
+
+    for (uint32_t b = 0; b < sb.bitmap_blocks; b++) {
+        if (read_block(sb.bitmap_start + b, bits) < 0) return 0;
+
+        for (uint32_t i = 0; i < FS_BLOCK_SIZE; i++) {
+            if (bits[i] == 0xFF) continue;
+
+            for (int bit = 0; bit < 8; bit++) {
+                if (bits[i] & (1 << bit)) continue;
+
+                uint32_t block = b * BITS_PER_BLOCK + i * 8 + bit;
+                if (block >= sb.total_blocks) return 0;
+
+                bits[i] |= 1 << bit;
+                if (write_block(sb.bitmap_start + b, bits) < 0) return 0;
+                sb.free_blocks--;
+                write_superblock();
+                zero_block(block);
+                return block;
+            }
+        }
     }
-    dest[i] = '\0';
+    return 0;
 }
 
-static int str_compare(const char* s1, const char* s2) {
-    int i = 0;
-    while (s1[i] != '\0' && s2[i] != '\0') {
-        if (s1[i] != s2[i]) return 0;
-        i++;
+static void free_block(uint32_t block) {
+    uint8_t bits[FS_BLOCK_SIZE];
+    uint32_t b = block / BITS_PER_BLOCK;
+    uint32_t bit = block % BITS_PER_BLOCK;
+
+    if (block < sb.data_start || block >= sb.total_blocks) return;
+    if (read_block(sb.bitmap_start + b, bits) < 0) return;
+
+    bits[bit / 8] &= ~(1 << (bit % 8));
+    write_block(sb.bitmap_start + b, bits);
+    sb.free_blocks++;
+    write_superblock();
+}
+
+// ---- Inodes ----
+
+// Both copy just the one inode, in place in the cached table block
+static int load_inode(uint32_t ino, Inode* out) {
+    if (ino == 0 || ino >= sb.inode_count) return -1;
+    Inode* table = (Inode*)pin_block(sb.inode_start + ino / FS_INODES_PER_BLOCK, BCACHE_READ);
+    if (table == 0) return -1;
+
+    *out = table[ino % FS_INODES_PER_BLOCK];
+    bcache_unpin(table, 0);
+    return 0;
+}
+
+static int store_inode(uint32_t ino, const Inode* in) {
+    if (ino == 0 || ino >= sb.inode_count) return -1;
+    Inode* table = (Inode*)pin_block(sb.inode_start + ino / FS_INODES_PER_BLOCK, BCACHE_READ);
+    if (table == 0) return -1;
+
+    table[ino % FS_INODES_PER_BLOCK] = *in;
+    bcache_unpin(table, 1);
+    return 0;
+}
+
+static uint32_t alloc_inode(uint16_t type) {
+    Inode table[FS_INODES_PER_BLOCK];
+
+    if (sb.free_inodes == 0) return 0;
+
+    for (uint32_t b = 0; b < sb.inode_blocks; b++) {
+        if (read_block(sb.inode_start + b, table) < 0) return 0;
+
+        for (uint32_t i = 0; i < FS_INODES_PER_BLOCK; i++) {
+            uint32_t ino = b * FS_INODES_PER_BLOCK + i;
+            if (ino == 0 || table[i].type != FS_TYPE_FREE) continue;
+
+            memset(&table[i], 0, sizeof(Inode));
+            table[i].type = type;
+            table[i].links = 1;
+            if (write_block(sb.inode_start + b, table) < 0) return 0;
+
+            sb.free_inodes--;
+            write_superblock();
+            return ino;
+        }
     }
-    return s1[i] == s2[i];
+    return 0;
 }
 
-void init_filesystem(void) {
-    fs.file_count = 0;
-    for (int i = 0; i < MAX_FILES; i++) {
-        fs.files[i].used = 0;
-        fs.files[i].size = 0;
-        fs.files[i].name[0] = '\0';
+// Follow one level of block pointers, allocating the target if asked
+static uint32_t map_through(uint32_t table_block, uint32_t slot, int alloc) {
+    uint32_t* ptrs = (uint32_t*)pin_block(table_block, BCACHE_READ);
+    if (ptrs == 0) return 0;
+
+    uint32_t block = ptrs[slot];
+    int dirty = 0;
+    if (block == 0 && alloc) {
+        block = alloc_block();
+        ptrs[slot] = block;
+        dirty = block != 0;
     }
+    bcache_unpin(ptrs, dirty);
+    return block;
 }
 
-int fs_create_file(const char* name) {
-    // Check if file already exists
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (fs.files[i].used && str_compare(fs.files[i].name, name)) {
-            return i; // File already exists, return its index
+// Disk block holding block `index` of the file, or 0 if there is none.
+// Sets *changed when a pointer stored in the inode itself was allocated.
+static uint32_t bmap(Inode* inode, uint32_t index, int alloc, int* changed) {
+    if (index < FS_DIRECT_BLOCKS) {
+        if (inode->direct[index] == 0 && alloc) {
+            inode->direct[index] = alloc_block();
+            *changed = 1;
         }
+        return inode->direct[index];
     }
-    
-    // Find empty slot
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (!fs.files[i].used) {
-            fs.files[i].used = 1;
-            str_copy(fs.files[i].name, name, MAX_FILENAME);
-            fs.files[i].size = 0;
-            fs.file_count++;
-            return i;
+    index -= FS_DIRECT_BLOCKS;
+
+    if (index < FS_PTRS_PER_BLOCK) {
+        if (inode->indirect == 0) {
+            if (!alloc) return 0;
+            inode->indirect = alloc_block();
+            if (inode->indirect == 0) return 0;
+            *changed = 1;
         }
+        return map_through(inode->indirect, index, alloc);
     }
-    
-    return -1; // No space
+    index -= FS_PTRS_PER_BLOCK;
+
+    if (index < FS_PTRS_PER_BLOCK * FS_PTRS_PER_BLOCK) {
+        if (inode->double_indirect == 0) {
+            if (!alloc) return 0;
+            inode->double_indirect = alloc_block();
+            if (inode->double_indirect == 0) return 0;
+            *changed = 1;
+        }
+        uint32_t table = map_through(inode->double_indirect, index / FS_PTRS_PER_BLOCK, alloc);
+        if (table == 0) return 0;
+        return map_through(table, index % FS_PTRS_PER_BLOCK, alloc);
+    }
+
+    return 0;  // Beyond the largest supported file
 }
 
-int fs_write_file(const char* name, const char* data, int size) {
-    if (size > MAX_FILE_SIZE) {
-        size = MAX_FILE_SIZE;
+static void free_table(uint32_t table_block, int depth) {
+    uint32_t ptrs[FS_PTRS_PER_BLOCK];
+
+    if (read_block(table_block, ptrs) == 0) {
+        for (uint32_t i = 0; i < FS_PTRS_PER_BLOCK; i++) {
+            if (ptrs[i] == 0) continue;
+            if (depth > 0) {
+                free_table(ptrs[i], depth - 1);
+            } else {
+                free_block(ptrs[i]);
+            }
+        }
     }
-    
-    int idx = fs_create_file(name);
-    if (idx < 0) return -1;
-    
-    for (int i = 0; i < size; i++) {
-        fs.files[idx].data[i] = data[i];
+    free_block(table_block);
+}
+
+// Release every data block; the caller stores the inode afterwards
+static void inode_truncate(Inode* inode) {
+    for (int i = 0; i < FS_DIRECT_BLOCKS; i++) {
+        if (inode->direct[i]) free_block(inode->direct[i]);
+        inode->direct[i] = 0;
     }
-    fs.files[idx].size = size;
-    
-    return size;
+    if (inode->indirect) free_table(inode->indirect, 0);
+    if (inode->double_indirect) free_table(inode->double_indirect, 1);
+    inode->indirect = 0;
+    inode->double_indirect = 0;
+    inode->size = 0;
 }
 
-int fs_read_file(const char* name, char* buffer, int max_size) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (fs.files[i].used && str_compare(fs.files[i].name, name)) {
-            int size = fs.files[i].size;
-            if (size > max_size) size = max_size;
-            
-            for (int j = 0; j < size; j++) {
-                buffer[j] = fs.files[i].data[j];
+static int inode_read(Inode* inode, uint32_t offset, void* buffer, uint32_t len) {
+    uint8_t* out = (uint8_t*)buffer;
+    uint32_t done = 0;
+    int unused = 0;
+
+    if (offset >= inode->size) return 0;
+    if (len > inode->size - offset) len = inode->size - offset;
+
+    while (done < len) {
+        uint32_t pos = offset + done;
+        uint32_t in_block = pos % FS_BLOCK_SIZE;
+        uint32_t chunk = FS_BLOCK_SIZE - in_block;
+        if (chunk > len - done) chunk = len - done;
+
+        uint32_t disk_block = bmap(inode, pos / FS_BLOCK_SIZE, 0, &unused);
+        if (disk_block == 0) {
+            memset(out + done, 0, chunk);  // Hole
+        } else {
+            const uint8_t* block = (const uint8_t*)pin_block(disk_block, BCACHE_READ);
+            if (block == 0) return -1;
+            memcpy(out + done, block + in_block, chunk);
+            bcache_unpin(block, 0);
+        }
+        done += chunk;
+    }
+    return done;
+}
+
+static int inode_write(uint32_t ino, Inode* inode, uint32_t offset, const void* data, uint32_t len) {
+    const uint8_t* in = (const uint8_t*)data;
+    uint32_t done = 0;
+    int changed = 0;
+
+    while (done < len) {
+        uint32_t pos = offset + done;
+        uint32_t in_block = pos % FS_BLOCK_SIZE;
+        uint32_t chunk = FS_BLOCK_SIZE - in_block;
+        if (chunk > len - done) chunk = len - done;
+
+        uint32_t disk_block = bmap(inode, pos / FS_BLOCK_SIZE, 1, &changed);
+        if (disk_block == 0) break;  // Disk full
+
+        // Only a partial block needs its old contents
+        uint8_t* block = (uint8_t*)pin_block(disk_block, chunk < FS_BLOCK_SIZE ? BCACHE_READ : BCACHE_OVERWRITE);
+        if (block == 0) break;
+        memcpy(block + in_block, in + done, chunk);
+        bcache_unpin(block, 1);
+        done += chunk;
+    }
+
+    if (offset + done > inode->size) {
+        inode->size = offset + done;
+        changed = 1;
+    }
+    if (changed) {
+        store_inode(ino, inode);
+    }
+    return done;
+}
+
+// ---- Name index ----
+//
+// The first search of a directory loads all its entries into a hash table
+// keyed on (directory inode, name). From then on lookups, creates and
+// deletes in that directory touch only the blocks they change. Entries
+// come from a slab cache; a directory whose entries cannot all be
+// allocated is scanned block by block instead.
+
+typedef struct NameEntry {
+    uint32_t dir;               // Directory inode
+    uint32_t inode;
+    uint32_t hash;
+    uint32_t block;             // Disk block and slot of the DirEntry
+    uint32_t slot;
+    struct NameEntry* next;     // Hash chain
+    char name[FS_NAME_MAX + 1];
+} NameEntry;
+
+typedef struct {
+    uint32_t inode;             // 0 = unused record
+    uint32_t entries;           // Names in the directory
+    uint32_t free_slots;        // Empty DirEntry slots within its size
+    uint32_t hole_block;        // Block of the last removed entry, or 0
+    int complete;               // 0: too big for the index, always scan
+} IndexedDir;
+
+static KmemCache name_cache;
+static NameEntry* name_buckets[FS_INDEX_BUCKETS];
+static IndexedDir indexed_dirs[FS_INDEX_DIRS];
+
+// FNV-1a over the name, seeded with the directory
+static uint32_t name_hash(uint32_t dir, const char* name) {
+    uint32_t h = 2166136261u ^ dir;
+    for (int i = 0; name[i] != '\0'; i++) {
+        h = (h ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void index_reset(void) {
+    if (name_cache.object_size == 0) {
+        kmem_cache_init(&name_cache, "fs-name", sizeof(NameEntry));
+    }
+    for (int i = 0; i < FS_INDEX_BUCKETS; i++) {
+        while (name_buckets[i]) {
+            NameEntry* e = name_buckets[i];
+            name_buckets[i] = e->next;
+            kmem_cache_free(&name_cache, e);
+        }
+    }
+    for (int i = 0; i < FS_INDEX_DIRS; i++) {
+        indexed_dirs[i].inode = 0;
+    }
+}
+
+static NameEntry* index_find(uint32_t dir, const char* name) {
+    uint32_t hash = name_hash(dir, name);
+
+    for (NameEntry* e = name_buckets[hash % FS_INDEX_BUCKETS]; e; e = e->next) {
+        if (e->hash == hash && e->dir == dir && strcmp(e->name, name) == 0) {
+            return e;
+        }
+    }
+    return 0;
+}
+
+static int index_insert(uint32_t dir, const DirEntry* entry, uint32_t block, uint16_t slot) {
+    NameEntry* e = (NameEntry*)kmem_cache_alloc(&name_cache);
+    if (e == 0) return -1;
+
+    e->dir = dir;
+    e->inode = entry->inode;
+    e->hash = name_hash(dir, entry->name);
+    e->block = block;
+    e->slot = slot;
+    strlcpy(e->name, entry->name, FS_NAME_MAX + 1);
+
+    NameEntry** bucket = &name_buckets[e->hash % FS_INDEX_BUCKETS];
+    e->next = *bucket;
+    *bucket = e;
+    return 0;
+}
+
+static void index_remove(NameEntry* e) {
+    NameEntry** link = &name_buckets[e->hash % FS_INDEX_BUCKETS];
+
+    while (*link) {
+        if (*link == e) {
+            *link = e->next;
+            kmem_cache_free(&name_cache, e);
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+// Drop every name of a directory, e.g. when it turns out not to fit
+static void index_drop_dir(IndexedDir* rec) {
+    for (int b = 0; b < FS_INDEX_BUCKETS; b++) {
+        NameEntry** link = &name_buckets[b];
+        while (*link) {
+            NameEntry* e = *link;
+            if (e->dir == rec->inode) {
+                *link = e->next;
+                kmem_cache_free(&name_cache, e);
+            } else {
+                link = &e->next;
             }
-            
-            return size;
         }
     }
-    return -1; // File not found
+    rec->complete = 0;
 }
 
-int fs_delete_file(const char* name) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (fs.files[i].used && str_compare(fs.files[i].name, name)) {
-            fs.files[i].used = 0;
-            fs.files[i].size = 0;
-            fs.file_count--;
+static void index_forget_dir(uint32_t dir_ino) {
+    for (int i = 0; i < FS_INDEX_DIRS; i++) {
+        if (indexed_dirs[i].inode == dir_ino) {
+            if (indexed_dirs[i].complete) index_drop_dir(&indexed_dirs[i]);
+            indexed_dirs[i].inode = 0;
+        }
+    }
+}
+
+// Index record for a directory, built on first use. 0 when the directory
+// has to be scanned.
+static IndexedDir* dir_index(uint32_t dir_ino, Inode* dir) {
+    DirEntry entries[FS_DIRENTS_PER_BLOCK];
+    IndexedDir* rec = 0;
+    int unused = 0;
+
+    for (int i = 0; i < FS_INDEX_DIRS; i++) {
+        if (indexed_dirs[i].inode == dir_ino) {
+            return indexed_dirs[i].complete ? &indexed_dirs[i] : 0;
+        }
+        if (indexed_dirs[i].inode == 0 && rec == 0) {
+            rec = &indexed_dirs[i];
+        }
+    }
+    if (rec == 0) return 0;
+
+    rec->inode = dir_ino;
+    rec->entries = 0;
+    rec->free_slots = 0;
+    rec->hole_block = 0;
+    rec->complete = 1;
+
+    uint32_t blocks = (dir->size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t disk_block = bmap(dir, b, 0, &unused);
+        if (disk_block == 0 || read_block(disk_block, entries) < 0) {
+            index_drop_dir(rec);
             return 0;
         }
+
+        for (uint32_t i = 0; i < FS_DIRENTS_PER_BLOCK; i++) {
+            if (entries[i].inode == 0) {
+                rec->free_slots++;
+            } else if (index_insert(dir_ino, &entries[i], disk_block, i) < 0) {
+                index_drop_dir(rec);
+                return 0;
+            } else {
+                rec->entries++;
+            }
+        }
     }
-    return -1; // File not found
+    return rec;
 }
 
-int fs_list_files(char filenames[][MAX_FILENAME], int max_files) {
-    int count = 0;
-    for (int i = 0; i < MAX_FILES && count < max_files; i++) {
-        if (fs.files[i].used) {
-            str_copy(filenames[count], fs.files[i].name, MAX_FILENAME);
-            count++;
+// ---- Directories ----
+
+static uint32_t dir_lookup(uint32_t dir_ino, Inode* dir, const char* name) {
+    DirEntry entries[FS_DIRENTS_PER_BLOCK];
+    int unused = 0;
+
+    if (dir_index(dir_ino, dir)) {
+        NameEntry* e = index_find(dir_ino, name);
+        return e ? e->inode : 0;
+    }
+
+    uint32_t blocks = (dir->size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t disk_block = bmap(dir, b, 0, &unused);
+        if (disk_block == 0 || read_block(disk_block, entries) < 0) continue;
+
+        for (uint32_t i = 0; i < FS_DIRENTS_PER_BLOCK; i++) {
+            if (entries[i].inode != 0 && strcmp(entries[i].name, name) == 0) {
+                return entries[i].inode;
+            }
         }
     }
-    return count;
+    return 0;
 }
 
-int fs_file_exists(const char* name) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (fs.files[i].used && str_compare(fs.files[i].name, name)) {
-            return 1;
+static int dir_add(uint32_t dir_ino, Inode* dir, const char* name, uint32_t ino, uint8_t type) {
+    DirEntry entries[FS_DIRENTS_PER_BLOCK];
+    IndexedDir* rec = dir_index(dir_ino, dir);
+    uint32_t blocks = (dir->size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+    uint32_t disk_block = 0;
+    uint32_t slot = 0;
+    int changed = 0;
+
+    // Reuse a free slot if there is one. The index knows when there is
+    // none, and usually where the last one was freed.
+    if (rec && rec->free_slots > 0 && rec->hole_block != 0 &&
+        read_block(rec->hole_block, entries) == 0) {
+        for (slot = 0; slot < FS_DIRENTS_PER_BLOCK; slot++) {
+            if (entries[slot].inode == 0) {
+                disk_block = rec->hole_block;
+                break;
+            }
+        }
+        rec->hole_block = 0;
+    }
+    if (disk_block == 0 && (rec == 0 || rec->free_slots > 0)) {
+        for (uint32_t b = 0; b < blocks && disk_block == 0; b++) {
+            uint32_t candidate = bmap(dir, b, 0, &changed);
+            if (candidate == 0 || read_block(candidate, entries) < 0) continue;
+
+            for (slot = 0; slot < FS_DIRENTS_PER_BLOCK; slot++) {
+                if (entries[slot].inode == 0) {
+                    disk_block = candidate;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (disk_block != 0) {
+        if (rec) rec->free_slots--;
+    } else {
+        // Otherwise grow the directory by one block
+        disk_block = bmap(dir, blocks, 1, &changed);
+        if (disk_block == 0) return -1;
+
+        memset(entries, 0, sizeof(entries));
+        slot = 0;
+        dir->size += FS_BLOCK_SIZE;
+        if (store_inode(dir_ino, dir) < 0) return -1;
+        if (rec) rec->free_slots += FS_DIRENTS_PER_BLOCK - 1;
+    }
+
+    entries[slot].inode = ino;
+    entries[slot].type = type;
+    strlcpy(entries[slot].name, name, FS_NAME_MAX + 1);
+    if (write_block(disk_block, entries) < 0) return -1;
+
+    if (rec) {
+        if (index_insert(dir_ino, &entries[slot], disk_block, slot) < 0) {
+            index_drop_dir(rec);
+        } else {
+            rec->entries++;
         }
     }
     return 0;
 }
 
-int fs_get_file_size(const char* name) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (fs.files[i].used && str_compare(fs.files[i].name, name)) {
-            return fs.files[i].size;
+static int dir_remove(uint32_t dir_ino, Inode* dir, const char* name) {
+    DirEntry entries[FS_DIRENTS_PER_BLOCK];
+    IndexedDir* rec = dir_index(dir_ino, dir);
+    int unused = 0;
+
+    if (rec) {
+        NameEntry* e = index_find(dir_ino, name);
+        if (e == 0 || read_block(e->block, entries) < 0) return -1;
+
+        entries[e->slot].inode = 0;
+        if (write_block(e->block, entries) < 0) return -1;
+        rec->hole_block = e->block;
+        index_remove(e);
+        rec->entries--;
+        rec->free_slots++;
+        return 0;
+    }
+
+    uint32_t blocks = (dir->size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t disk_block = bmap(dir, b, 0, &unused);
+        if (disk_block == 0 || read_block(disk_block, entries) < 0) continue;
+
+        for (uint32_t i = 0; i < FS_DIRENTS_PER_BLOCK; i++) {
+            if (entries[i].inode != 0 && strcmp(entries[i].name, name) == 0) {
+                entries[i].inode = 0;
+                return write_block(disk_block, entries);
+            }
         }
     }
     return -1;
-}
\ No newline at end of file
+}
+
+static int dir_is_empty(uint32_t dir_ino, Inode* dir) {
+    DirEntry entries[FS_DIRENTS_PER_BLOCK];
+    IndexedDir* rec = dir_index(dir_ino, dir);
+    int unused = 0;
+
+    if (rec) return rec->entries == 0;
+
+    uint32_t blocks = (dir->size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t disk_block = bmap(dir, b, 0, &unused);
+        if (disk_block == 0 || read_block(disk_block, entries) < 0) continue;
+
+        for (uint32_t i = 0; i < FS_DIRENTS_PER_BLOCK; i++) {
+            if (entries[i].inode != 0) return 0;
+        }
+    }
+    return 1;
+}
+
+// ---- Paths ----
+
+// Walk every component but the last. On success *parent is the directory
+// that should contain `leaf`.
+static int resolve_parent(const char* path, uint32_t* parent, char* leaf) {
+    uint32_t dir = FS_ROOT_INODE;
+    const char* p = path;
+
+    while (*p == '/') p++;
+    if (*p == '\0') return -1;
+
+    while (1) {
+        char part[FS_NAME_MAX + 1];
+        int len = 0;
+        while (*p != '\0' && *p != '/') {
+            if (len >= FS_NAME_MAX) return -1;
+            part[len++] = *p++;
+        }
+        part[len] = '\0';
+        while (*p == '/') p++;
+
+        if (*p == '\0') {
+            strlcpy(leaf, part, FS_NAME_MAX + 1);
+            *parent = dir;
+            return 0;
+        }
+
+        Inode node;
+        if (load_inode(dir, &node) < 0) return -1;
+        uint32_t child = dir_lookup(dir, &node, part);
+        if (child == 0 || load_inode(child, &node) < 0) return -1;
+        if (node.type != FS_TYPE_DIR) return -1;
+        dir = child;
+    }
+}
+
+// Inode number for a path, 0 if it does not exist. "" and "/" are the root.
+static uint32_t lookup_path(const char* path) {
+    const char* p = path;
+    while (*p == '/') p++;
+    if (*p == '\0') return FS_ROOT_INODE;
+
+    uint32_t parent;
+    char leaf[FS_NAME_MAX + 1];
+    Inode dir;
+    if (resolve_parent(path, &parent, leaf) < 0) return 0;
+    if (load_inode(parent, &dir) < 0) return 0;
+    return dir_lookup(parent, &dir, leaf);
+}
+
+// Existing node of the same type, or a new one
+static int create_node(const char* path, uint16_t type) {
+    uint32_t parent;
+    char leaf[FS_NAME_MAX + 1];
+    Inode dir;
+    Inode node;
+
+    if (!mounted) return -1;
+    if (resolve_parent(path, &parent, leaf) < 0) return -1;
+    if (load_inode(parent, &dir) < 0) return -1;
+
+    uint32_t existing = dir_lookup(parent, &dir, leaf);
+    if (existing != 0) {
+        if (load_inode(existing, &node) < 0 || node.type != type) return -1;
+        return existing;
+    }
+
+    uint32_t ino = alloc_inode(type);
+    if (ino == 0) return -1;
+    generation++;
+
+    if (dir_add(parent, &dir, leaf, ino, type) < 0) {
+        memset(&node, 0, sizeof(node));
+        store_inode(ino, &node);
+        sb.free_inodes++;
+        write_superblock();
+        return -1;
+    }
+    return ino;
+}
+
+// ---- Public API ----
+
+static int fs_format_locked(uint32_t total_blocks) {
+    uint8_t block[FS_BLOCK_SIZE];
+
+    mounted = 0;
+    if (total_blocks < 64) return -1;
+    index_reset();
+    generation++;
+
+    memset(&sb, 0, sizeof(sb));
+    sb.magic = FS_MAGIC;
+    sb.version = FS_VERSION;
+    sb.total_blocks = total_blocks;
+    sb.inode_count = (total_blocks / 16 + FS_INODES_PER_BLOCK - 1) / FS_INODES_PER_BLOCK * FS_INODES_PER_BLOCK;
+    sb.bitmap_start = 1;
+    sb.bitmap_blocks = (total_blocks + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK;
+    sb.inode_start = sb.bitmap_start + sb.bitmap_blocks;
+    sb.inode_blocks = sb.inode_count / FS_INODES_PER_BLOCK;
+    sb.data_start = sb.inode_start + sb.inode_blocks;
+    sb.free_blocks = total_blocks - sb.data_start;
+    sb.free_inodes = sb.inode_count - 2;  // Inode 0 is reserved, 1 is root
+
+    // Metadata blocks are permanently allocated
+    for (uint32_t b = 0; b < sb.bitmap_blocks; b++) {
+        memset(block, 0, sizeof(block));
+        for (uint32_t i = 0; i < BITS_PER_BLOCK; i++) {
+            uint32_t n = b * BITS_PER_BLOCK + i;
+            if (n < sb.data_start || n >= total_blocks) {
+                block[i / 8] |= 1 << (i % 8);
+            }
+        }
+        if (write_block(sb.bitmap_start + b, block) < 0) return -1;
+    }
+
+    for (uint32_t b = 0; b < sb.inode_blocks; b++) {
+        if (zero_block(sb.inode_start + b) < 0) return -1;
+    }
+
+    Inode root;
+    memset(&root, 0, sizeof(root));
+    root.type = FS_TYPE_DIR;
+    root.links = 1;
+    if (store_inode(FS_ROOT_INODE, &root) < 0) return -1;
+    if (write_superblock() < 0 || bcache_flush() < 0) return -1;
+
+    mounted = 1;
+    return 0;
+}
+
+void init_filesystem(void) {
+    uint32_t buffer[FS_BLOCK_SIZE / 4];
+
+    mounted = 0;
+    if (ata_init() < 0) return;
+    bcache_init();
+    index_reset();
+
+    if (read_block(0, buffer) == 0) {
+        memcpy(&sb, buffer, sizeof(sb));
+        if (sb.magic == FS_MAGIC && sb.version == FS_VERSION) {
+            mounted = 1;
+            return;
+        }
+    }
+
+    // Blank disk: format the space after the kernel area
+    uint32_t sectors = ata_sector_count();
+    if (sectors > FS_START_LBA) {
+        uint32_t blocks = sectors - FS_START_LBA;
+        if (blocks > FS_DEFAULT_BLOCKS) blocks = FS_DEFAULT_BLOCKS;
+        fs_format_locked(blocks);
+    }
+}
+
+int fs_is_mounted(void) {
+    return mounted;
+}
+
+static int fs_create_file_locked(const char* name) {
+    int ino = create_node(name, FS_TYPE_FILE);
+    bcache_flush();
+    return ino;
+}
+
+static int fs_mkdir_locked(const char* path) {
+    int ino = create_node(path, FS_TYPE_DIR);
+    bcache_flush();
+    return ino < 0 ? -1 : 0;
+}
+
+static int fs_write_file_locked(const char* name, const char* data, int size) {
+    Inode inode;
+
+    if (size < 0) return -1;
+    int ino = create_node(name, FS_TYPE_FILE);
+    int written = -1;
+    if (ino >= 0 && load_inode(ino, &inode) == 0) {
+        inode_truncate(&inode);
+        store_inode(ino, &inode);
+        written = inode_write(ino, &inode, 0, data, size);
+    }
+
+    if (bcache_flush() < 0) return -1;
+    return written;
+}
+
+static int fs_read_file_locked(const char* name, char* buffer, int max_size) {
+    Inode inode;
+
+    if (!mounted || max_size < 0) return -1;
+    uint32_t ino = lookup_path(name);
+    if (ino == 0 || load_inode(ino, &inode) < 0) return -1;
+    if (inode.type != FS_TYPE_FILE) return -1;
+
+    return inode_read(&inode, 0, buffer, max_size);
+}
+
+static int fs_delete_file_locked(const char* name) {
+    uint32_t parent;
+    char leaf[FS_NAME_MAX + 1];
+    Inode dir;
+    Inode node;
+
+    if (!mounted) return -1;
+    if (resolve_parent(name, &parent, leaf) < 0) return -1;
+    if (load_inode(parent, &dir) < 0) return -1;
+
+    uint32_t ino = dir_lookup(parent, &dir, leaf);
+    if (ino == 0 || load_inode(ino, &node) < 0) return -1;
+    if (node.type == FS_TYPE_DIR) {
+        if (!dir_is_empty(ino, &node)) return -1;
+        index_forget_dir(ino);
+    }
+
+    if (dir_remove(parent, &dir, leaf) < 0) return -1;
+    generation++;
+
+    // Handles to the file go stale; fs_size and fs_read fail on them
+    for (int h = 0; h < handle_capacity; h++) {
+        if (handles[h].inode == ino) handles[h].inode = 0;
+    }
+
+    inode_truncate(&node);
+    node.type = FS_TYPE_FREE;
+    store_inode(ino, &node);
+    sb.free_inodes++;
+    write_superblock();
+    return bcache_flush();
+}
+
+static int fs_list_dir_locked(const char* path, char filenames[][MAX_FILENAME], int max_files) {
+    DirEntry entries[FS_DIRENTS_PER_BLOCK];
+    Inode dir;
+    int unused = 0;
+    int count = 0;
+
+    if (!mounted) return 0;
+    uint32_t ino = lookup_path(path);
+    if (ino == 0 || load_inode(ino, &dir) < 0 || dir.type != FS_TYPE_DIR) return -1;
+
+    uint32_t blocks = (dir.size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+    for (uint32_t b = 0; b < blocks && count < max_files; b++) {
+        uint32_t disk_block = bmap(&dir, b, 0, &unused);
+        if (disk_block == 0 || read_block(disk_block, entries) < 0) continue;
+
+        for (uint32_t i = 0; i < FS_DIRENTS_PER_BLOCK && count < max_files; i++) {
+            if (entries[i].inode == 0) continue;
+
+            // Directories are listed with a trailing '/'
+            char* out = filenames[count++];
+            strlcpy(out, entries[i].name, MAX_FILENAME - 1);
+            if (entries[i].type == FS_TYPE_DIR) {
+                int len = strlen(out);
+                out[len] = '/';
+                out[len + 1] = '\0';
+            }
+        }
+    }
+    return count;
+}
+
+int fs_list_files(char filenames[][MAX_FILENAME], int max_files) {
+    return fs_list_dir("", filenames, max_files);
+}
+
+static int fs_file_exists_locked(const char* name) {
+    if (!mounted) return 0;
+    return lookup_path(name) != 0;
+}
+
+static int fs_get_file_size_locked(const char* name) {
+    Inode inode;
+
+    if (!mounted) return -1;
+    uint32_t ino = lookup_path(name);
+    if (ino == 0 || load_inode(ino, &inode) < 0) return -1;
+    return inode.size;
+}
+
+uint32_t fs_generation(void) {
+    return generation;
+}
+
+static int fs_open_locked(const char* path) {
+    if (!mounted) return -1;
+    uint32_t ino = lookup_path(path);
+    if (ino == 0) return -1;
+
+    int h = 0;
+    while (h < handle_capacity && handles[h].used) h++;
+
+    if (h == handle_capacity) {
+        int capacity = handle_capacity ? handle_capacity * 2 : 32;
+        FsHandle* table = (FsHandle*)kzalloc(capacity * sizeof(FsHandle));
+        if (table == 0) return -1;
+        for (int i = 0; i < handle_capacity; i++) {
+            table[i] = handles[i];
+        }
+        kfree(handles);
+        handles = table;
+        handle_capacity = capacity;
+    }
+
+    handles[h].used = 1;
+    handles[h].inode = ino;
+    handles[h].wrote = 0;
+    handles[h].extent = 0;
+    return h;
+}
+
+static void fs_close_locked(int handle) {
+    if (handle >= 0 && handle < handle_capacity && handles[handle].used) {
+        // An extent never committed may still be a freshly zeroed block
+        if (handles[handle].extent) bcache_unpin(handles[handle].extent, 1);
+        if (handles[handle].wrote) bcache_flush();
+        handles[handle].used = 0;
+        handles[handle].inode = 0;
+        handles[handle].extent = 0;
+    }
+}
+
+static int handle_inode(int handle, Inode* out) {
+    if (handle < 0 || handle >= handle_capacity || !handles[handle].used) return -1;
+    if (handles[handle].inode == 0) return -1;
+    return load_inode(handles[handle].inode, out);
+}
+
+static int fs_size_locked(int handle) {
+    Inode inode;
+    if (handle_inode(handle, &inode) < 0) return -1;
+    return inode.size;
+}
+
+static int fs_is_dir_locked(int handle) {
+    Inode inode;
+    if (handle_inode(handle, &inode) < 0) return 0;
+    return inode.type == FS_TYPE_DIR;
+}
+
+static int fs_read_locked(int handle, uint32_t offset, char* buffer, int len) {
+    Inode inode;
+    if (len < 0 || handle_inode(handle, &inode) < 0) return -1;
+    if (inode.type != FS_TYPE_FILE) return -1;
+    return inode_read(&inode, offset, buffer, len);
+}
+
+// Read as zeros by fs_borrow
+static uint8_t hole[FS_BLOCK_SIZE];
+
+static int fs_borrow_locked(int handle, uint32_t offset, const char** data) {
+    Inode inode;
+    int unused = 0;
+    if (handle_inode(handle, &inode) < 0) return -1;
+    if (inode.type != FS_TYPE_FILE) return -1;
+    if (offset >= inode.size) return 0;
+
+    uint32_t in_block = offset % FS_BLOCK_SIZE;
+    uint32_t len = FS_BLOCK_SIZE - in_block;
+    if (len > inode.size - offset) len = inode.size - offset;
+
+    uint32_t disk_block = bmap(&inode, offset / FS_BLOCK_SIZE, 0, &unused);
+    const uint8_t* block = disk_block ? (const uint8_t*)pin_block(disk_block, BCACHE_READ) : hole;
+    if (block == 0) return -1;
+    *data = (const char*)block + in_block;
+    return len;
+}
+
+static int fs_extent_locked(int handle, uint32_t offset, char** data) {
+    Inode inode;
+    int changed = 0;
+    if (handle_inode(handle, &inode) < 0) return -1;
+    if (inode.type != FS_TYPE_FILE) return -1;
+
+    FsHandle* h = &handles[handle];
+    if (h->extent) {
+        bcache_unpin(h->extent, 1);
+        h->extent = 0;
+    }
+
+    uint32_t index = offset / FS_BLOCK_SIZE;
+    int fresh = bmap(&inode, index, 0, &changed) == 0;
+    uint32_t disk_block = bmap(&inode, index, 1, &changed);
+    if (changed) store_inode(h->inode, &inode);
+    h->wrote = 1;
+    if (disk_block == 0) return -1;  // Disk full
+
+    // A new block has nothing worth reading, and must not show old data
+    uint8_t* block = (uint8_t*)pin_block(disk_block, fresh ? BCACHE_OVERWRITE : BCACHE_READ);
+    if (block == 0) return -1;
+    if (fresh) memset(block, 0, FS_BLOCK_SIZE);
+
+    h->extent = (char*)block + offset % FS_BLOCK_SIZE;
+    h->extent_offset = offset;
+    *data = h->extent;
+    return FS_BLOCK_SIZE - offset % FS_BLOCK_SIZE;
+}
+
+static int fs_commit_locked(int handle, uint32_t len) {
+    Inode inode;
+    if (handle < 0 || handle >= handle_capacity || handles[handle].extent == 0) return -1;
+
+    FsHandle* h = &handles[handle];
+    bcache_unpin(h->extent, 1);
+    h->extent = 0;
+
+    if (len > FS_BLOCK_SIZE - h->extent_offset % FS_BLOCK_SIZE) return -1;
+    if (handle_inode(handle, &inode) < 0) return -1;
+    if (h->extent_offset + len > inode.size) {
+        inode.size = h->extent_offset + len;
+        if (store_inode(h->inode, &inode) < 0) return -1;
+    }
+    return len;
+}
+
+// ---- Locked entry points ----
+//
+// App threads call into the file system concurrently; one mutex around
+// each public call keeps the superblock, index and sector cache consistent.
+
+int fs_format(uint32_t total_blocks) {
+    mutex_lock(&fs_mutex);
+    int result = fs_format_locked(total_blocks);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_create_file(const char* name) {
+    mutex_lock(&fs_mutex);
+    int result = fs_create_file_locked(name);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_mkdir(const char* path) {
+    mutex_lock(&fs_mutex);
+    int result = fs_mkdir_locked(path);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_write_file(const char* name, const char* data, int size) {
+    mutex_lock(&fs_mutex);
+    int result = fs_write_file_locked(name, data, size);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_read_file(const char* name, char* buffer, int max_size) {
+    mutex_lock(&fs_mutex);
+    int result = fs_read_file_locked(name, buffer, max_size);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_delete_file(const char* name) {
+    mutex_lock(&fs_mutex);
+    int result = fs_delete_file_locked(name);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_list_dir(const char* path, char filenames[][MAX_FILENAME], int max_files) {
+    mutex_lock(&fs_mutex);
+    int result = fs_list_dir_locked(path, filenames, max_files);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_file_exists(const char* name) {
+    mutex_lock(&fs_mutex);
+    int result = fs_file_exists_locked(name);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_get_file_size(const char* name) {
+    mutex_lock(&fs_mutex);
+    int result = fs_get_file_size_locked(name);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_open(const char* path) {
+    mutex_lock(&fs_mutex);
+    int result = fs_open_locked(path);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+void fs_close(int handle) {
+    mutex_lock(&fs_mutex);
+    fs_close_locked(handle);
+    mutex_unlock(&fs_mutex);
+}
+
+int fs_size(int handle) {
+    mutex_lock(&fs_mutex);
+    int result = fs_size_locked(handle);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_is_dir(int handle) {
+    mutex_lock(&fs_mutex);
+    int result = fs_is_dir_locked(handle);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+uint32_t fs_inode(int handle) {
+    mutex_lock(&fs_mutex);
+    uint32_t ino = 0;
+    if (handle >= 0 && handle < handle_capacity && handles[handle].used) {
+        ino = handles[handle].inode;
+    }
+    mutex_unlock(&fs_mutex);
+    return ino;
+}
+
+void fs_get_stats(FsStats* stats) {
+    mutex_lock(&fs_mutex);
+    stats->total_blocks = mounted ? sb.total_blocks : 0;
+    stats->free_blocks = mounted ? sb.free_blocks : 0;
+    stats->inode_count = mounted ? sb.inode_count : 0;
+    stats->free_inodes = mounted ? sb.free_inodes : 0;
+    mutex_unlock(&fs_mutex);
+}
+
+int fs_read(int handle, uint32_t offset, char* buffer, int len) {
+    mutex_lock(&fs_mutex);
+    int result = fs_read_locked(handle, offset, buffer, len);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_borrow(int handle, uint32_t offset, const char** data) {
+    mutex_lock(&fs_mutex);
+    int result = fs_borrow_locked(handle, offset, data);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+void fs_release(const char* data) {
+    mutex_lock(&fs_mutex);
+    bcache_unpin(data, 0);
+    mutex_unlock(&fs_mutex);
+}
+
+int fs_extent(int handle, uint32_t offset, char** data) {
+    mutex_lock(&fs_mutex);
+    int result = fs_extent_locked(handle, offset, data);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
+
+int fs_commit(int handle, uint32_t len) {
+    mutex_lock(&fs_mutex);
+    int result = fs_commit_locked(handle, len);
+    mutex_unlock(&fs_mutex);
+    return result;
+}
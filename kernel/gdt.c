@@ -0,0 +1,32 @@
+// gdt.c - Kernel-owned Global Descriptor Table
+// The bootloader's GDT lives inside the boot sector at 0x7C00, which the
+// kernel's .bss grows over. Every IRET reloads CS from the GDT, so once
+// interrupts are enabled the table has to live in kernel memory.
+#include "include/gdt.h"
+
+#define GDT_ENTRIES 3
+
+static gdt_entry_t gdt[GDT_ENTRIES];
+static gdt_ptr_t gdt_ptr;
+
+void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
+    gdt[num].base_low = base & 0xFFFF;
+    gdt[num].base_middle = (base >> 16) & 0xFF;
+    gdt[num].base_high = (base >> 24) & 0xFF;
+
+    gdt[num].limit_low = limit & 0xFFFF;
+    gdt[num].granularity = ((limit >> 16) & 0x0F) | (gran & 0xF0);
+    gdt[num].access = access;
+}
+
+void gdt_init(void) {
+    gdt_ptr.limit = sizeof(gdt) - 1;
+    gdt_ptr.base = (uint32_t)&gdt;
+
+    // Same flat layout as the bootloader: 0x08 = code, 0x10 = data
+    gdt_set_gate(0, 0, 0, 0, 0);
+    gdt_set_gate(1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
+    gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xCF);
+
+    gdt_flush((uint32_t)&gdt_ptr);
+}
@@ -0,0 +1,260 @@
+// heap.c - Slab allocator and kmalloc
+//
+// A slab is one page: a header followed by equal-sized object slots, with
+// the free slots chained through their first word. Slabs are found from an
+// object by rounding its address down to the page, so kfree needs no size.
+// Blocks larger than the biggest size class get their own pages, headed by
+// a Slab whose cache is 0.
+#include "include/heap.h"
+#include "include/page.h"
+#include "include/io.h"
+#include "include/string.h"
+
+#define SLAB_MAGIC 0x534C4142   // "SLAB"
+#define HEADER_SIZE ((sizeof(Slab) + 15) & ~15)
+
+struct Slab {
+    uint32_t magic;
+    KmemCache* cache;           // 0 for a large block
+    Slab* prev;
+    Slab* next;
+    void* free_list;
+    uint32_t in_use;
+    uint32_t pages;             // Large blocks only
+    uint32_t size;
+};
+
+#define KMALLOC_CLASSES 7       // 16 .. 1024 bytes
+static KmemCache kmalloc_caches[KMALLOC_CLASSES];
+static const char* kmalloc_names[KMALLOC_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024"
+};
+
+static KmemCache* caches = 0;
+static uint32_t large_allocs = 0;
+static uint32_t large_frees = 0;
+static uint32_t large_pages = 0;
+
+extern char kernel_end[];       // linker.ld
+
+static void list_remove(Slab** head, Slab* slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else *head = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->prev = slab->next = 0;
+}
+
+static void list_push(Slab** head, Slab* slab) {
+    slab->prev = 0;
+    slab->next = *head;
+    if (*head) (*head)->prev = slab;
+    *head = slab;
+}
+
+static Slab* slab_of(void* ptr) {
+    return (Slab*)((uint32_t)ptr & ~(PAGE_SIZE - 1));
+}
+
+void heap_init(const BootInfo* boot_info) {
+    page_init(boot_info, (uint32_t)kernel_end);
+
+    caches = 0;
+    for (int i = 0; i < KMALLOC_CLASSES; i++) {
+        kmem_cache_init(&kmalloc_caches[i], kmalloc_names[i], 16 << i);
+    }
+}
+
+void kmem_cache_init(KmemCache* cache, const char* name, uint32_t object_size) {
+    if (object_size < sizeof(void*)) object_size = sizeof(void*);
+    object_size = (object_size + 7) & ~7;
+
+    cache->name = name;
+    cache->object_size = object_size;
+    cache->per_slab = (PAGE_SIZE - HEADER_SIZE) / object_size;
+    cache->partial = 0;
+    cache->full = 0;
+    cache->slabs = 0;
+    cache->active = 0;
+    cache->allocs = 0;
+    cache->frees = 0;
+
+    cache->next = caches;
+    caches = cache;
+}
+
+static Slab* slab_create(KmemCache* cache) {
+    Slab* slab = (Slab*)page_alloc(1);
+    if (slab == 0) return 0;
+
+    slab->magic = SLAB_MAGIC;
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->pages = 1;
+    slab->size = cache->object_size;
+
+    // Chain the slots, first slot at the head
+    uint8_t* first = (uint8_t*)slab + HEADER_SIZE;
+    slab->free_list = 0;
+    for (uint32_t i = cache->per_slab; i-- > 0; ) {
+        void** slot = (void**)(first + i * cache->object_size);
+        *slot = slab->free_list;
+        slab->free_list = slot;
+    }
+
+    cache->slabs++;
+    list_push(&cache->partial, slab);
+    return slab;
+}
+
+static void* cache_alloc(KmemCache* cache) {
+    if (cache->per_slab == 0) return 0;     // Object larger than a page
+
+    Slab* slab = cache->partial;
+    if (slab == 0) {
+        slab = slab_create(cache);
+        if (slab == 0) return 0;
+    }
+
+    void** object = (void**)slab->free_list;
+    slab->free_list = *object;
+    slab->in_use++;
+    cache->active++;
+    cache->allocs++;
+
+    if (slab->in_use == cache->per_slab) {
+        list_remove(&cache->partial, slab);
+        list_push(&cache->full, slab);
+    }
+    return object;
+}
+
+static void cache_free(KmemCache* cache, void* object) {
+    if (object == 0) return;
+    Slab* slab = slab_of(object);
+    if (slab->magic != SLAB_MAGIC || slab->cache != cache) return;
+
+    if (slab->in_use == cache->per_slab) {
+        list_remove(&cache->full, slab);
+        list_push(&cache->partial, slab);
+    }
+
+    *(void**)object = slab->free_list;
+    slab->free_list = object;
+    slab->in_use--;
+    cache->active--;
+    cache->frees++;
+
+    // Give an empty slab back unless it is the cache's last spare
+    if (slab->in_use == 0 && (slab->next || slab->prev)) {
+        list_remove(&cache->partial, slab);
+        slab->magic = 0;
+        cache->slabs--;
+        page_free(slab, 1);
+    }
+}
+
+static void* alloc_block(uint32_t size) {
+    if (size == 0) return 0;
+
+    for (int i = 0; i < KMALLOC_CLASSES; i++) {
+        if (size <= kmalloc_caches[i].object_size) {
+            return cache_alloc(&kmalloc_caches[i]);
+        }
+    }
+
+    // Large block: whole pages with the header in front
+    uint32_t pages = (size + HEADER_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+    Slab* block = (Slab*)page_alloc(pages);
+    if (block == 0) return 0;
+
+    block->magic = SLAB_MAGIC;
+    block->cache = 0;
+    block->pages = pages;
+    block->size = size;
+    large_allocs++;
+    large_pages += pages;
+    return (uint8_t*)block + HEADER_SIZE;
+}
+
+// The allocator is shared by all threads: every entry point runs with
+// interrupts off so a preempting thread never sees a half-updated slab
+void* kmem_cache_alloc(KmemCache* cache) {
+    uint32_t flags = irq_save();
+    void* object = cache_alloc(cache);
+    irq_restore(flags);
+    return object;
+}
+
+void kmem_cache_free(KmemCache* cache, void* object) {
+    uint32_t flags = irq_save();
+    cache_free(cache, object);
+    irq_restore(flags);
+}
+
+void* kmalloc(uint32_t size) {
+    uint32_t flags = irq_save();
+    void* ptr = alloc_block(size);
+    irq_restore(flags);
+    return ptr;
+}
+
+void* kzalloc(uint32_t size) {
+    void* p = kmalloc(size);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+static void free_block(void* ptr) {
+    if (ptr == 0) return;
+    Slab* slab = slab_of(ptr);
+    if (slab->magic != SLAB_MAGIC) return;
+
+    if (slab->cache) {
+        cache_free(slab->cache, ptr);
+        return;
+    }
+
+    slab->magic = 0;
+    large_frees++;
+    large_pages -= slab->pages;
+    page_free(slab, slab->pages);
+}
+
+void kfree(void* ptr) {
+    uint32_t flags = irq_save();
+    free_block(ptr);
+    irq_restore(flags);
+}
+
+void heap_get_stats(HeapStats* stats) {
+    PageStats pages;
+    uint32_t flags = irq_save();
+    page_get_stats(&pages);
+
+    stats->allocs = large_allocs;
+    stats->frees = large_frees;
+    stats->active = large_allocs - large_frees;
+    stats->slab_pages = 0;
+    stats->large_pages = large_pages;
+    stats->bytes_in_use = large_pages * PAGE_SIZE;
+    stats->bytes_slack = 0;
+
+    for (KmemCache* c = caches; c; c = c->next) {
+        stats->allocs += c->allocs;
+        stats->frees += c->frees;
+        stats->active += c->active;
+        stats->slab_pages += c->slabs;
+        stats->bytes_in_use += c->active * c->object_size;
+        stats->bytes_slack += (c->slabs * c->per_slab - c->active) * c->object_size;
+    }
+
+    stats->total_pages = pages.total_pages;
+    stats->free_pages = pages.free_pages;
+    stats->largest_free_run = pages.largest_free_run;
+    irq_restore(flags);
+}
+
+KmemCache* heap_caches(void) {
+    return caches;
+}
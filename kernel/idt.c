@@ -0,0 +1,106 @@
+// idt.c - Interrupt Descriptor Table, exception and IRQ dispatch
+#include "include/idt.h"
+#include "include/pic.h"
+#include "include/vga.h"
+#include "include/sched.h"
+
+#define IDT_ENTRIES 256
+#define KERNEL_CODE_SEL 0x08
+#define IDT_INTERRUPT_GATE 0x8E  // Present, ring 0, 32-bit interrupt gate
+
+#define EXCEPTION_COUNT 32
+#define IRQ_COUNT 16
+
+// Entry stubs from interrupts.asm: 32 exceptions followed by 16 IRQs
+extern uint32_t isr_stub_table[EXCEPTION_COUNT + IRQ_COUNT];
+
+static idt_entry_t idt[IDT_ENTRIES];
+static idt_ptr_t idt_ptr;
+static irq_handler_t irq_handlers[IRQ_COUNT];
+
+void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags) {
+    idt[num].base_low = base & 0xFFFF;
+    idt[num].base_high = (base >> 16) & 0xFFFF;
+    idt[num].sel = sel;
+    idt[num].always0 = 0;
+    idt[num].flags = flags;
+}
+
+void idt_init(void) {
+    idt_ptr.limit = sizeof(idt) - 1;
+    idt_ptr.base = (uint32_t)&idt;
+
+    for (int i = 0; i < IDT_ENTRIES; i++) {
+        idt_set_gate(i, 0, 0, 0);
+    }
+    for (int i = 0; i < IRQ_COUNT; i++) {
+        irq_handlers[i] = 0;
+    }
+
+    pic_remap();
+
+    for (int i = 0; i < EXCEPTION_COUNT + IRQ_COUNT; i++) {
+        idt_set_gate(i, isr_stub_table[i], KERNEL_CODE_SEL, IDT_INTERRUPT_GATE);
+    }
+
+    idt_flush((uint32_t)&idt_ptr);
+}
+
+void irq_install_handler(int irq, irq_handler_t handler) {
+    if (irq < 0 || irq >= IRQ_COUNT) return;
+    irq_handlers[irq] = handler;
+    pic_unmask_irq(irq);
+}
+
+// CPU exceptions are fatal, except the FPU trap of a thread switch:
+// report on the bottom line and stop
+void isr_handler(registers_t* regs) {
+    if (regs->int_no == 7) {
+        sched_fpu_trap();
+        return;
+    }
+
+    static const char hex[] = "0123456789ABCDEF";
+    static const char msg[] = "EXCEPTION 0x";
+    uint16_t color = VGA_COLOR(15, 4) << 8;
+    volatile uint16_t* line = vga_buffer + (VGA_HEIGHT - 1) * VGA_WIDTH;
+
+    int x = 0;
+    for (int i = 0; msg[i] != '\0'; i++) {
+        line[x++] = color | msg[i];
+    }
+    line[x++] = color | hex[(regs->int_no >> 4) & 0xF];
+    line[x++] = color | hex[regs->int_no & 0xF];
+    line[x++] = color | ' ';
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        line[x++] = color | hex[(regs->eip >> shift) & 0xF];
+    }
+
+    // Page fault: also show the address (stack guard hits land here)
+    if (regs->int_no == 14) {
+        uint32_t cr2;
+        __asm__ volatile ("mov %%cr2, %0" : "=r"(cr2));
+        line[x++] = color | ' ';
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            line[x++] = color | hex[(cr2 >> shift) & 0xF];
+        }
+    }
+
+    __asm__ volatile ("cli");
+    while (1) {
+        __asm__ volatile ("hlt");
+    }
+}
+
+void irq_handler(registers_t* regs) {
+    uint8_t irq = regs->int_no - PIC_MASTER_OFFSET;
+
+    if (irq < IRQ_COUNT && irq_handlers[irq]) {
+        irq_handlers[irq](regs);
+    }
+
+    pic_send_eoi(irq);
+
+    // After EOI, so the next tick can arrive while another thread runs
+    sched_irq_exit();
+}
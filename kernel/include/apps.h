@@ -3,12 +3,26 @@
 #define APPS_H
 
 #include "stdint.h"
+#include "event.h"
+#include "textbuf.h"
+#include "shell.h"
 
-// App types
-#define APP_CALCULATOR 1
-#define APP_NOTEPAD 2
-#define APP_TERMINAL 3
-#define APP_FILEMANAGER 4
+// What the desktop needs to run an app: its app thread passes every event
+// to on_event (which returns 1 when the window should be drawn again),
+// calls render with wm_lock held and destroy when the window closes
+typedef struct {
+    const char* name;
+    int (*on_event)(void* app, const Event* event);
+    void (*render)(void* app);
+    void (*destroy)(void* app);
+} AppOps;
+
+// A running app: its state and the window it draws into
+typedef struct {
+    const AppOps* ops;
+    void* data;
+    int window_id;
+} AppInstance;
 
 // Calculator state
 typedef struct {
@@ -21,13 +35,24 @@ typedef struct {
     int new_number;
 } Calculator;
 
+// Text area of a Notepad window: NOTEPAD_ROWS rows below the header
+#define NOTEPAD_ROWS 9
+#define NOTEPAD_FIRST_ROW 3
+#define NOTEPAD_ALL_LINES 0xFFFFFFFF
+
 // Notepad state
 typedef struct {
     int window_id;
-    char lines[20][60];
-    int line_count;
-    int current_line;
-    int cursor_pos;
+    TextBuffer text;
+    uint32_t cursor;            // Offset in text
+    uint32_t goal_column;       // Column kept while moving up and down
+    uint32_t top_line;          // First line shown
+    uint32_t left_column;       // First column shown
+    uint32_t dirty_from;        // Lines [dirty_from, dirty_to) changed
+    uint32_t dirty_to;          // since the last render
+    uint32_t shown_top;         // top_line and left_column as rendered
+    uint32_t shown_left;
+    int shown;                  // 0 until the window holds a full render
     char filename[32];
     int has_filename;
     int save_mode;  // 0=edit, 1=save dialog
@@ -35,13 +60,42 @@ typedef struct {
     int save_cursor;
 } Notepad;
 
-// Terminal state
+// Output area of a Terminal window: TERMINAL_ROWS lines of scrollback
+// below the header, followed by the input line
+#define TERMINAL_ROWS 12
+#define TERMINAL_FIRST_ROW 3
+#define TERMINAL_COLUMNS 60
+
+// Lines of output kept per terminal, a power of two; override with
+// -DTERMINAL_SCROLLBACK=n to tune
+#ifndef TERMINAL_SCROLLBACK
+#define TERMINAL_SCROLLBACK 2048
+#endif
+#if TERMINAL_SCROLLBACK < 2 || (TERMINAL_SCROLLBACK & (TERMINAL_SCROLLBACK - 1)) != 0
+#error "TERMINAL_SCROLLBACK must be a power of two"
+#endif
+
+// Terminal state. Output lines are numbered from boot; line n is kept in
+// lines[n & (TERMINAL_SCROLLBACK - 1)] until TERMINAL_SCROLLBACK newer
+// lines replace it.
 typedef struct {
     int window_id;
-    char lines[18][60];
-    int line_count;
+    char (*lines)[TERMINAL_COLUMNS];
+    uint32_t first_line;        // Oldest line kept
+    uint32_t next_line;         // Number of the next line printed
+    uint32_t scroll;            // Lines the view is scrolled back
+    uint32_t column;            // Characters written to line next_line
+    ShellOutput out;            // Command output into the scrollback
     char input[60];
     int input_len;
+    int search_mode;            // Ctrl+F incremental search
+    char search[32];
+    int search_len;
+    int match_found;
+    uint32_t match_line;
+    uint32_t shown_start;       // Lines [shown_start, shown_end) as rendered
+    uint32_t shown_end;
+    int shown;                  // 0 until the window holds a full render
 } Terminal;
 
 // File Manager state
@@ -50,24 +104,20 @@ typedef struct {
     int selected_file;
     int file_count;
     char filenames[20][32];
+    int handles[20];            // fs_open handle per listed file
+    uint32_t generation;        // fs_generation() when listed
 } FileManager;
 
-// App manager
-void init_apps(void);
-int launch_calculator(void);
-int launch_notepad(void);
-int launch_terminal(void);
-int launch_filemanager(void);
+// App manager. The menu launches apps by index, 0..APP_LAUNCHERS-1, in
+// menu order; each launch allocates a new instance with its window.
+// Returns -1 if either could not be created.
+#define APP_LAUNCHERS 4
 
-// Instance getters
-Calculator* get_calculator_instance(void);
-Notepad* get_notepad_instance(void);
-Terminal* get_terminal_instance(void);
-FileManager* get_filemanager_instance(void);
+void init_apps(void);
+int app_launch(int index, AppInstance* out);
 
-void handle_calculator_key(Calculator* calc, uint8_t scancode);
-void handle_notepad_key(Notepad* notepad, uint8_t scancode);
-void handle_terminal_key(Terminal* term, uint8_t scancode);
-void handle_filemanager_key(FileManager* fm, uint8_t scancode);
+// Provided by the desktop (kernel.c): give a launched app its thread and
+// focus its window. Apps use it to open other apps.
+void app_register(const AppInstance* instance);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+// ata.h - ATA PIO disk driver (primary bus, master drive, LBA28)
+#ifndef ATA_H
+#define ATA_H
+
+#include "stdint.h"
+
+#define ATA_SECTOR_SIZE 512
+
+// Command counters since boot; bytes = sectors * ATA_SECTOR_SIZE
+typedef struct {
+    uint32_t read_commands;
+    uint32_t write_commands;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+} AtaStats;
+
+// Returns 0 when a drive answered IDENTIFY, -1 otherwise
+int ata_init(void);
+uint32_t ata_sector_count(void);
+uint32_t ata_multiple_count(void);     // Sectors per READ/WRITE MULTIPLE block
+void ata_get_stats(AtaStats* out);
+
+// Transfer count sectors starting at lba. Return 0 on success, -1 on error.
+int ata_read(uint32_t lba, uint32_t count, void* buffer);
+int ata_write(uint32_t lba, uint32_t count, const void* buffer);
+
+#endif
@@ -0,0 +1,48 @@
+// bcache.h - Sector cache between the file system and the disk driver
+//
+// LRU, write-back: bcache_write only marks the cached sector dirty, and
+// bcache_flush writes all dirty sectors out in LBA order, one ATA command
+// per run of consecutive sectors.
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "stdint.h"
+
+// Cache size in 512-byte sectors; override with -DBCACHE_SECTORS=n to tune
+#ifndef BCACHE_SECTORS
+#define BCACHE_SECTORS 64
+#endif
+
+#define BCACHE_READAHEAD 8      // Sectors fetched by one read miss
+#define BCACHE_BATCH 16         // Largest write issued by bcache_flush
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t disk_reads;        // ATA commands issued
+    uint32_t disk_writes;
+    uint32_t bytes_read;        // Bytes moved over the bus
+    uint32_t bytes_written;
+    uint32_t dirty;             // Sectors waiting for bcache_flush
+} BcacheStats;
+
+void bcache_init(void);
+
+// Copy one sector out of / into the cache. Return 0 on success, -1 on error.
+int bcache_read(uint32_t lba, void* buffer);
+int bcache_write(uint32_t lba, const void* buffer);
+
+// Zero-copy access to the cached sector itself, which stays in the cache
+// until bcache_unpin (any pointer into the sector will do). Unpin with
+// dirty set after changing it. BCACHE_OVERWRITE skips reading a sector
+// the caller is about to replace whole. Returns 0 on error, including
+// when every slot is pinned.
+#define BCACHE_READ 0
+#define BCACHE_OVERWRITE 1
+void* bcache_pin(uint32_t lba, int mode);
+void bcache_unpin(const void* data, int dirty);
+
+int bcache_flush(void);
+void bcache_get_stats(BcacheStats* out);
+
+#endif
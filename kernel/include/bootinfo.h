@@ -0,0 +1,58 @@
+// bootinfo.h - Data the bootloader leaves in low memory for the kernel
+#ifndef BOOTINFO_H
+#define BOOTINFO_H
+
+#include "stdint.h"
+
+// Must match BOOT_INFO in boot/bootloader.asm
+#define BOOT_INFO_ADDR 0x0500
+
+#define E820_MAX 32         // Must match E820_MAX in the bootloader
+#define E820_USABLE 1       // Free RAM; other types are reserved
+
+// One BIOS int 15h/E820h memory map entry
+typedef struct {
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi;          // ACPI 3.0 extended attributes, bit 0 = valid
+} __attribute__((packed)) E820Entry;
+
+typedef struct {
+    uint32_t font8x8;       // Linear address of the VGA BIOS 8x8 font (VIN_FB builds)
+    uint32_t e820_count;    // 0 if the BIOS has no E820 support
+    E820Entry e820[E820_MAX];
+    uint64_t tsc_boot;      // TSC when the boot sector started
+    uint64_t tsc_loaded;    // TSC once the kernel image was loaded and verified
+    uint32_t kernel_size;   // Bytes of kernel image loaded
+    uint32_t flags;         // BOOT_*
+    uint32_t fb_addr;       // Linear framebuffer set up by a Multiboot loader, 0 = none
+    uint32_t fb_pitch;      // Bytes per scan line
+    uint32_t fb_width;
+    uint32_t fb_height;
+    uint32_t fb_bpp;
+} __attribute__((packed)) BootInfo;
+
+#define BOOT_MULTIBOOT 1    // Started by a Multiboot loader, not the boot sector
+
+// Disk sector 1, in front of the kernel image (sector 2 onwards). Written
+// by tools/mkkernel.c, read by the bootloader.
+#define KERNEL_MAGIC 0x4B4E4956     // "VINK"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t load_address;  // Where the image is copied and entered
+    uint32_t sectors;       // Image length, padded to whole sectors
+    uint32_t checksum;      // Sum of all 32-bit words of the padded image
+    uint32_t size;          // Image length in bytes
+} __attribute__((packed)) KernelHeader;
+
+// Passed through an empty asm so GCC does not treat the low fixed address
+// as a near-null pointer and warn about every access
+static inline volatile BootInfo* get_boot_info(void) {
+    volatile BootInfo* info;
+    __asm__ ("" : "=r"(info) : "0"(BOOT_INFO_ADDR));
+    return info;
+}
+
+#endif
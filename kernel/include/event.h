@@ -0,0 +1,68 @@
+// event.h - Typed input and window events, lock-free event queues
+//
+// Interrupt handlers post key and timer events to the system input
+// queue, which the desktop drains. The desktop routes them to the apps,
+// each of which has its own queue (see sched.h).
+#ifndef EVENT_H
+#define EVENT_H
+
+#include "stdint.h"
+
+#define EVENT_KEY_DOWN  1           // key = scancode, modifiers
+#define EVENT_KEY_UP    2
+#define EVENT_TIMER     3           // data = seconds since boot
+#define EVENT_FOCUS     4           // data = 1 gained, 0 lost
+#define EVENT_RESIZE    5           // data = width | height << 16
+#define EVENT_REDRAW    6           // Render the window again
+#define EVENT_QUIT      7
+
+#define MOD_SHIFT 0x01
+#define MOD_CTRL  0x02
+#define MOD_ALT   0x04
+#define MOD_CAPS  0x08              // Lock states
+#define MOD_NUM   0x10
+
+typedef struct {
+    uint8_t type;
+    uint8_t modifiers;              // MOD_* held when the event happened
+    uint16_t key;
+    uint32_t data;
+} Event;
+
+// System input queue size; a power of two, like every queue's
+#ifndef INPUT_QUEUE_SIZE
+#define INPUT_QUEUE_SIZE 256
+#endif
+
+// Single-producer / single-consumer ring over caller-provided slots.
+// Each side only writes its own index, so push and pop need no lock,
+// even when one side is an IRQ. The power-of-two size lets the
+// free-running indices wrap cleanly.
+typedef struct {
+    Event* slots;
+    uint32_t mask;                  // Size - 1
+    volatile uint32_t head;         // Written by the producer
+    volatile uint32_t tail;         // Written by the consumer
+    uint32_t dropped;               // Pushes refused on a full queue
+} EventQueue;
+
+void event_queue_init(EventQueue* queue, Event* slots, uint32_t size);
+// Returns -1 when the queue is full
+int event_queue_push(EventQueue* queue, const Event* event);
+// Returns 0 when the queue is empty
+int event_queue_pop(EventQueue* queue, Event* event);
+
+static inline int event_queue_empty(const EventQueue* queue) {
+    return queue->head == queue->tail;
+}
+
+// System input queue. Posting is for IRQ handlers only: they do not
+// nest, so together they are its single producer. Posting also wakes
+// wait_for_event.
+void event_init(void);
+int event_post(uint8_t type, uint8_t modifiers, uint16_t key, uint32_t data);
+int event_poll(Event* event);
+// Events lost to a full input queue since boot
+uint32_t event_dropped(void);
+
+#endif
@@ -10,6 +10,10 @@
 #define FB_BYTES_PER_PIXEL 1
 #define FB_SIZE (FB_WIDTH * FB_HEIGHT * FB_BYTES_PER_PIXEL)
 
+// Szöveges rács a framebufferen: 4x8 pixeles cellák (80x25)
+#define FB_TEXT_COLS 80
+#define FB_TEXT_ROWS 25
+
 // Színek (8-bit palletta indexek)
 #define COLOR_BLACK 0
 #define COLOR_BLUE 1
@@ -55,4 +59,19 @@ void fb_draw_char(char c, int x, int y, uint8_t fg_color, uint8_t bg_color);
 // Szöveg kiírása
 void fb_write_string(const char* str, int x, int y, uint8_t fg_color, uint8_t bg_color);
 
+// Egy VGA szöveges cella (karakter + attribútum) rajzolása a rácsba
+void fb_draw_text_cell(int col, int row, uint16_t entry);
+
+// Hátsó puffer megváltozott sorainak kimásolása a képernyőre
+void fb_present();
+
+// Teljesítménymérés eredménye (képkocka / másodperc)
+typedef struct {
+    uint32_t clear_fps;     // Teljes képernyő törlés + megjelenítés
+    uint32_t text_fps;      // 80x25 cella kirajzolás + megjelenítés
+} FbBenchResult;
+
+// Mérés futtatása (a képernyő tartalmát felülírja)
+void fb_benchmark(FbBenchResult* result);
+
 #endif // FB_H
\ No newline at end of file
@@ -1,32 +1,128 @@
-// filesystem.h - Simple in-memory file system
+// filesystem.h - VinFS, a small hierarchical on-disk file system
+//
+// Names passed to the fs_* functions are paths: "notes.txt" or
+// "docs/todo.txt" ('/'-separated, relative to the root directory).
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
 #include "stdint.h"
 
-#define MAX_FILES 20
-#define MAX_FILENAME 32
-#define MAX_FILE_SIZE 2048
+#define MAX_FILES 20            // Entries returned by one fs_list_files call
+#define MAX_FILENAME 32         // Listed names, including the terminator
+#define MAX_FILE_SIZE 2048      // Largest file the apps load at once
 
+// Disk layout: the file system starts 1 MiB into the boot disk, after the
+// boot sector and kernel. tools/mkfs.c builds it into os.bin.
+#define FS_START_LBA 2048
+#define FS_BLOCK_SIZE 512
+
+#define FS_MAGIC 0x53464E56     // "VNFS"
+#define FS_VERSION 1
+#define FS_ROOT_INODE 1         // Inode 0 is never used
+#define FS_DIRECT_BLOCKS 10
+#define FS_PTRS_PER_BLOCK (FS_BLOCK_SIZE / 4)
+#define FS_NAME_MAX 58
+#define FS_DEFAULT_BLOCKS 8192  // 4 MiB, used when formatting a blank disk
+
+// In-memory name index (see filesystem.c)
+#define FS_INDEX_BUCKETS 1024
+#define FS_INDEX_DIRS 32        // Directories indexed at once
+
+#define FS_TYPE_FREE 0
+#define FS_TYPE_FILE 1
+#define FS_TYPE_DIR 2
+
+// Block 0
 typedef struct {
-    char name[MAX_FILENAME];
-    char data[MAX_FILE_SIZE];
-    int size;
-    int used;
-} File;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_blocks;
+    uint32_t inode_count;
+    uint32_t bitmap_start;      // Block bitmap, 1 bit per block
+    uint32_t bitmap_blocks;
+    uint32_t inode_start;       // Inode table
+    uint32_t inode_blocks;
+    uint32_t data_start;
+    uint32_t free_blocks;
+    uint32_t free_inodes;
+} Superblock;
 
+// 64 bytes, 8 per block. Block pointers of 0 mean "not allocated".
 typedef struct {
-    File files[MAX_FILES];
-    int file_count;
-} FileSystem;
+    uint16_t type;
+    uint16_t links;
+    uint32_t size;
+    uint32_t direct[FS_DIRECT_BLOCKS];
+    uint32_t indirect;          // Block of FS_PTRS_PER_BLOCK pointers
+    uint32_t double_indirect;   // Block of pointers to indirect blocks
+    uint32_t reserved[2];
+} Inode;
+
+// 64 bytes, 8 per block. inode == 0 marks a free slot.
+typedef struct {
+    uint32_t inode;
+    uint8_t type;               // Copy of the inode type, saves a lookup
+    char name[FS_NAME_MAX + 1];
+} __attribute__((packed)) DirEntry;
+
+#define FS_INODES_PER_BLOCK (FS_BLOCK_SIZE / sizeof(Inode))
+#define FS_DIRENTS_PER_BLOCK (FS_BLOCK_SIZE / sizeof(DirEntry))
 
 void init_filesystem(void);
+int fs_format(uint32_t total_blocks);
 int fs_create_file(const char* name);
 int fs_write_file(const char* name, const char* data, int size);
 int fs_read_file(const char* name, char* buffer, int max_size);
 int fs_delete_file(const char* name);
 int fs_list_files(char filenames[][MAX_FILENAME], int max_files);
+// Names in a directory (subdirectories end in '/'); -1 if path is missing
+// or not a directory, 0 with no file system mounted
+int fs_list_dir(const char* path, char filenames[][MAX_FILENAME], int max_files);
+int fs_mkdir(const char* path);
 int fs_file_exists(const char* name);
 int fs_get_file_size(const char* name);
+int fs_is_mounted(void);
+
+// Handles: resolve a path once, then query it by index. A handle to a
+// file that gets deleted stays open but fs_size/fs_read fail on it.
+int fs_open(const char* path);          // Handle >= 0, or -1
+void fs_close(int handle);
+int fs_size(int handle);
+int fs_is_dir(int handle);
+// Inode number behind a handle, 0 if it is not open. Different paths to
+// the same file ("a", "/a", "dir//a") give the same number.
+uint32_t fs_inode(int handle);
+int fs_read(int handle, uint32_t offset, char* buffer, int len);
+
+// Zero-copy I/O on a handle: file bytes are used in place in the sector
+// cache. An extent runs to the end of the block holding offset (or the end
+// of the file), so large files take a loop. Each open extent pins a cache
+// sector, so release or commit it before asking for many more.
+//
+// fs_borrow returns the number of bytes readable at *data, 0 at the end of
+// the file, or -1; they stay valid until fs_release(*data).
+int fs_borrow(int handle, uint32_t offset, const char** data);
+void fs_release(const char* data);
+
+// fs_extent allocates the block holding offset and returns how many bytes
+// can be written at *data, or -1. fs_commit records the first len of them
+// as written, growing the file to match. One extent per handle is open at
+// a time; the blocks reach the disk when the handle is closed.
+int fs_extent(int handle, uint32_t offset, char** data);
+int fs_commit(int handle, uint32_t len);
+
+// Changes whenever a name is created or removed, so listings can be
+// refreshed only when needed
+uint32_t fs_generation(void);
+
+// Space and inodes, all 0 when no file system is mounted
+typedef struct {
+    uint32_t total_blocks;
+    uint32_t free_blocks;
+    uint32_t inode_count;
+    uint32_t free_inodes;
+} FsStats;
+
+void fs_get_stats(FsStats* stats);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,57 @@
+// heap.h - Kernel heap: slab caches and kmalloc
+//
+// Fixed-size objects (windows, app state, file system index entries) come
+// from their own slab cache. kmalloc serves everything else from
+// power-of-two size classes, and sizes above the largest class take whole
+// pages. Memory is only taken from the page allocator when it is needed,
+// and empty slabs go back to it.
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "stdint.h"
+#include "bootinfo.h"
+
+typedef struct Slab Slab;
+
+// Statically allocated by its user, set up with kmem_cache_init
+typedef struct KmemCache {
+    const char* name;
+    uint32_t object_size;       // Rounded up to 8 bytes
+    uint32_t per_slab;          // Objects in one page
+    Slab* partial;              // Slabs with at least one free object
+    Slab* full;
+    uint32_t slabs;
+    uint32_t active;            // Objects handed out
+    uint32_t allocs;
+    uint32_t frees;
+    struct KmemCache* next;     // All caches, for statistics
+} KmemCache;
+
+typedef struct {
+    uint32_t allocs;            // Successful allocations since boot
+    uint32_t frees;
+    uint32_t active;            // Allocations not yet freed
+    uint32_t slab_pages;        // Pages holding slabs
+    uint32_t large_pages;       // Pages holding kmalloc blocks above the classes
+    uint32_t bytes_in_use;      // Object and block bytes handed out
+    uint32_t bytes_slack;       // Unused object slots in slab pages
+    uint32_t total_pages;       // Page allocator state
+    uint32_t free_pages;
+    uint32_t largest_free_run;
+} HeapStats;
+
+// Takes memory from the BIOS memory map in boot_info
+void heap_init(const BootInfo* boot_info);
+
+void kmem_cache_init(KmemCache* cache, const char* name, uint32_t object_size);
+void* kmem_cache_alloc(KmemCache* cache);
+void kmem_cache_free(KmemCache* cache, void* object);
+
+void* kmalloc(uint32_t size);
+void* kzalloc(uint32_t size);       // kmalloc, zero-filled
+void kfree(void* ptr);
+
+void heap_get_stats(HeapStats* stats);
+KmemCache* heap_caches(void);       // First cache; follow ->next
+
+#endif
@@ -19,12 +19,26 @@ typedef struct {
     uint32_t base;
 } __attribute__((packed)) idt_ptr_t;
 
-// IDT inicializálása
+// Regiszterek állapota a megszakítás pillanatában (interrupts.asm tölti fel)
+typedef struct {
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t int_no, err_code;
+    uint32_t eip, cs, eflags;
+} __attribute__((packed)) registers_t;
+
+// IRQ kezelő függvény típusa
+typedef void (*irq_handler_t)(registers_t* regs);
+
+// IDT inicializálása (PIC átképezéssel együtt)
 void idt_init();
 
 // IDT bejegyzés beállítása
 void idt_set_gate(uint8_t num, uint32_t base, uint16_t sel, uint8_t flags);
 
+// IRQ kezelő regisztrálása (0-15), a vonalat is engedélyezi a PIC-en
+void irq_install_handler(int irq, irq_handler_t handler);
+
 // IDT betöltése (assembly függvény)
 extern void idt_flush(uint32_t idt_ptr);  // Hiányzó paraméternév hozzáadva
 
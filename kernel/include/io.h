@@ -0,0 +1,114 @@
+// io.h - Port I/O and CPU control helpers
+#ifndef IO_H
+#define IO_H
+
+#include "stdint.h"
+
+#ifdef VIN_HOST
+// Host builds (tests/host) run kernel modules as a Linux program. Port
+// I/O and CPU control are functions of the test harness there, which
+// feeds the keyboard ports from a script.
+uint8_t inb(uint16_t port);
+void outb(uint16_t port, uint8_t value);
+uint16_t inw(uint16_t port);
+void outw(uint16_t port, uint16_t value);
+void insw(uint16_t port, void* buffer, uint32_t count);
+void outsw(uint16_t port, const void* buffer, uint32_t count);
+void io_wait(void);
+void enable_interrupts(void);
+void disable_interrupts(void);
+uint32_t irq_save(void);
+void irq_restore(uint32_t flags);
+void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx);
+void wrmsr(uint32_t msr, uint64_t value);
+uint64_t rdtsc(void);
+void invlpg(uint32_t addr);
+#else
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    __asm__ volatile ("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outw(uint16_t port, uint16_t value) {
+    __asm__ volatile ("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+// Block transfers of count 16-bit words
+static inline void insw(uint16_t port, void* buffer, uint32_t count) {
+    __asm__ volatile ("rep insw"
+                      : "+D"(buffer), "+c"(count)
+                      : "d"(port)
+                      : "memory");
+}
+
+static inline void outsw(uint16_t port, const void* buffer, uint32_t count) {
+    __asm__ volatile ("rep outsw"
+                      : "+S"(buffer), "+c"(count)
+                      : "d"(port)
+                      : "memory");
+}
+
+// Short delay for slow devices (PIC, PIT) - write to an unused port
+static inline void io_wait(void) {
+    outb(0x80, 0);
+}
+
+static inline void enable_interrupts(void) {
+    __asm__ volatile ("sti");
+}
+
+static inline void disable_interrupts(void) {
+    __asm__ volatile ("cli");
+}
+
+// Disable interrupts, returning the previous EFLAGS for irq_restore
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Re-enable interrupts only if they were on at irq_save
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx,
+                         uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile ("cpuid"
+                      : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                      : "a"(leaf), "c"(0));
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr"
+                      : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint64_t rdtsc(void) {
+    uint64_t value;
+    __asm__ volatile ("rdtsc" : "=A"(value));
+    return value;
+}
+
+static inline void invlpg(uint32_t addr) {
+    __asm__ volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+#endif
+
+#endif
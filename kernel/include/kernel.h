@@ -2,7 +2,20 @@
 #ifndef KERNEL_H
 #define KERNEL_H
 
-// Kernel fő függvénye
-void kernel_main();
+#include "bootinfo.h"
+
+// Kernel fő függvénye, a bootloader adataival
+void kernel_main(BootInfo* boot_info);
+
+// Rendszerindítás időpontjai (TSC ciklusok, 0 ha ismeretlen)
+typedef struct {
+    uint64_t loader_start;      // Boot szektor indulása
+    uint64_t kernel_loaded;     // Kernel betöltve és ellenőrizve
+    uint64_t kernel_entry;      // kernel_main hívása
+    uint64_t desktop_ready;     // Első megjelenített asztal
+    uint32_t kernel_size;       // Betöltött kernel mérete bájtban
+} BootTimes;
+
+const BootTimes* get_boot_times(void);
 
 #endif // KERNEL_H
\ No newline at end of file
@@ -4,6 +4,11 @@
 
 #include "stdint.h"
 
+// Key codes are set 1 make codes. Keys sent with the 0xE0 prefix get
+// KEY_EXTENDED added, so they never collide with the keypad. The keypad
+// with Num Lock off reports the extended navigation keys instead.
+#define KEY_EXTENDED 0x100
+
 // Special key scancodes
 #define KEY_ESC     0x01
 #define KEY_BACKSPACE 0x0E
@@ -25,16 +30,52 @@
 #define KEY_F8      0x42
 #define KEY_F9      0x43
 #define KEY_F10     0x44
-#define KEY_UP      0x48
-#define KEY_DOWN    0x50
-#define KEY_LEFT    0x4B
-#define KEY_RIGHT   0x4D
-#define KEY_DELETE  0x53
+#define KEY_NUMLOCK 0x45
+#define KEY_SCROLLLOCK 0x46
+#define KEY_F11     0x57
+#define KEY_F12     0x58
+
+// Extended keys
+#define KEY_KP_ENTER (KEY_EXTENDED | 0x1C)
+#define KEY_RCTRL   (KEY_EXTENDED | 0x1D)
+#define KEY_KP_SLASH (KEY_EXTENDED | 0x35)
+#define KEY_RALT    (KEY_EXTENDED | 0x38)
+#define KEY_HOME    (KEY_EXTENDED | 0x47)
+#define KEY_UP      (KEY_EXTENDED | 0x48)
+#define KEY_PGUP    (KEY_EXTENDED | 0x49)
+#define KEY_LEFT    (KEY_EXTENDED | 0x4B)
+#define KEY_RIGHT   (KEY_EXTENDED | 0x4D)
+#define KEY_END     (KEY_EXTENDED | 0x4F)
+#define KEY_DOWN    (KEY_EXTENDED | 0x50)
+#define KEY_PGDN    (KEY_EXTENDED | 0x51)
+#define KEY_INSERT  (KEY_EXTENDED | 0x52)
+#define KEY_DELETE  (KEY_EXTENDED | 0x53)
+
+// Typematic repeat, generated from the timer while a key is held
+#ifndef KEY_REPEAT_DELAY_MS
+#define KEY_REPEAT_DELAY_MS 500
+#endif
+#ifndef KEY_REPEAT_RATE_MS
+#define KEY_REPEAT_RATE_MS 33
+#endif
 
+typedef struct {
+    uint32_t scancodes;         // Bytes read from the controller
+    uint32_t presses;
+    uint32_t repeats;
+    uint32_t dropped;           // Key events lost to a full input queue
+    uint8_t modifiers;          // MOD_* right now, lock states included
+} KeyboardStats;
+
+// Keys arrive as EVENT_KEY_DOWN / EVENT_KEY_UP on the input queue; a
+// repeated key down has the repeat count in data
 void init_keyboard(void);
 uint8_t read_scancode(void);
-char scancode_to_char(uint8_t scancode);
-int has_key_event(void);
-uint8_t get_key_event(void);
+char scancode_to_char(uint16_t key, uint8_t modifiers);
+
+// Timer IRQ: generate repeats for the held key
+void keyboard_tick(void);
+
+void keyboard_get_stats(KeyboardStats* stats);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,59 @@
+// multiboot.h - Multiboot (version 1) boot information
+//
+// Only the parts the kernel reads: memory size and map, and the
+// framebuffer the loader set up.
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include "stdint.h"
+#include "bootinfo.h"
+
+#define MULTIBOOT_INFO_MEMORY      (1 << 0)
+#define MULTIBOOT_INFO_MMAP        (1 << 6)
+#define MULTIBOOT_INFO_FRAMEBUFFER (1 << 12)
+
+#define MULTIBOOT_FRAMEBUFFER_INDEXED 0
+
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;         // KB from 0
+    uint32_t mem_upper;         // KB from 1 MB
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+    uint32_t vbe_control_info;
+    uint32_t vbe_mode_info;
+    uint16_t vbe_mode;
+    uint16_t vbe_interface_seg;
+    uint16_t vbe_interface_off;
+    uint16_t vbe_interface_len;
+    uint64_t framebuffer_addr;
+    uint32_t framebuffer_pitch;
+    uint32_t framebuffer_width;
+    uint32_t framebuffer_height;
+    uint8_t framebuffer_bpp;
+    uint8_t framebuffer_type;
+} __attribute__((packed)) MultibootInfo;
+
+// Memory map entries are E820 entries preceded by their own size
+typedef struct {
+    uint32_t size;              // Bytes after this field
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+} __attribute__((packed)) MultibootMmapEntry;
+
+// Called from entry.asm before .bss is cleared: fills the BootInfo block
+// from the loader's information and returns it
+BootInfo* multiboot_boot_info(const MultibootInfo* info);
+
+#endif
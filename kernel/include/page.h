@@ -0,0 +1,33 @@
+// page.h - Physical page frame allocator
+//
+// Built from the BIOS E820 memory map. Paging identity-maps all of RAM
+// (see paging.h), so the address of a frame is also the pointer to it.
+#ifndef PAGE_H
+#define PAGE_H
+
+#include "stdint.h"
+#include "bootinfo.h"
+
+#define PAGE_SIZE 4096
+
+// Conventional memory used without a memory map: from the end of the
+// kernel image up to here, leaving 64 KB below the stack at 0x90000
+#define PAGE_LOW_END 0x80000
+
+typedef struct {
+    uint32_t total_pages;       // Usable RAM according to the memory map
+    uint32_t free_pages;
+    uint32_t largest_free_run;  // Longest run of free pages (fragmentation)
+    uint32_t highest_address;   // End of the highest usable region
+} PageStats;
+
+// kernel_end is the first byte after the kernel image and .bss
+void page_init(const BootInfo* boot_info, uint32_t kernel_end);
+
+// count contiguous, page-aligned pages, or 0 when no run is long enough
+void* page_alloc(uint32_t count);
+void page_free(void* addr, uint32_t count);
+
+void page_get_stats(PageStats* stats);
+
+#endif
@@ -0,0 +1,40 @@
+// paging.h - 32-bit paging with an identity-mapped address space
+//
+// Virtual addresses equal physical ones, so pointers from the page
+// allocator stay valid. Paging adds per-page caching attributes (VGA
+// memory is write-combining when the CPU has PAT) and unmapped guard
+// pages around the kernel stack.
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "stdint.h"
+#include "bootinfo.h"
+
+// Kernel stack set up by the bootloader: grows down from the top, with
+// an unmapped page on either side
+#define KERNEL_STACK_TOP   0x90000
+#define KERNEL_STACK_GUARD 0x80000  // Lowest stack address is one page above
+
+// Memory types for the VGA window (0xA0000 - 0xBFFFF)
+#define VGA_CACHE_UC 0      // Uncached, every write goes to the bus
+#define VGA_CACHE_WC 1      // Write-combining (needs PAT)
+
+typedef struct {
+    uint32_t mapped_bytes;  // Identity-mapped from address 0
+    uint32_t large_pages;   // 4 MB PSE mappings
+    uint32_t small_pages;   // 4 KB mappings
+    int pse;                // CPU features in use
+    int pat;
+    int vga_cache;          // VGA_CACHE_*
+} PagingInfo;
+
+// Map all RAM known to the page allocator, and the loader's framebuffer
+// if there is one, and turn paging on
+void paging_init(const BootInfo* boot_info);
+
+// Change the VGA window's memory type; returns the type now in effect
+int paging_set_vga_cache(int type);
+
+void paging_get_info(PagingInfo* info);
+
+#endif
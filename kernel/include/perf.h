@@ -0,0 +1,43 @@
+// perf.h - Latency probes reported over the serial port ("make perf")
+//
+// In kernels built with PERF=1 (-DVIN_PERF) a probe is started by the
+// event it measures: a key press in the keyboard IRQ, an app launched
+// from the menu, a window asked to close. The first frame that changes
+// the screen afterwards ends it, and perf_frame() writes one line per
+// finished probe to COM1:
+//
+//     PERF key_to_vga_us 412
+//
+// Once the timer has run long enough to convert TSC cycles, the boot
+// times follow in the same form, then "PERF ready". tools/perf.c drives
+// the desktop from the QEMU monitor and collects the lines.
+#ifndef PERF_H
+#define PERF_H
+
+#include "stdint.h"
+
+#define PERF_KEY            0   // Key press to the next screen update
+#define PERF_WINDOW_OPEN    1   // Menu launch until the window shows
+#define PERF_WINDOW_CLOSE   2   // Close request until the window is gone
+#define PERF_PROBES         3
+
+// Boot times are reported once uptime reaches this
+#define PERF_SETTLE_MS 1000
+
+void perf_init(void);
+
+// Start probe, unless it is already waiting for a frame (safe from IRQs)
+void perf_start(int probe);
+
+// After each vga_present: end the probes if it changed the screen
+void perf_frame(void);
+
+// The desktop is about to sleep with every event polled before since
+// handled and drawn: a key probe started before then changed nothing on
+// screen (a key an app ignores, Left at the first menu entry), so drop it
+void perf_idle(uint64_t since);
+
+// "PERF <name> <value>"
+void perf_report(const char* name, uint32_t value);
+
+#endif
@@ -0,0 +1,16 @@
+// pic.h - 8259 Programmable Interrupt Controller
+#ifndef PIC_H
+#define PIC_H
+
+#include "stdint.h"
+
+// IRQ 0-15 are remapped to these vectors (0-31 belong to CPU exceptions)
+#define PIC_MASTER_OFFSET 0x20
+#define PIC_SLAVE_OFFSET  0x28
+
+void pic_remap(void);
+void pic_send_eoi(uint8_t irq);
+void pic_mask_irq(uint8_t irq);
+void pic_unmask_irq(uint8_t irq);
+
+#endif
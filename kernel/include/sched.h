@@ -0,0 +1,70 @@
+// sched.h - Kernel threads with preemptive round-robin scheduling
+//
+// Every thread has its own stack and an event queue. The timer preempts
+// a thread once it has used up its time slice; threads waiting for an
+// event are skipped until one arrives.
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "stdint.h"
+#include "event.h"
+
+#define THREAD_STACK_PAGES 4        // 16 KB per thread
+#define THREAD_EVENTS 64            // Event queue size, a power of two
+#define SCHED_SLICE_TICKS 2         // Timer ticks before preemption
+
+typedef struct Thread Thread;
+
+// Recursive lock for code that threads share. A thread that finds it
+// taken yields until the owner lets go, so it must never be held while
+// waiting for an event.
+typedef struct {
+    Thread* owner;
+    uint32_t depth;
+    uint32_t contended;         // Times a thread had to wait for it
+} Mutex;
+
+typedef struct {
+    uint32_t threads;
+    uint32_t switches;
+    uint32_t preemptions;       // Switches forced by the timer
+    uint32_t wakeups;           // Waiting threads woken by an event
+    uint32_t queue_overflows;   // Events dropped on a full queue
+    uint32_t fpu_switches;      // FPU registers handed to another thread
+    uint32_t switch_cycles;     // Moving average of one context switch (TSC)
+    uint32_t latency_cycles;    // Moving average, event arrival to running
+    uint32_t max_latency_cycles;
+} SchedStats;
+
+// Turns the running code (kernel_main) into the first thread
+void sched_init(void);
+
+// New thread running entry(arg); returning from entry ends the thread
+Thread* thread_create(const char* name, void (*entry)(void*), void* arg);
+void thread_exit(void);
+void thread_yield(void);
+
+// 1 if a thread other than the caller is ready to run
+int sched_others_runnable(void);
+
+// The queue is single-producer: only one thread at a time may send to a
+// given thread (the desktop, or whoever holds wm_lock). Returns -1, and
+// counts an overflow, when the queue is full.
+int msg_send(Thread* thread, const Event* event);
+// Waits until an event arrives
+void msg_receive(Event* event);
+
+void mutex_lock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+
+// Timer IRQ: count down the running thread's slice
+void sched_tick(void);
+// End of an IRQ, after EOI: switch threads if the slice is used up
+void sched_irq_exit(void);
+
+// Device-not-available exception (#NM): give the FPU to the running thread
+void sched_fpu_trap(void);
+
+void sched_get_stats(SchedStats* stats);
+
+#endif
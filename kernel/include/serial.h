@@ -0,0 +1,12 @@
+// serial.h - COM1 output (115200 baud, 8N1), polled
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "stdint.h"
+
+// Returns -1 if no UART answers at COM1; writes are dropped then
+int serial_init(void);
+void serial_write(const char* data, uint32_t len);
+void serial_print(const char* text);
+
+#endif
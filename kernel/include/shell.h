@@ -0,0 +1,61 @@
+// shell.h - Command line parsing and the command registry
+//
+// A command line is split into words: spaces separate them, "double" or
+// 'single' quotes keep spaces inside one word, and a backslash outside
+// single quotes takes the next character literally. The first word names
+// the command, looked up in a hash table that any module can register
+// commands into.
+//
+// Commands write their output as a byte stream through a ShellOutput, in
+// whatever chunks they have; the sink (the terminal) splits it into lines.
+#ifndef SHELL_H
+#define SHELL_H
+
+#include "stdint.h"
+
+#define SHELL_MAX_ARGS 16
+#define SHELL_BUCKETS 64            // Hash table size, a power of two
+
+typedef struct {
+    void (*write)(void* ctx, const char* data, uint32_t len);
+    void (*clear)(void* ctx);       // Drop earlier output, may be 0
+    void* ctx;
+} ShellOutput;
+
+// Returns 0 on success, -1 after printing what went wrong
+typedef int (*ShellFn)(ShellOutput* out, int argc, char** argv);
+
+// Registered commands are linked in place, so they must stay allocated
+typedef struct ShellCommand {
+    const char* name;
+    const char* help;               // One line for 'help'
+    ShellFn run;
+    struct ShellCommand* next;      // Hash chain
+    struct ShellCommand* order;     // All commands in registration order
+} ShellCommand;
+
+// Registers the built-in file commands
+void shell_init(void);
+
+// Returns -1 if the name is taken
+int shell_register(ShellCommand* command);
+const ShellCommand* shell_find(const char* name);
+const ShellCommand* shell_commands(void);
+
+// Split line in place into at most SHELL_MAX_ARGS words. Returns the
+// word count, or -1 for an unterminated quote or too many words.
+int shell_tokenize(char* line, char** argv);
+
+// Tokenize and run line (modified in place); -1 if it failed
+int shell_run(ShellOutput* out, char* line);
+
+void shell_write(ShellOutput* out, const char* data, uint32_t len);
+// Write text and a newline
+void shell_print(ShellOutput* out, const char* text);
+
+// Build output lines: append text, or value in decimal, to the string in
+// line, a buffer of max bytes that it never overflows
+void shell_append(char* line, const char* text, int max);
+void shell_append_number(char* line, uint32_t value, int max);
+
+#endif
@@ -2,6 +2,12 @@
 #ifndef STDINT_H
 #define STDINT_H
 
+#if __STDC_HOSTED__
+// Host eszközök (tools/) a rendszer típusait használják
+#include <stdint.h>
+#include <stddef.h>
+#else
+
 // Előjel nélküli típusok
 typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
@@ -20,4 +26,6 @@ typedef unsigned long uintptr_t;
 typedef unsigned long size_t;
 typedef long ssize_t;
 
+#endif
+
 #endif // STDINT_H
\ No newline at end of file
@@ -3,24 +3,39 @@
 #define STRING_H
 
 #include "stdint.h"
-#include "types.h"
 
-// Memóriaterület nullázása
+// Memóriaterület kitöltése
 void* memset(void* s, int c, size_t n);
 
-// Memóriamásolás
+// Memóriamásolás, a területek nem fedhetik egymást
 void* memcpy(void* dest, const void* src, size_t n);
 
+// Memóriamásolás egymást fedő területek között
+void* memmove(void* dest, const void* src, size_t n);
+
+// Memória összehasonlítás
+int memcmp(const void* s1, const void* s2, size_t n);
+
 // String hossza
 size_t strlen(const char* s);
 
 // String másolás
 char* strcpy(char* dest, const char* src);
 
+// Legfeljebb size-1 karakter másolása, mindig lezárja a célt.
+// A forrás hosszát adja vissza.
+size_t strlcpy(char* dest, const char* src, size_t size);
+
 // String összefűzés
 char* strcat(char* dest, const char* src);
 
 // String összehasonlítás
 int strcmp(const char* s1, const char* s2);
+int strncmp(const char* s1, const char* s2, size_t n);
+
+// Szám decimális szöveggé alakítása (legfeljebb 11 karakter + lezáró
+// nulla), a hosszt adja vissza
+int fmt_uint(char* out, uint32_t value);
+int fmt_int(char* out, int32_t value);
 
-#endif // STRING_H
\ No newline at end of file
+#endif // STRING_H
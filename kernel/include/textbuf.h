@@ -0,0 +1,58 @@
+// textbuf.h - Gap buffer text storage with a line index
+//
+// The text sits in one heap block with a gap at the last edit position,
+// so typing and deleting there cost O(1) however long the text is; only
+// moving the edit point to somewhere else copies the text in between.
+// Newline positions are kept in a second gap array, split at the same
+// point, which gives the start of any line in O(1) and the line of any
+// offset in O(log n).
+#ifndef TEXTBUF_H
+#define TEXTBUF_H
+
+#include "stdint.h"
+
+typedef struct {
+    char* text;
+    uint32_t size;              // Bytes in text, gap included
+    uint32_t gap_start;
+    uint32_t gap_end;
+
+    // Physical offsets in text of every newline, in order. Entries
+    // before line_gap_start are before the text gap, the rest after it.
+    uint32_t* newlines;
+    uint32_t newline_size;
+    uint32_t line_gap_start;
+    uint32_t line_gap_end;
+} TextBuffer;
+
+// Offsets below are logical: positions in the text without the gap.
+// Functions that allocate return -1 when the heap is out of memory,
+// leaving the text unchanged.
+int text_init(TextBuffer* tb);
+void text_free(TextBuffer* tb);
+
+// Replace the whole text; on failure the buffer is left empty
+int text_set(TextBuffer* tb, const char* data, uint32_t len);
+// Add data at the end, for loading a file a piece at a time. Reserving
+// the whole length first saves regrowing the buffer on the way.
+int text_append(TextBuffer* tb, const char* data, uint32_t len);
+int text_reserve(TextBuffer* tb, uint32_t len);
+
+int text_insert(TextBuffer* tb, uint32_t pos, char c);
+// Delete the character at pos
+void text_delete(TextBuffer* tb, uint32_t pos);
+
+uint32_t text_length(const TextBuffer* tb);
+char text_char_at(const TextBuffer* tb, uint32_t pos);
+uint32_t text_line_count(const TextBuffer* tb);
+uint32_t text_line_start(const TextBuffer* tb, uint32_t line);
+uint32_t text_line_length(const TextBuffer* tb, uint32_t line);
+uint32_t text_line_of(const TextBuffer* tb, uint32_t pos);
+
+// Copy up to len characters from pos; returns the number copied
+uint32_t text_copy(const TextBuffer* tb, uint32_t pos, char* out, uint32_t len);
+
+// The whole text in one piece, for saving. Moves the gap to the end.
+const char* text_contiguous(TextBuffer* tb);
+
+#endif
@@ -0,0 +1,32 @@
+// timer.h - PIT system tick, uptime clock and sleep/wakeup
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "stdint.h"
+
+// Tick rate; override with -DTIMER_HZ=... (valid range 19..1193182)
+#ifndef TIMER_HZ
+#define TIMER_HZ 100
+#endif
+
+void timer_init(uint32_t hz);
+uint32_t timer_frequency(void);
+uint64_t timer_ticks(void);
+uint32_t uptime_ms(void);
+
+// TSC cycles to milliseconds, at the rate measured against the PIT since
+// timer_init (0 before the first tick)
+uint32_t tsc_to_ms(uint64_t cycles);
+uint32_t tsc_to_us(uint64_t cycles);
+
+// Halt the CPU until at least ms milliseconds have passed
+void sleep_ms(uint32_t ms);
+
+// Wake anyone blocked in wait_for_event (safe from IRQ context)
+void event_signal(void);
+
+// Halt until event_signal() is called or timeout_ms elapses (0 = forever).
+// Returns 1 if woken by an event, 0 on timeout.
+int wait_for_event(uint32_t timeout_ms);
+
+#endif
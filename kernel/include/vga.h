@@ -1,4 +1,4 @@
-// vga.h - VGA buffer shared declaration
+// vga.h - VGA text output through a shadow buffer
 #ifndef VGA_H
 #define VGA_H
 
@@ -8,7 +8,27 @@
 #define VGA_HEIGHT 25
 #define VGA_COLOR(fg, bg) ((bg << 4) | fg)
 
-// Shared VGA buffer - defined in kernel.c
+// Hardware text buffer at 0xB8000 - defined in vga.c. Only the flush in
+// vga_present() and the fatal exception screen write to it directly.
 extern volatile uint16_t* vga_buffer;
 
-#endif
\ No newline at end of file
+typedef struct {
+    uint32_t presents;      // vga_present() calls that copied anything
+    uint32_t last_cells;    // Cells copied to VGA memory by the last present
+    uint32_t total_cells;   // Cells copied since boot
+    uint32_t runs;          // Contiguous copies issued since boot
+} VgaStats;
+
+// All drawing goes to the shadow buffer...
+void vga_init(uint8_t color);
+void vga_putchar(char c, uint8_t color, uint8_t x, uint8_t y);
+void vga_fill(uint8_t x, uint8_t y, uint8_t width, uint8_t height, char c, uint8_t color);
+
+// ...and reaches the screen only here, copying just the changed runs
+void vga_present(void);
+
+// Forget what the screen shows; the next present repaints everything
+void vga_invalidate(void);
+void vga_get_stats(VgaStats* stats);
+
+#endif
@@ -4,20 +4,32 @@
 
 #include "stdint.h"
 
-#define MAX_WINDOWS 10
 #define MAX_WINDOW_TEXT_LINES 20
 
 typedef struct {
     uint8_t x, y;           // Position
     uint8_t width, height;  // Dimensions
     char title[32];         // Window title
+    uint8_t title_length;   // strlen(title), kept for the compositor
     uint8_t color;          // Window color
     int active;             // Is window active
     int focused;            // Is window focused
+    // Interior rows. Row r shows text_lines[row_slot[r]], so scrolling
+    // permutes the slot map instead of copying text.
     char text_lines[MAX_WINDOW_TEXT_LINES][80];
-    int text_line_count;    // Number of text lines
+    uint8_t row_slot[MAX_WINDOW_TEXT_LINES];
+    uint8_t slot_length[MAX_WINDOW_TEXT_LINES];
+    int text_line_count;    // Rows in use
+    int shown_line_count;   // Rows that may hold text until the next frame
 } Window;
 
+// Compositor counters, updated by draw_all_windows()
+typedef struct {
+    uint32_t frames;            // Frames that had damage to repaint
+    uint32_t last_frame_cells;  // Cells drawn by the last frame
+    uint32_t total_cells;       // Cells drawn since boot
+} CompositorStats;
+
 void init_window_manager(void);
 int create_window(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const char* title, uint8_t color);
 void close_window(int window_id);
@@ -28,6 +40,29 @@ void focus_window(int window_id);
 void cycle_focus(void);
 int get_focused_window(void);
 Window* get_window(int window_id);
+void move_window(int window_id, int x, int y);
+void set_window_title(int window_id, const char* title);
+void clear_window_text(int window_id);
 void add_window_text(int window_id, const char* text);
 
-#endif
\ No newline at end of file
+// Row interface for apps that redraw incrementally: set only the rows
+// that changed, drop rows from from_row on, or shift rows [top, bottom)
+// by delta (negative scrolls the content up; vacated rows become blank).
+void window_set_row(int window_id, int row, const char* text, int len);
+void window_clear_rows(int window_id, int from_row);
+void window_scroll_rows(int window_id, int top, int bottom, int delta);
+
+// Damage tracking: mark a screen rectangle for repaint on the next frame
+void wm_damage(int x, int y, int width, int height);
+void wm_get_stats(CompositorStats* stats);
+
+// Serialises the window manager, the screen and the app states between the
+// desktop and app threads. Recursive; take it before any file system call.
+void wm_lock(void);
+void wm_unlock(void);
+
+// Desktop layer, shown wherever no window covers the screen
+void desktop_fill(uint8_t x, uint8_t y, uint8_t width, uint8_t height, char c, uint8_t color);
+void desktop_puts(const char* str, uint8_t color, uint8_t x, uint8_t y);
+
+#endif
@@ -0,0 +1,195 @@
+; interrupts.asm - Descriptor table loading and interrupt entry stubs
+[bits 32]
+
+global gdt_flush
+global idt_flush
+global isr_stub_table
+extern isr_handler
+extern irq_handler
+
+KERNEL_CODE equ 0x08
+KERNEL_DATA equ 0x10
+
+section .text
+
+; void gdt_flush(uint32_t gdt_ptr)
+gdt_flush:
+    mov eax, [esp + 4]
+    lgdt [eax]
+    mov ax, KERNEL_DATA
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    jmp KERNEL_CODE:.reload_cs
+.reload_cs:
+    ret
+
+; void idt_flush(uint32_t idt_ptr)
+idt_flush:
+    mov eax, [esp + 4]
+    lidt [eax]
+    ret
+
+; Exceptions without an error code push a dummy one so every frame
+; has the same layout (see registers_t in idt.h)
+%macro ISR_NOERR 1
+isr%1:
+    push dword 0
+    push dword %1
+    jmp isr_common
+%endmacro
+
+%macro ISR_ERR 1
+isr%1:
+    push dword %1
+    jmp isr_common
+%endmacro
+
+%macro IRQ 1
+irq%1:
+    push dword 0
+    push dword %1 + 32
+    jmp irq_common
+%endmacro
+
+ISR_NOERR 0
+ISR_NOERR 1
+ISR_NOERR 2
+ISR_NOERR 3
+ISR_NOERR 4
+ISR_NOERR 5
+ISR_NOERR 6
+ISR_NOERR 7
+ISR_ERR 8
+ISR_NOERR 9
+ISR_ERR 10
+ISR_ERR 11
+ISR_ERR 12
+ISR_ERR 13
+ISR_ERR 14
+ISR_NOERR 15
+ISR_NOERR 16
+ISR_ERR 17
+ISR_NOERR 18
+ISR_NOERR 19
+ISR_NOERR 20
+ISR_ERR 21
+ISR_NOERR 22
+ISR_NOERR 23
+ISR_NOERR 24
+ISR_NOERR 25
+ISR_NOERR 26
+ISR_NOERR 27
+ISR_NOERR 28
+ISR_ERR 29
+ISR_ERR 30
+ISR_NOERR 31
+
+IRQ 0
+IRQ 1
+IRQ 2
+IRQ 3
+IRQ 4
+IRQ 5
+IRQ 6
+IRQ 7
+IRQ 8
+IRQ 9
+IRQ 10
+IRQ 11
+IRQ 12
+IRQ 13
+IRQ 14
+IRQ 15
+
+%macro SAVE_FRAME 0
+    pusha
+    push ds
+    push es
+    push fs
+    push gs
+    mov ax, KERNEL_DATA
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+%endmacro
+
+%macro RESTORE_FRAME 0
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    popa
+    add esp, 8          ; int_no + err_code
+    iret
+%endmacro
+
+isr_common:
+    SAVE_FRAME
+    push esp            ; registers_t*
+    call isr_handler
+    add esp, 4
+    RESTORE_FRAME
+
+irq_common:
+    SAVE_FRAME
+    push esp            ; registers_t*
+    call irq_handler
+    add esp, 4
+    RESTORE_FRAME
+
+section .data
+
+; Consumed by idt_init() - exceptions 0-31, then IRQs 0-15
+isr_stub_table:
+    dd isr0
+    dd isr1
+    dd isr2
+    dd isr3
+    dd isr4
+    dd isr5
+    dd isr6
+    dd isr7
+    dd isr8
+    dd isr9
+    dd isr10
+    dd isr11
+    dd isr12
+    dd isr13
+    dd isr14
+    dd isr15
+    dd isr16
+    dd isr17
+    dd isr18
+    dd isr19
+    dd isr20
+    dd isr21
+    dd isr22
+    dd isr23
+    dd isr24
+    dd isr25
+    dd isr26
+    dd isr27
+    dd isr28
+    dd isr29
+    dd isr30
+    dd isr31
+    dd irq0
+    dd irq1
+    dd irq2
+    dd irq3
+    dd irq4
+    dd irq5
+    dd irq6
+    dd irq7
+    dd irq8
+    dd irq9
+    dd irq10
+    dd irq11
+    dd irq12
+    dd irq13
+    dd irq14
+    dd irq15
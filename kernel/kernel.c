@@ -1,118 +1,169 @@
 // kernel.c - Main kernel implementation
 #include "include/stdint.h"
+#include "include/kernel.h"
 #include "include/window.h"
 #include "include/keyboard.h"
 #include "include/menu.h"
 #include "include/apps.h"
 #include "include/filesystem.h"
+#include "include/gdt.h"
+#include "include/idt.h"
+#include "include/io.h"
+#include "include/timer.h"
+#include "include/vga.h"
+#include "include/heap.h"
+#include "include/paging.h"
+#include "include/sched.h"
+#include "include/event.h"
+#include "include/shell.h"
+#ifdef VIN_PERF
+#include "include/perf.h"
+#endif
 
-#define VGA_WIDTH 80
-#define VGA_HEIGHT 25
-#define VGA_COLOR(fg, bg) ((bg << 4) | fg)
-
-// VGA buffer - defined here, used everywhere
-volatile uint16_t* vga_buffer = (uint16_t*)0xB8000;
+#define STATUS_TEXT "F1:Menu TAB:Switch DEL:Close M:Move"
+#define MOVE_STATUS_TEXT "MOVE MODE - Arrows to move, M to exit"
 
 static int menu_active = 0;
 static int menu_selection = 0;
 static int move_mode = 0;
 
+// Every app runs in its own thread, which receives the focused window's
+// events and owns the app state. Apps are found by window id in a table
+// that doubles when it fills. Windows and the table are shared with the
+// desktop thread and only touched under wm_lock().
 typedef struct {
-    int window_id;
-    int app_type;
-    void* app_data;
+    AppInstance app;
+    Thread* thread;
+    volatile int closing;       // Quit requested, thread still running
 } AppWindow;
 
-static AppWindow app_windows[10];
-static int app_window_count = 0;
+static AppWindow** app_table = 0;   // By window id, 0 for no app
+static int app_capacity = 0;
+static int focused_app = -1;        // Window id the last focus event went to
 
-// Helper function prototypes
-static void update_calculator_display(Calculator* calc);
-static void update_notepad_display(Notepad* notepad);
-static void update_terminal_display(Terminal* term);
-static void update_filemanager_display(FileManager* fm);
-static void int_to_str(int num, char* str);
+// Set by app threads when a window changed and the desktop must repaint
+static volatile int desktop_dirty = 0;
 
-static void register_app_window(int window_id, int app_type, void* app_data) {
-    if (app_window_count < 10) {
-        app_windows[app_window_count].window_id = window_id;
-        app_windows[app_window_count].app_type = app_type;
-        app_windows[app_window_count].app_data = app_data;
-        app_window_count++;
-    }
-}
+static void app_thread(void* arg);
 
 static AppWindow* get_app_window(int window_id) {
-    for (int i = 0; i < app_window_count; i++) {
-        if (app_windows[i].window_id == window_id) {
-            return &app_windows[i];
-        }
-    }
-    return 0;
+    if (window_id < 0 || window_id >= app_capacity) return 0;
+    return app_table[window_id];
 }
 
-static void unregister_app_window(int window_id) {
-    for (int i = 0; i < app_window_count; i++) {
-        if (app_windows[i].window_id == window_id) {
-            for (int j = i; j < app_window_count - 1; j++) {
-                app_windows[j] = app_windows[j + 1];
-            }
-            app_window_count--;
-            return;
-        }
+static int grow_app_table(int window_id) {
+    int capacity = app_capacity ? app_capacity : 16;
+    while (capacity <= window_id) capacity *= 2;
+
+    AppWindow** table = (AppWindow**)kzalloc(capacity * sizeof(AppWindow*));
+    if (table == 0) return -1;
+    for (int i = 0; i < app_capacity; i++) {
+        table[i] = app_table[i];
     }
+    kfree(app_table);
+    app_table = table;
+    app_capacity = capacity;
+    return 0;
 }
 
-static uint16_t make_vga_entry(char c, uint8_t color) {
-    return (uint16_t)c | ((uint16_t)color << 8);
+static void post_event(AppWindow* app, uint8_t type, uint32_t data) {
+    Event event;
+    event.type = type;
+    event.modifiers = 0;
+    event.key = 0;
+    event.data = data;
+    msg_send(app->thread, &event);
 }
 
-static void clear_screen(void) {
-    for (int y = 1; y < VGA_HEIGHT; y++) {
-        for (int x = 0; x < VGA_WIDTH; x++) {
-            vga_buffer[y * VGA_WIDTH + x] = make_vga_entry(' ', VGA_COLOR(7, 1));
-        }
+// Start a thread for a launched app and tell it its window size; the
+// thread renders on the redraw event. Without a thread the app cannot
+// run, so it is closed again. The window may already be gone: the file
+// manager registers its Notepad only after loading the file, and until
+// then the desktop can close the window like any other.
+void app_register(const AppInstance* instance) {
+    wm_lock();
+    Window* win = get_window(instance->window_id);
+    if (win == 0 || get_app_window(instance->window_id) != 0) {
+        instance->ops->destroy(instance->data);
+        wm_unlock();
+        return;
+    }
+    
+    AppWindow* app = 0;
+    if (instance->window_id < app_capacity || grow_app_table(instance->window_id) == 0) {
+        app = (AppWindow*)kmalloc(sizeof(AppWindow));
+    }
+    if (app) {
+        app->app = *instance;
+        app->closing = 0;
+        app->thread = thread_create(instance->ops->name, app_thread, app);
     }
+    if (app == 0 || app->thread == 0) {
+        kfree(app);
+        instance->ops->destroy(instance->data);
+        close_window(instance->window_id);
+        wm_unlock();
+        return;
+    }
+    
+    app_table[instance->window_id] = app;
+    post_event(app, EVENT_RESIZE, win->width | (uint32_t)win->height << 16);
+    post_event(app, EVENT_REDRAW, 0);
+    focus_window(instance->window_id);
+    wm_unlock();
 }
 
-static void putchar_at(char c, uint8_t color, uint8_t x, uint8_t y) {
-    if (x >= VGA_WIDTH || y >= VGA_HEIGHT) return;
-    vga_buffer[y * VGA_WIDTH + x] = make_vga_entry(c, color);
+// Ask the app's thread to close its window and exit. If the queue is
+// full the closing flag still stops it after the event in hand.
+static void request_quit(AppWindow* app) {
+    if (app->closing) return;
+    app->closing = 1;
+    post_event(app, EVENT_QUIT, 0);
 }
 
-static void puts_at(const char* str, uint8_t color, uint8_t x, uint8_t y) {
-    for (uint8_t i = 0; str[i] != '\0'; i++) {
-        putchar_at(str[i], color, x + i, y);
-    }
+// Tell the apps that lost and gained focus; called with wm_lock held
+static void sync_focus(void) {
+    int focused = get_focused_window();
+    if (focused == focused_app) return;
+    
+    AppWindow* app = get_app_window(focused_app);
+    if (app && !app->closing) post_event(app, EVENT_FOCUS, 0);
+    app = get_app_window(focused);
+    if (app && !app->closing) post_event(app, EVENT_FOCUS, 1);
+    focused_app = focused;
 }
 
-static void int_to_str(int num, char* str) {
-    if (num == 0) {
-        str[0] = '0';
-        str[1] = '\0';
-        return;
-    }
+// Event handlers run without wm_lock, so a slow command (a benchmark, a
+// large file) does not hold up the desktop or the other apps
+static void app_thread(void* arg) {
+    AppWindow* app = (AppWindow*)arg;
+    const AppOps* ops = app->app.ops;
+    Event event;
     
-    int is_negative = 0;
-    if (num < 0) {
-        is_negative = 1;
-        num = -num;
-    }
-    
-    char temp[20];
-    int i = 0;
-    while (num > 0) {
-        temp[i++] = '0' + (num % 10);
-        num /= 10;
+    while (!app->closing) {
+        msg_receive(&event);
+        if (event.type == EVENT_QUIT) break;
+        if (app->closing) continue;
+        
+        int dirty = ops->on_event(app->app.data, &event);
+        if (event.type == EVENT_REDRAW) dirty = 1;
+        if (!dirty) continue;
+        
+        wm_lock();
+        ops->render(app->app.data);
+        desktop_dirty = 1;
+        wm_unlock();
+        event_signal();
     }
     
-    int j = 0;
-    if (is_negative) str[j++] = '-';
-    
-    while (i > 0) {
-        str[j++] = temp[--i];
-    }
-    str[j] = '\0';
+    wm_lock();
+    app_table[app->app.window_id] = 0;
+    close_window(app->app.window_id);
+    ops->destroy(app->app.data);
+    kfree(app);
+    desktop_dirty = 1;
+    wm_unlock();
+    event_signal();
 }
 
 static void draw_desktop_icons(void) {
@@ -121,189 +172,197 @@ static void draw_desktop_icons(void) {
     const char* icon3 = "[Term]";
     const char* icon4 = "[File]";
     
-    puts_at(icon1, VGA_COLOR(15, 1), 2, 2);
-    puts_at(icon2, VGA_COLOR(15, 1), 2, 4);
-    puts_at(icon3, VGA_COLOR(15, 1), 2, 6);
-    puts_at(icon4, VGA_COLOR(15, 1), 2, 8);
-    
-    puts_at("F1:Menu TAB:Switch DEL:Close M:Move", VGA_COLOR(14, 1), 2, VGA_HEIGHT - 1);
+    desktop_puts(icon1, VGA_COLOR(15, 1), 2, 2);
+    desktop_puts(icon2, VGA_COLOR(15, 1), 2, 4);
+    desktop_puts(icon3, VGA_COLOR(15, 1), 2, 6);
+    desktop_puts(icon4, VGA_COLOR(15, 1), 2, 8);
 }
 
-static void update_calculator_display(Calculator* calc) {
-    Window* win = get_window(calc->window_id);
-    if (win == 0) return;
-    
-    win->text_line_count = 0;
-    
-    add_window_text(calc->window_id, "VIN Calculator v1.0");
-    add_window_text(calc->window_id, "--------------------");
-    
-    char display_line[30] = "Display: ";
-    int k = 9;
-    for (int i = 0; i < calc->display_len && k < 28; i++) {
-        display_line[k++] = calc->display[i];
-    }
-    display_line[k] = '\0';
-    add_window_text(calc->window_id, display_line);
-    
-    add_window_text(calc->window_id, "");
-    add_window_text(calc->window_id, "Use keyboard:");
-    add_window_text(calc->window_id, "  0-9: Numbers");
-    add_window_text(calc->window_id, "  +,-,*,/: Operators");
-    add_window_text(calc->window_id, "  =: Calculate");
-    add_window_text(calc->window_id, "  C: Clear");
+static void draw_status_line(const char* text, uint8_t color) {
+    desktop_fill(0, VGA_HEIGHT - 1, VGA_WIDTH, 1, ' ', VGA_COLOR(7, 1));
+    desktop_puts(text, color, 2, VGA_HEIGHT - 1);
 }
 
-static void update_notepad_display(Notepad* notepad) {
-    Window* win = get_window(notepad->window_id);
-    if (win == 0) return;
-    
-    win->text_line_count = 0;
-    
-    if (notepad->save_mode) {
-        add_window_text(notepad->window_id, "Save As - Enter filename:");
-        add_window_text(notepad->window_id, "");
-        
-        char prompt[60] = "Filename: ";
-        int k = 10;
-        for (int i = 0; i < notepad->save_cursor && k < 50; i++) {
-            prompt[k++] = notepad->save_buffer[i];
+static BootTimes boot_times;
+
+const BootTimes* get_boot_times(void) {
+    return &boot_times;
+}
+
+// Desktop keys: menu, move mode, focus and closing windows. Everything
+// else goes to the focused app's thread. Runs with wm_lock held; returns
+// 1 if the screen needs a repaint.
+static int handle_desktop_key(const Event* event) {
+    uint16_t scancode = event->key;
+
+    if (scancode == KEY_F1) {
+        menu_active = !menu_active;
+        if (menu_active) {
+            menu_selection = 0;
+            draw_menu(menu_selection);
+        } else {
+            draw_menu(-1);
         }
-        prompt[k++] = '_';
-        prompt[k] = '\0';
-        add_window_text(notepad->window_id, prompt);
-        add_window_text(notepad->window_id, "");
-        add_window_text(notepad->window_id, "Press ENTER to save, ESC to cancel");
-        return;
+        return 0;
     }
     
-    if (notepad->has_filename) {
-        char title[60] = "File: ";
-        int k = 6;
-        for (int i = 0; notepad->filename[i] != '\0' && k < 50; i++) {
-            title[k++] = notepad->filename[i];
+    if (menu_active) {
+        if (scancode == KEY_LEFT && menu_selection > 0) {
+            menu_selection--;
+            draw_menu(menu_selection);
         }
-        title[k] = '\0';
-        add_window_text(notepad->window_id, title);
-    } else {
-        add_window_text(notepad->window_id, "Unsaved Document");
-    }
-    
-    add_window_text(notepad->window_id, "F2:Save  F3:Save As");
-    add_window_text(notepad->window_id, "----------------------------");
-    
-    int start_line = 0;
-    if (notepad->current_line > 8) {
-        start_line = notepad->current_line - 8;
+        else if (scancode == KEY_RIGHT && menu_selection < APP_LAUNCHERS) {
+            menu_selection++;
+            draw_menu(menu_selection);
+        }
+        else if (scancode == KEY_ENTER) {
+            menu_active = 0;
+            draw_menu(-1);
+            
+            // The last menu entry closes everything; the app threads close
+            // their windows as they exit
+            if (menu_selection < APP_LAUNCHERS) {
+#ifdef VIN_PERF
+                perf_start(PERF_WINDOW_OPEN);
+#endif
+                AppInstance instance;
+                if (app_launch(menu_selection, &instance) == 0) {
+                    app_register(&instance);
+                }
+            } else {
+                for (int id = 0; id < app_capacity; id++) {
+                    if (app_table[id]) request_quit(app_table[id]);
+                }
+            }
+            return 1;
+        }
+        else if (scancode == KEY_ESC) {
+            menu_active = 0;
+            draw_menu(-1);
+        }
+        return 0;
     }
     
-    for (int i = start_line; i < notepad->line_count && i < start_line + 9; i++) {
-        if (notepad->lines[i][0] == '\0') {
-            add_window_text(notepad->window_id, " ");
+    // M key for move mode
+    char c = scancode_to_char(scancode, event->modifiers);
+    if ((c == 'm' || c == 'M')) {
+        move_mode = !move_mode;
+        if (move_mode) {
+            draw_status_line(MOVE_STATUS_TEXT, VGA_COLOR(0, 14));
         } else {
-            add_window_text(notepad->window_id, notepad->lines[i]);
+            draw_status_line(STATUS_TEXT, VGA_COLOR(14, 1));
         }
+        return 1;
     }
     
-    if (notepad->current_line >= start_line && notepad->current_line < start_line + 9) {
-        char cursor_line[60];
-        int k = 0;
-        for (int i = 0; i < notepad->cursor_pos && i < 58; i++) {
-            cursor_line[k++] = notepad->lines[notepad->current_line][i];
-        }
-        cursor_line[k++] = '_';
-        cursor_line[k] = '\0';
-        
-        if (notepad->current_line == notepad->line_count) {
-            add_window_text(notepad->window_id, cursor_line);
+    int focused = get_focused_window();
+    
+    // Handle move mode
+    if (move_mode) {
+        Window* win = get_window(focused);
+        if (win) {
+            int x = win->x;
+            int y = win->y;
+            if (scancode == KEY_UP && win->y > 1) {
+                y--;
+            }
+            else if (scancode == KEY_DOWN && win->y + win->height < VGA_HEIGHT - 1) {
+                y++;
+            }
+            else if (scancode == KEY_LEFT && win->x > 0) {
+                x--;
+            }
+            else if (scancode == KEY_RIGHT && win->x + win->width < VGA_WIDTH) {
+                x++;
+            }
+            
+            if (x != win->x || y != win->y) {
+                move_window(focused, x, y);
+                return 1;
+            }
         }
+        return 0;
     }
-}
-
-static void update_terminal_display(Terminal* term) {
-    Window* win = get_window(term->window_id);
-    if (win == 0) return;
-    
-    win->text_line_count = 0;
     
-    add_window_text(term->window_id, "VIN Terminal v0.4");
-    add_window_text(term->window_id, "Type 'help' for commands");
-    add_window_text(term->window_id, "========================");
-    
-    int start = 0;
-    if (term->line_count > 12) {
-        start = term->line_count - 12;
+    // DELETE closes window
+    if (scancode == KEY_DELETE || scancode == KEY_F4) {
+        if (focused >= 0) {
+#ifdef VIN_PERF
+            perf_start(PERF_WINDOW_CLOSE);
+#endif
+            AppWindow* app = get_app_window(focused);
+            if (app) {
+                request_quit(app);
+            } else {
+                close_window(focused);
+            }
+        }
+        return 1;
     }
     
-    for (int i = start; i < term->line_count; i++) {
-        add_window_text(term->window_id, term->lines[i]);
+    // TAB switches windows
+    if (scancode == KEY_TAB) {
+        cycle_focus();
+        return 1;
     }
     
-    char input_line[62] = "> ";
-    int k = 2;
-    for (int i = 0; i < term->input_len && k < 60; i++) {
-        input_line[k++] = term->input[i];
+    // Send to active app; its thread repaints when done
+    AppWindow* app = get_app_window(focused);
+    if (app && !app->closing) {
+        msg_send(app->thread, event);
     }
-    input_line[k++] = '_';
-    input_line[k] = '\0';
-    add_window_text(term->window_id, input_line);
+    return 0;
 }
 
-static void update_filemanager_display(FileManager* fm) {
-    Window* win = get_window(fm->window_id);
-    if (win == 0) return;
-    
-    win->text_line_count = 0;
+// Route one event from the input queue, with wm_lock held. Returns 1 if
+// the screen needs a repaint.
+static int dispatch_event(const Event* event) {
+    if (event->type == EVENT_KEY_DOWN) {
+        return handle_desktop_key(event);
+    }
     
-    add_window_text(fm->window_id, "VIN File Manager");
-    add_window_text(fm->window_id, "--------------------------------");
-    add_window_text(fm->window_id, "UP/DOWN: Navigate  ENTER: Open");
-    add_window_text(fm->window_id, "DELETE: Remove file");
-    add_window_text(fm->window_id, "");
+    if (event->type == EVENT_KEY_UP) {
+        // Releases belong to the app that had the key press
+        AppWindow* app = get_app_window(get_focused_window());
+        if (app && !app->closing && !menu_active && !move_mode) {
+            msg_send(app->thread, event);
+        }
+        return 0;
+    }
     
-    if (fm->file_count == 0) {
-        add_window_text(fm->window_id, "No files found.");
-        add_window_text(fm->window_id, "Create files in Notepad (F2)");
-    } else {
-        for (int i = 0; i < fm->file_count && i < 12; i++) {
-            char line[60];
-            if (i == fm->selected_file) {
-                line[0] = '>';
-                line[1] = ' ';
-            } else {
-                line[0] = ' ';
-                line[1] = ' ';
-            }
-            
-            int j = 2;
-            for (int k = 0; fm->filenames[i][k] != '\0' && j < 50; k++) {
-                line[j++] = fm->filenames[i][k];
-            }
-            
-            int size = fs_get_file_size(fm->filenames[i]);
-            if (size >= 0) {
-                line[j++] = ' ';
-                line[j++] = '(';
-                char size_str[10];
-                int_to_str(size, size_str);
-                for (int k = 0; size_str[k] != '\0' && j < 55; k++) {
-                    line[j++] = size_str[k];
-                }
-                line[j++] = 'B';
-                line[j++] = ')';
-            }
-            
-            line[j] = '\0';
-            add_window_text(fm->window_id, line);
+    if (event->type == EVENT_TIMER) {
+        for (int id = 0; id < app_capacity; id++) {
+            AppWindow* app = app_table[id];
+            if (app && !app->closing) msg_send(app->thread, event);
         }
     }
+    return 0;
 }
 
-void kernel_main(void) {
+void kernel_main(BootInfo* boot_info) {
+    boot_times.kernel_entry = rdtsc();
+    boot_times.loader_start = boot_info->tsc_boot;
+    boot_times.kernel_loaded = boot_info->tsc_loaded;
+    boot_times.kernel_size = boot_info->kernel_size;
+    
     // Clear entire screen
-    for (int i = 0; i < VGA_WIDTH * VGA_HEIGHT; i++) {
-        vga_buffer[i] = make_vga_entry(' ', VGA_COLOR(7, 1));
-    }
+    vga_init(VGA_COLOR(7, 1));
+    
+    // Descriptor tables first: keyboard input is interrupt driven
+    gdt_init();
+    idt_init();
+    event_init();
+    timer_init(TIMER_HZ);
+#ifdef VIN_PERF
+    perf_init();
+#endif
+    
+    // Memory next: windows, apps and the file system allocate from the heap.
+    // Paging maps everything the page allocator found. The scheduler then
+    // makes this code the desktop thread.
+    heap_init(boot_info);
+    paging_init(boot_info);
+    sched_init();
     
     // Initialize all systems
     init_keyboard();
@@ -311,235 +370,58 @@ void kernel_main(void) {
     init_menu();
     init_apps();
     init_filesystem();
+    shell_init();
     
     // Set up desktop
-    clear_screen();
     draw_menu(-1);
     draw_desktop_icons();
+    draw_status_line(STATUS_TEXT, VGA_COLOR(14, 1));
+    
+    enable_interrupts();
     
     int redraw = 1;
-    int active_count = 0;
     
     while (1) {
-        if (redraw) {
+        wm_lock();
+        sync_focus();
+        if (redraw || desktop_dirty) {
+            desktop_dirty = 0;
             draw_all_windows();
-            draw_desktop_icons();
             redraw = 0;
         }
         
-        if (has_key_event()) {
-            uint8_t scancode = get_key_event();
-            
-            if (scancode == KEY_F1) {
-                menu_active = !menu_active;
-                if (menu_active) {
-                    menu_selection = 0;
-                    draw_menu(menu_selection);
-                } else {
-                    draw_menu(-1);
-                }
-                continue;
-            }
-            
-            if (menu_active) {
-                if (scancode == KEY_LEFT && menu_selection > 0) {
-                    menu_selection--;
-                    draw_menu(menu_selection);
-                }
-                else if (scancode == KEY_RIGHT && menu_selection < 4) {
-                    menu_selection++;
-                    draw_menu(menu_selection);
-                }
-                else if (scancode == KEY_ENTER) {
-                    menu_active = 0;
-                    draw_menu(-1);
-                    
-                    int new_win = -1;
-                    
-                    switch (menu_selection) {
-                        case 0: {
-                            Calculator* calc = get_calculator_instance();
-                            if (calc) {
-                                new_win = launch_calculator();
-                                if (new_win >= 0) {
-                                    calc->window_id = new_win;
-                                    register_app_window(new_win, APP_CALCULATOR, (void*)calc);
-                                    update_calculator_display(calc);
-                                    active_count++;
-                                    focus_window(new_win);
-                                    redraw = 1;
-                                }
-                            }
-                            break;
-                        }
-                        case 1: {
-                            Notepad* notepad = get_notepad_instance();
-                            if (notepad) {
-                                new_win = launch_notepad();
-                                if (new_win >= 0) {
-                                    notepad->window_id = new_win;
-                                    register_app_window(new_win, APP_NOTEPAD, (void*)notepad);
-                                    update_notepad_display(notepad);
-                                    active_count++;
-                                    focus_window(new_win);
-                                    redraw = 1;
-                                }
-                            }
-                            break;
-                        }
-                        case 2: {
-                            Terminal* term = get_terminal_instance();
-                            if (term) {
-                                new_win = launch_terminal();
-                                if (new_win >= 0) {
-                                    term->window_id = new_win;
-                                    register_app_window(new_win, APP_TERMINAL, (void*)term);
-                                    update_terminal_display(term);
-                                    active_count++;
-                                    focus_window(new_win);
-                                    redraw = 1;
-                                }
-                            }
-                            break;
-                        }
-                        case 3: {
-                            FileManager* fm = get_filemanager_instance();
-                            if (fm) {
-                                new_win = launch_filemanager();
-                                if (new_win >= 0) {
-                                    fm->window_id = new_win;
-                                    register_app_window(new_win, APP_FILEMANAGER, (void*)fm);
-                                    update_filemanager_display(fm);
-                                    active_count++;
-                                    focus_window(new_win);
-                                    redraw = 1;
-                                }
-                            }
-                            break;
-                        }
-                        case 4: {
-                            close_all_windows();
-                            active_count = 0;
-                            app_window_count = 0;
-                            clear_screen();
-                            draw_desktop_icons();
-                            redraw = 1;
-                            break;
-                        }
-                    }
-                }
-                else if (scancode == KEY_ESC) {
-                    menu_active = 0;
-                    draw_menu(-1);
-                }
-                continue;
-            }
-            
-            // M key for move mode
-            char c = scancode_to_char(scancode);
-            if ((c == 'm' || c == 'M')) {
-                move_mode = !move_mode;
-                clear_screen();
-                if (move_mode) {
-                    puts_at("MOVE MODE - Arrows to move, M to exit", VGA_COLOR(0, 14), 2, VGA_HEIGHT - 1);
-                } else {
-                    draw_desktop_icons();
-                }
-                redraw = 1;
-                continue;
-            }
-            
-            // Handle move mode
-            if (move_mode) {
-                int focused = get_focused_window();
-                if (focused >= 0) {
-                    Window* win = get_window(focused);
-                    if (win) {
-                        int moved = 0;
-                        if (scancode == KEY_UP && win->y > 1) {
-                            win->y--;
-                            moved = 1;
-                        }
-                        else if (scancode == KEY_DOWN && win->y + win->height < VGA_HEIGHT - 1) {
-                            win->y++;
-                            moved = 1;
-                        }
-                        else if (scancode == KEY_LEFT && win->x > 0) {
-                            win->x--;
-                            moved = 1;
-                        }
-                        else if (scancode == KEY_RIGHT && win->x + win->width < VGA_WIDTH) {
-                            win->x++;
-                            moved = 1;
-                        }
-                        
-                        if (moved) {
-                            clear_screen();
-                            puts_at("MOVE MODE - Arrows to move, M to exit", VGA_COLOR(0, 14), 2, VGA_HEIGHT - 1);
-                            redraw = 1;
-                        }
-                    }
-                }
-                continue;
-            }
-            
-            // DELETE closes window
-            if (scancode == KEY_DELETE || scancode == KEY_F4) {
-                int focused = get_focused_window();
-                if (focused >= 0) {
-                    unregister_app_window(focused);
-                    close_window(focused);
-                    active_count--;
-                    if (active_count == 0) {
-                        clear_screen();
-                        draw_desktop_icons();
-                    }
-                    redraw = 1;
-                }
-                continue;
-            }
-            
-            // TAB switches windows
-            if (scancode == KEY_TAB) {
-                cycle_focus();
-                redraw = 1;
-                continue;
-            }
-            
-            // Send to active app
-            int focused = get_focused_window();
-            if (focused >= 0) {
-                AppWindow* app_win = get_app_window(focused);
-                if (app_win) {
-                    if (app_win->app_type == APP_CALCULATOR) {
-                        Calculator* calc = (Calculator*)app_win->app_data;
-                        handle_calculator_key(calc, scancode);
-                        update_calculator_display(calc);
-                        redraw = 1;
-                    }
-                    else if (app_win->app_type == APP_NOTEPAD) {
-                        Notepad* notepad = (Notepad*)app_win->app_data;
-                        handle_notepad_key(notepad, scancode);
-                        update_notepad_display(notepad);
-                        redraw = 1;
-                    }
-                    else if (app_win->app_type == APP_TERMINAL) {
-                        Terminal* term = (Terminal*)app_win->app_data;
-                        handle_terminal_key(term, scancode);
-                        update_terminal_display(term);
-                        redraw = 1;
-                    }
-                    else if (app_win->app_type == APP_FILEMANAGER) {
-                        FileManager* fm = (FileManager*)app_win->app_data;
-                        handle_filemanager_key(fm, scancode);
-                        fm->file_count = fs_list_files(fm->filenames, 20);
-                        update_filemanager_display(fm);
-                        redraw = 1;
-                    }
-                }
+        // Single presentation point for menu, windows and desktop
+        vga_present();
+        wm_unlock();
+        if (boot_times.desktop_ready == 0) {
+            boot_times.desktop_ready = rdtsc();
+        }
+#ifdef VIN_PERF
+        perf_frame();
+#endif
+        
+        // No input: let busy app threads run, otherwise sleep until an
+        // interrupt delivers input or an app finishes a repaint
+#ifdef VIN_PERF
+        uint64_t poll_tsc = rdtsc();
+#endif
+        Event event;
+        if (!event_poll(&event)) {
+            if (sched_others_runnable()) {
+                thread_yield();
+            } else if (!desktop_dirty) {
+#ifdef VIN_PERF
+                perf_idle(poll_tsc);
+#endif
+                wait_for_event(0);
             }
+            continue;
         }
         
-        for (volatile int i = 0; i < 100000; i++);
+        wm_lock();
+        if (dispatch_event(&event)) {
+            redraw = 1;
+        }
+        wm_unlock();
     }
-}
\ No newline at end of file
+}
@@ -1,89 +1,302 @@
 // keyboard.c - Keyboard input implementation
+//
+// Scan code set 1 is decoded by a small state machine in the IRQ: 0xE0
+// marks the next byte as an extended key, 0xE1 starts the Pause sequence
+// (skipped), and a set top bit means the key was released. Modifier and
+// lock keys update a MOD_* mask that goes out with every event; the lock
+// keys also switch the keyboard LEDs. Hardware typematic makes are
+// dropped, and repeats come from the timer instead, at a rate that is the
+// same on every keyboard.
 #include "include/keyboard.h"
+#include "include/idt.h"
+#include "include/io.h"
+#include "include/event.h"
+#include "include/timer.h"
+#ifdef VIN_PERF
+#include "include/perf.h"
+#endif
 
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_STATUS_PORT 0x64
+#define KEYBOARD_IRQ 1
 
-#define KEY_BUFFER_SIZE 16
+#define STATUS_OUTPUT_FULL 0x01
+#define STATUS_INPUT_FULL  0x02
 
-static uint8_t key_buffer[KEY_BUFFER_SIZE];
-static int key_buffer_start = 0;
-static int key_buffer_end = 0;
-static int key_buffer_count = 0;
+#define KBD_CMD_SET_LEDS 0xED
+#define KBD_ACK          0xFA
+#define KBD_RESEND       0xFE
 
-static uint8_t inb(uint16_t port) {
-    uint8_t ret;
-    __asm__ volatile ("inb %1, %0" : "=a"(ret) : "Nd"(port));
-    return ret;
-}
+#define LED_SCROLL 0x01
+#define LED_NUM    0x02
+#define LED_CAPS   0x04
 
-static int is_shift_pressed = 0;
+// BIOS data area keyboard flags: lock states at boot
+#define BDA_KEYBOARD_FLAGS 0x417
+#define BDA_SCROLL 0x10
+#define BDA_NUM    0x20
+#define BDA_CAPS   0x40
 
-void init_keyboard(void) {
-    key_buffer_start = 0;
-    key_buffer_end = 0;
-    key_buffer_count = 0;
-    is_shift_pressed = 0;
+// Decoder state between IRQs. Only IRQ handlers touch it (keyboard and
+// timer), and those do not nest.
+static int extended = 0;            // Got 0xE0
+static int pause_bytes = 0;         // Left to skip of the 0xE1 sequence
+static volatile uint8_t held_modifiers = 0;
+static uint8_t leds = 0;
+static int led_state = 0;           // 0 idle, 1 command sent, 2 value sent
+static int led_dirty = 0;           // Lock changed while an update was out
+
+// One bit per key code, extended keys included
+static uint32_t key_down[(KEY_EXTENDED * 2) / 32];
+
+static uint16_t repeat_key = 0;     // 0 for none
+static uint32_t repeat_countdown = 0;
+static uint32_t repeat_count = 0;
+static uint32_t delay_ticks = 1;
+static uint32_t rate_ticks = 1;
+
+static KeyboardStats stats;
+
+#ifdef VIN_HOST
+// Host builds: the test harness plays the BIOS
+extern volatile uint8_t host_bda_keyboard_flags;
+
+static inline const volatile uint8_t* bios_data_area(void) {
+    return &host_bda_keyboard_flags;
+}
+#else
+static inline const volatile uint8_t* bios_data_area(void) {
+    const volatile uint8_t* bda;
+    __asm__ ("" : "=r"(bda) : "0"(BDA_KEYBOARD_FLAGS));
+    return bda;
 }
+#endif
 
-static void add_key_to_buffer(uint8_t scancode) {
-    if (key_buffer_count < KEY_BUFFER_SIZE) {
-        key_buffer[key_buffer_end] = scancode;
-        key_buffer_end = (key_buffer_end + 1) % KEY_BUFFER_SIZE;
-        key_buffer_count++;
+static void keyboard_write(uint8_t value) {
+    for (int i = 0; i < 100000 && (inb(KEYBOARD_STATUS_PORT) & STATUS_INPUT_FULL); i++) {
     }
+    outb(KEYBOARD_DATA_PORT, value);
 }
 
-uint8_t read_scancode(void) {
-    uint8_t status = inb(KEYBOARD_STATUS_PORT);
-    
-    if (status & 0x01) {
-        uint8_t scancode = inb(KEYBOARD_DATA_PORT);
-        
-        // Track shift state
-        if (scancode == KEY_LSHIFT || scancode == KEY_RSHIFT) {
-            is_shift_pressed = 1;
-        }
-        else if (scancode == (KEY_LSHIFT | 0x80) || scancode == (KEY_RSHIFT | 0x80)) {
-            is_shift_pressed = 0;
-        }
-        
-        // Only process key press (not release)
-        if (!(scancode & 0x80)) {
-            add_key_to_buffer(scancode);
+// Start an LED update; the ACKs arrive as IRQ bytes and drive the rest
+static void update_leds(void) {
+    if (led_state != 0) {
+        led_dirty = 1;
+        return;
+    }
+    led_state = 1;
+    keyboard_write(KBD_CMD_SET_LEDS);
+}
+
+static void led_ack(uint8_t byte) {
+    if (byte == KBD_RESEND) {
+        keyboard_write(led_state == 1 ? KBD_CMD_SET_LEDS : leds);
+        return;
+    }
+    if (led_state == 1) {
+        led_state = 2;
+        keyboard_write(leds);
+    } else {
+        led_state = 0;
+        if (led_dirty) {
+            led_dirty = 0;
+            update_leds();
         }
-        
-        return scancode;
     }
-    
-    return 0;
 }
 
-int has_key_event(void) {
-    // Check for new scancodes
+static int is_down(uint16_t key) {
+    return (key_down[key / 32] >> (key % 32)) & 1;
+}
+
+static int is_modifier(uint16_t key) {
+    return key == KEY_LSHIFT || key == KEY_RSHIFT || key == KEY_CTRL ||
+           key == KEY_RCTRL || key == KEY_ALT || key == KEY_RALT;
+}
+
+// Shift, Ctrl and Alt stay held while either of the pair is down
+static void update_modifiers(void) {
+    uint8_t mods = held_modifiers & (MOD_CAPS | MOD_NUM);
+    if (is_down(KEY_LSHIFT) || is_down(KEY_RSHIFT)) mods |= MOD_SHIFT;
+    if (is_down(KEY_CTRL) || is_down(KEY_RCTRL)) mods |= MOD_CTRL;
+    if (is_down(KEY_ALT) || is_down(KEY_RALT)) mods |= MOD_ALT;
+    held_modifiers = mods;
+}
+
+static void toggle_lock(uint8_t mod, uint8_t led) {
+    held_modifiers ^= mod;
+    leds ^= led;
+    update_leds();
+}
+
+static void post_key(uint8_t type, uint16_t key, uint32_t repeat) {
+    if (event_post(type, held_modifiers, key, repeat) < 0) {
+        stats.dropped++;
+    }
+}
+
+static void key_event(uint16_t key, int released) {
+    uint32_t bit = 1u << (key % 32);
+    uint32_t* word = &key_down[key / 32];
+
+    if (released) {
+        *word &= ~bit;
+        if (is_modifier(key)) update_modifiers();
+        if (key == repeat_key) repeat_key = 0;
+        post_key(EVENT_KEY_UP, key, 0);
+        return;
+    }
+
+    if (*word & bit) return;        // Hardware typematic, we make our own
+    *word |= bit;
+    stats.presses++;
+
+    if (is_modifier(key)) {
+        update_modifiers();
+    } else if (key == KEY_CAPS) {
+        toggle_lock(MOD_CAPS, LED_CAPS);
+    } else if (key == KEY_NUMLOCK) {
+        toggle_lock(MOD_NUM, LED_NUM);
+    } else if (key == KEY_SCROLLLOCK) {
+        toggle_lock(0, LED_SCROLL);
+    } else {
+        repeat_key = key;
+        repeat_countdown = delay_ticks;
+        repeat_count = 0;
+#ifdef VIN_PERF
+        // Modifiers and locks change nothing on screen by themselves;
+        // other keys that do not are dropped by perf_idle()
+        perf_start(PERF_KEY);
+#endif
+    }
+    post_key(EVENT_KEY_DOWN, key, 0);
+}
+
+static int is_keypad_navigation(uint16_t key) {
+    return key >= 0x47 && key <= 0x53 && key != 0x4A && key != 0x4C && key != 0x4E;
+}
+
+// Keypad keys without Num Lock are the navigation keys. A release goes
+// to whichever form went down, in case Num Lock changed in between.
+static uint16_t translate_keypad(uint16_t key, int released) {
+    if (!is_keypad_navigation(key)) return key;
+    if (released) return is_down(key) ? key : (key | KEY_EXTENDED);
+    return (held_modifiers & MOD_NUM) ? key : (key | KEY_EXTENDED);
+}
+
+static void keyboard_irq(registers_t* regs) {
+    (void)regs;
     read_scancode();
-    return key_buffer_count > 0;
 }
 
-uint8_t get_key_event(void) {
-    if (key_buffer_count == 0) {
-        return 0;
+void init_keyboard(void) {
+    extended = 0;
+    pause_bytes = 0;
+    led_state = 0;
+    led_dirty = 0;
+    repeat_key = 0;
+    for (uint32_t i = 0; i < sizeof(key_down) / 4; i++) {
+        key_down[i] = 0;
     }
-    
-    uint8_t scancode = key_buffer[key_buffer_start];
-    key_buffer_start = (key_buffer_start + 1) % KEY_BUFFER_SIZE;
-    key_buffer_count--;
-    
+
+    // Keep the lock states the BIOS left
+    uint8_t flags = *bios_data_area();
+    held_modifiers = 0;
+    leds = 0;
+    if (flags & BDA_CAPS) {
+        held_modifiers |= MOD_CAPS;
+        leds |= LED_CAPS;
+    }
+    if (flags & BDA_NUM) {
+        held_modifiers |= MOD_NUM;
+        leds |= LED_NUM;
+    }
+    if (flags & BDA_SCROLL) {
+        leds |= LED_SCROLL;
+    }
+
+    uint32_t hz = timer_frequency();
+    delay_ticks = KEY_REPEAT_DELAY_MS * hz / 1000;
+    rate_ticks = KEY_REPEAT_RATE_MS * hz / 1000;
+    if (delay_ticks == 0) delay_ticks = 1;
+    if (rate_ticks == 0) rate_ticks = 1;
+
+    // Drain anything the controller latched during boot
+    while (inb(KEYBOARD_STATUS_PORT) & STATUS_OUTPUT_FULL) {
+        inb(KEYBOARD_DATA_PORT);
+    }
+
+    irq_install_handler(KEYBOARD_IRQ, keyboard_irq);
+    update_leds();
+}
+
+// Reads and decodes one byte from the controller
+uint8_t read_scancode(void) {
+    if (!(inb(KEYBOARD_STATUS_PORT) & STATUS_OUTPUT_FULL)) return 0;
+
+    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+    stats.scancodes++;
+
+    if (led_state != 0 && (scancode == KBD_ACK || scancode == KBD_RESEND)) {
+        led_ack(scancode);
+        return scancode;
+    }
+    if (pause_bytes > 0) {
+        pause_bytes--;
+        return scancode;
+    }
+    if (scancode == 0xE1) {
+        pause_bytes = 5;
+        return scancode;
+    }
+    if (scancode == 0xE0) {
+        extended = 1;
+        return scancode;
+    }
+
+    uint16_t key = scancode & 0x7F;
+    int released = (scancode & 0x80) != 0;
+    if (extended) {
+        extended = 0;
+        // Fake shifts around Print Screen and the navigation keys
+        if (key == KEY_LSHIFT || key == KEY_RSHIFT) return scancode;
+        key |= KEY_EXTENDED;
+    } else {
+        key = translate_keypad(key, released);
+    }
+
+    key_event(key, released);
     return scancode;
 }
 
-char scancode_to_char(uint8_t scancode) {
+void keyboard_tick(void) {
+    if (repeat_key == 0 || --repeat_countdown != 0) return;
+
+    repeat_countdown = rate_ticks;
+    repeat_count++;
+    stats.repeats++;
+    post_key(EVENT_KEY_DOWN, repeat_key, repeat_count);
+}
+
+void keyboard_get_stats(KeyboardStats* out) {
+    uint32_t flags = irq_save();
+    out->scancodes = stats.scancodes;
+    out->presses = stats.presses;
+    out->repeats = stats.repeats;
+    out->dropped = stats.dropped;
+    out->modifiers = held_modifiers;
+    irq_restore(flags);
+}
+
+char scancode_to_char(uint16_t key, uint8_t modifiers) {
     // Handle special keys
-    if (scancode == KEY_ENTER) return '\n';
-    if (scancode == KEY_BACKSPACE) return '\b';
-    if (scancode == KEY_SPACE) return ' ';
-    if (scancode == KEY_TAB) return '\t';
-    if (scancode == KEY_ESC) return 27;
+    if (key == KEY_ENTER || key == KEY_KP_ENTER) return '\n';
+    if (key == KEY_KP_SLASH) return '/';
+    if (key & KEY_EXTENDED) return 0;
+    if (key == KEY_BACKSPACE) return '\b';
+    if (key == KEY_SPACE) return ' ';
+    if (key == KEY_TAB) return '\t';
+    if (key == KEY_ESC) return 27;
     
     // Regular keys without shift
     static const char scancode_to_ascii[] = {
@@ -103,13 +316,33 @@ char scancode_to_char(uint8_t scancode) {
         '*', 0, ' '
     };
     
-    if (scancode < sizeof(scancode_to_ascii)) {
-        if (is_shift_pressed) {
-            return scancode_to_ascii_shift[scancode];
-        } else {
-            return scancode_to_ascii[scancode];
+    // Keypad with Num Lock on (off, the keys arrive as KEY_EXTENDED)
+    static const char keypad_ascii[] = {
+        '7', '8', '9', '-', '4', '5', '6', '+', '1', '2', '3', '0', '.'
+    };
+    
+    if (key >= 0x47 && key <= 0x53) {
+        if (is_keypad_navigation(key) && !(modifiers & MOD_NUM)) return 0;
+        return keypad_ascii[key - 0x47];
+    }
+    
+    if (key < sizeof(scancode_to_ascii)) {
+        char c = scancode_to_ascii[key];
+        
+        // Caps Lock only affects letters, and Shift undoes it
+        int shift = (modifiers & MOD_SHIFT) != 0;
+        if (c >= 'a' && c <= 'z' && (modifiers & MOD_CAPS)) {
+            shift = !shift;
+        }
+        if (shift) {
+            c = scancode_to_ascii_shift[key];
         }
+        
+        // Ctrl+letter gives the control character
+        if ((modifiers & MOD_CTRL) && c >= 'a' && c <= 'z') return c - 'a' + 1;
+        if ((modifiers & MOD_CTRL) && c >= 'A' && c <= 'Z') return c - 'A' + 1;
+        return c;
     }
     
     return 0;
-}
\ No newline at end of file
+}
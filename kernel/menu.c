@@ -2,7 +2,7 @@
 #include "include/menu.h"
 #include "include/stdint.h"
 #include "include/vga.h"
-extern volatile uint16_t* vga_buffer;
+#include "include/string.h"
 
 
 static const char* menu_items[MENU_ITEMS] = {
@@ -13,13 +13,8 @@ static const char* menu_items[MENU_ITEMS] = {
     "Exit"
 };
 
-static uint16_t make_vga_entry(char c, uint8_t color) {
-    return (uint16_t)c | ((uint16_t)color << 8);
-}
-
 static void putchar_at(char c, uint8_t color, uint8_t x, uint8_t y) {
-    if (x >= VGA_WIDTH) return;
-    vga_buffer[y * VGA_WIDTH + x] = make_vga_entry(c, color);
+    vga_putchar(c, color, x, y);
 }
 
 static void puts_at(const char* str, uint8_t color, uint8_t x, uint8_t y) {
@@ -34,12 +29,6 @@ static void fill_line(uint8_t y, char ch, uint8_t color) {
     }
 }
 
-static int str_len(const char* str) {
-    int len = 0;
-    while (str[len] != '\0') len++;
-    return len;
-}
-
 void init_menu(void) {
     // Menu initialized on first draw
 }
@@ -67,7 +56,7 @@ void draw_menu(int selected) {
         
         putchar_at(' ', color, x_pos++, 0);
         puts_at(menu_items[i], color, x_pos, 0);
-        x_pos += str_len(menu_items[i]);
+        x_pos += strlen(menu_items[i]);
         putchar_at(' ', color, x_pos++, 0);
         
         putchar_at(' ', VGA_COLOR(0, 7), x_pos++, 0);
@@ -0,0 +1,89 @@
+// multiboot.c - BootInfo for kernels started by a Multiboot loader
+//
+// Runs before .bss is cleared, so it keeps its state on the stack. The
+// loader's data is copied out first: it may sit anywhere in low memory,
+// including where BootInfo goes.
+#include "include/multiboot.h"
+
+#define IVT_FONT_VECTOR 0x43    // VGA BIOS: 8x8 font for characters 0-127
+
+extern char kernel_start[];     // linker.ld
+extern char bss_start[];
+
+// Address 0, hidden from GCC like in get_boot_info()
+static inline const volatile uint16_t* real_mode_ivt(void) {
+    const volatile uint16_t* ivt;
+    __asm__ ("" : "=r"(ivt) : "0"(0));
+    return ivt;
+}
+
+static void add_region(E820Entry* map, uint32_t* count, uint64_t base,
+                       uint64_t length, uint32_t type) {
+    if (*count >= E820_MAX || length == 0) return;
+    map[*count].base = base;
+    map[*count].length = length;
+    map[*count].type = type;
+    map[*count].acpi = 1;
+    (*count)++;
+}
+
+BootInfo* multiboot_boot_info(const MultibootInfo* info) {
+    E820Entry map[E820_MAX];
+    uint32_t count = 0;
+
+    if (info->flags & MULTIBOOT_INFO_MMAP) {
+        uint32_t addr = info->mmap_addr;
+        uint32_t end = addr + info->mmap_length;
+        while (addr < end) {
+            const MultibootMmapEntry* e = (const MultibootMmapEntry*)addr;
+            add_region(map, &count, e->base, e->length, e->type);
+            addr += e->size + sizeof(e->size);
+        }
+    } else if (info->flags & MULTIBOOT_INFO_MEMORY) {
+        add_region(map, &count, 0, (uint64_t)info->mem_lower * 1024, E820_USABLE);
+        add_region(map, &count, 0x100000, (uint64_t)info->mem_upper * 1024, E820_USABLE);
+    }
+
+    uint32_t fb_addr = 0, fb_pitch = 0, fb_width = 0, fb_height = 0, fb_bpp = 0;
+    if ((info->flags & MULTIBOOT_INFO_FRAMEBUFFER) &&
+        info->framebuffer_type == MULTIBOOT_FRAMEBUFFER_INDEXED &&
+        info->framebuffer_addr < 0x100000000ULL) {
+        fb_addr = (uint32_t)info->framebuffer_addr;
+        fb_pitch = info->framebuffer_pitch;
+        fb_width = info->framebuffer_width;
+        fb_height = info->framebuffer_height;
+        fb_bpp = info->framebuffer_bpp;
+    }
+
+    // Interrupt vector 43h, still in place from the BIOS, points at the
+    // ROM font the bootloader would have asked for
+    const volatile uint16_t* ivt = real_mode_ivt();
+    uint32_t font = ((uint32_t)ivt[IVT_FONT_VECTOR * 2 + 1] << 4) + ivt[IVT_FONT_VECTOR * 2];
+
+    // Cleared word by word through a volatile pointer so the compiler
+    // cannot turn it into a memset call
+    volatile BootInfo* boot = get_boot_info();
+    volatile uint32_t* words;
+    __asm__ ("" : "=r"(words) : "0"(BOOT_INFO_ADDR));
+    for (uint32_t i = 0; i < sizeof(BootInfo) / 4; i++) {
+        words[i] = 0;
+    }
+
+    boot->font8x8 = font;
+    boot->e820_count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        boot->e820[i].base = map[i].base;
+        boot->e820[i].length = map[i].length;
+        boot->e820[i].type = map[i].type;
+        boot->e820[i].acpi = map[i].acpi;
+    }
+    boot->kernel_size = (uint32_t)bss_start - (uint32_t)kernel_start;
+    boot->flags = BOOT_MULTIBOOT;
+    boot->fb_addr = fb_addr;
+    boot->fb_pitch = fb_pitch;
+    boot->fb_width = fb_width;
+    boot->fb_height = fb_height;
+    boot->fb_bpp = fb_bpp;
+
+    return (BootInfo*)boot;
+}
@@ -0,0 +1,205 @@
+// page.c - Bitmap page frame allocator
+//
+// One bit per 4 KB frame from address 0 up to the end of the highest
+// usable E820 region, 1 = in use. Everything starts out used; the usable
+// regions are then freed, and the low megabyte outside the heap window,
+// the kernel image and the bitmap itself stay reserved. The bitmap is
+// placed in the first usable region big enough to hold it.
+#include "include/page.h"
+#include "include/io.h"
+
+#define LOW_MEMORY_END 0x100000
+
+static uint8_t* bitmap = 0;
+static uint32_t frame_count = 0;    // Frames covered by the bitmap
+static uint32_t total_pages = 0;
+static uint32_t free_pages = 0;
+static uint32_t search_hint = 0;    // No free frame below this index
+
+static int page_used(uint32_t frame) {
+    return bitmap[frame / 8] & (1 << (frame % 8));
+}
+
+static void mark(uint32_t first, uint32_t count, int used) {
+    for (uint32_t f = first; f < first + count; f++) {
+        if (used) {
+            bitmap[f / 8] |= 1 << (f % 8);
+        } else {
+            bitmap[f / 8] &= ~(1 << (f % 8));
+        }
+    }
+}
+
+// Release the whole frames inside [start, end)
+static void free_range(uint32_t start, uint32_t end) {
+    uint32_t first = (start + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t last = end / PAGE_SIZE;
+    for (uint32_t f = first; f < last && f < frame_count; f++) {
+        if (page_used(f)) {
+            mark(f, 1, 0);
+            free_pages++;
+            total_pages++;
+        }
+    }
+}
+
+// Reserve every frame touching [start, end)
+static void reserve_range(uint32_t start, uint32_t end) {
+    uint32_t first = start / PAGE_SIZE;
+    uint32_t last = (end + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (uint32_t f = first; f < last && f < frame_count; f++) {
+        if (!page_used(f)) {
+            mark(f, 1, 1);
+            free_pages--;
+        }
+    }
+}
+
+// Usable part of an E820 entry below 4 GB, 0 if there is none
+static int usable_range(const E820Entry* e, uint32_t* start, uint32_t* end) {
+    if (e->type != E820_USABLE) return 0;
+    if ((e->acpi & 1) == 0) return 0;           // Entry marked "ignore"
+    if (e->base >= 0x100000000ULL) return 0;
+
+    uint64_t top = e->base + e->length;
+    if (top > 0xFFFFF000ULL) top = 0xFFFFF000ULL;
+    if (top <= e->base) return 0;
+
+    *start = (uint32_t)e->base;
+    *end = (uint32_t)top;
+    return 1;
+}
+
+void page_init(const BootInfo* boot_info, uint32_t kernel_end) {
+    E820Entry fallback;
+    const E820Entry* map = boot_info->e820;
+    uint32_t entries = boot_info->e820_count;
+    uint32_t start, end;
+
+    // No memory map: use the conventional memory the kernel always had
+    if (entries == 0 || entries > E820_MAX) {
+        fallback.base = 0;
+        fallback.length = PAGE_LOW_END;
+        fallback.type = E820_USABLE;
+        fallback.acpi = 1;
+        map = &fallback;
+        entries = 1;
+    }
+
+    uint32_t highest = 0;
+    for (uint32_t i = 0; i < entries; i++) {
+        if (usable_range(&map[i], &start, &end) && end > highest) {
+            highest = end;
+        }
+    }
+    frame_count = highest / PAGE_SIZE;
+    uint32_t bitmap_bytes = (frame_count + 7) / 8;
+
+    // Home for the bitmap: lowest usable spot clear of the kernel and of
+    // the reserved part of low memory
+    bitmap = 0;
+    for (uint32_t i = 0; i < entries && bitmap == 0; i++) {
+        if (!usable_range(&map[i], &start, &end)) continue;
+        if (start < kernel_end) start = kernel_end;
+        start = (start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        if (start < LOW_MEMORY_END && start + bitmap_bytes > PAGE_LOW_END) {
+            start = LOW_MEMORY_END;
+        }
+        if (start < end && end - start >= bitmap_bytes) {
+            bitmap = (uint8_t*)start;
+        }
+    }
+    if (bitmap == 0) {
+        frame_count = 0;
+        return;
+    }
+
+    for (uint32_t i = 0; i < bitmap_bytes; i++) {
+        bitmap[i] = 0xFF;
+    }
+    total_pages = 0;
+    free_pages = 0;
+    for (uint32_t i = 0; i < entries; i++) {
+        if (usable_range(&map[i], &start, &end)) {
+            free_range(start, end);
+        }
+    }
+
+    // Low memory outside [kernel_end, PAGE_LOW_END): IVT, BIOS data,
+    // BootInfo, kernel image, stack, EBDA, video memory and ROMs
+    reserve_range(0, kernel_end);
+    reserve_range(PAGE_LOW_END, LOW_MEMORY_END);
+    reserve_range((uint32_t)bitmap, (uint32_t)bitmap + bitmap_bytes);
+
+    total_pages = free_pages;
+    search_hint = 0;
+    while (search_hint < frame_count && page_used(search_hint)) {
+        search_hint++;
+    }
+}
+
+static void* alloc_frames(uint32_t count) {
+    if (count == 0 || count > free_pages) return 0;
+
+    // First fit, skipping fully used bytes of the bitmap
+    uint32_t run = 0;
+    for (uint32_t f = search_hint; f < frame_count; f++) {
+        if (f % 8 == 0 && bitmap[f / 8] == 0xFF && f + 8 <= frame_count) {
+            run = 0;
+            f += 7;
+            continue;
+        }
+        if (page_used(f)) {
+            run = 0;
+            continue;
+        }
+        if (++run == count) {
+            uint32_t first = f + 1 - count;
+            mark(first, count, 1);
+            free_pages -= count;
+            if (first == search_hint) search_hint = f + 1;
+            return (void*)(first * PAGE_SIZE);
+        }
+    }
+    return 0;
+}
+
+static void free_frames(void* addr, uint32_t count) {
+    uint32_t first = (uint32_t)addr / PAGE_SIZE;
+    if ((uint32_t)addr % PAGE_SIZE != 0 || first + count > frame_count) return;
+
+    mark(first, count, 0);
+    free_pages += count;
+    if (first < search_hint) search_hint = first;
+}
+
+// Threads allocate too, so the bitmap is updated with interrupts off
+void* page_alloc(uint32_t count) {
+    uint32_t flags = irq_save();
+    void* addr = alloc_frames(count);
+    irq_restore(flags);
+    return addr;
+}
+
+void page_free(void* addr, uint32_t count) {
+    uint32_t flags = irq_save();
+    free_frames(addr, count);
+    irq_restore(flags);
+}
+
+void page_get_stats(PageStats* stats) {
+    uint32_t run = 0;
+    uint32_t longest = 0;
+    for (uint32_t f = 0; f < frame_count; f++) {
+        if (page_used(f)) {
+            run = 0;
+        } else if (++run > longest) {
+            longest = run;
+        }
+    }
+
+    stats->total_pages = total_pages;
+    stats->free_pages = free_pages;
+    stats->largest_free_run = longest;
+    stats->highest_address = frame_count * PAGE_SIZE;
+}
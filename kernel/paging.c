@@ -0,0 +1,159 @@
+// paging.c - Page directory, PAT setup and guard pages
+//
+// The first 4 MB go through a page table so single pages can be left
+// unmapped (stack guards) or get their own memory type (VGA). Everything
+// above is mapped with 4 MB PSE pages, one directory entry each, so the
+// whole heap fits in a handful of TLB entries. Without PSE the upper
+// memory gets page tables from the page allocator instead.
+#include "include/paging.h"
+#include "include/page.h"
+#include "include/io.h"
+
+#define PTE_PRESENT  0x001
+#define PTE_WRITABLE 0x002
+#define PTE_PWT      0x008
+#define PTE_PCD      0x010
+#define PTE_PAT      0x080      // In a 4 KB page table entry
+#define PDE_LARGE    0x080      // 4 MB page (PSE)
+#define PDE_PAT      0x1000     // In a 4 MB directory entry
+
+#define ENTRIES 1024
+#define LARGE_PAGE_SHIFT 22
+
+#define VGA_START 0xA0000
+#define VGA_END   0xC0000
+
+// Power-on PAT with entry 4 changed from write-back to write-combining.
+// A PTE selects entry 4 with only its PAT bit set; entries 0-3 (the
+// PWT/PCD combinations) keep their usual meaning.
+#define MSR_PAT   0x277
+#define PAT_VALUE 0x0007040100070406ULL
+
+#define CPUID_PSE (1 << 3)
+#define CPUID_PAT (1 << 16)
+
+#define CR0_WP  (1 << 16)
+#define CR0_PG  (1u << 31)
+#define CR4_PSE (1 << 4)
+
+static uint32_t page_directory[ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t low_table[ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+
+static PagingInfo info;
+
+static uint32_t vga_flags(int type) {
+    return type == VGA_CACHE_WC ? PTE_PAT : PTE_PCD | PTE_PWT;
+}
+
+static void fill_table(uint32_t* table, uint32_t base, uint32_t flags) {
+    for (int i = 0; i < ENTRIES; i++) {
+        table[i] = (base + i * PAGE_SIZE) | PTE_PRESENT | PTE_WRITABLE | flags;
+    }
+}
+
+// A linear framebuffer from a Multiboot loader usually lies above RAM.
+// It gets the VGA window's memory type.
+static void map_framebuffer(const BootInfo* boot_info) {
+    if (boot_info->fb_addr == 0) return;
+
+    uint32_t last = boot_info->fb_addr + boot_info->fb_pitch * boot_info->fb_height - 1;
+    for (uint32_t pde = boot_info->fb_addr >> LARGE_PAGE_SHIFT;
+         pde <= last >> LARGE_PAGE_SHIFT; pde++) {
+        if (page_directory[pde] != 0) continue;     // Already mapped as RAM
+
+        uint32_t base = pde << LARGE_PAGE_SHIFT;
+        if (info.pse) {
+            uint32_t type = info.vga_cache == VGA_CACHE_WC ? PDE_PAT : PTE_PCD | PTE_PWT;
+            page_directory[pde] = base | type | PDE_LARGE | PTE_PRESENT | PTE_WRITABLE;
+            info.large_pages++;
+            continue;
+        }
+
+        uint32_t* table = (uint32_t*)page_alloc(1);
+        if (table == 0) return;
+        fill_table(table, base, vga_flags(info.vga_cache));
+        page_directory[pde] = (uint32_t)table | PTE_PRESENT | PTE_WRITABLE;
+        info.small_pages += ENTRIES;
+    }
+}
+
+void paging_init(const BootInfo* boot_info) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    info.pse = (edx & CPUID_PSE) != 0;
+    info.pat = (edx & CPUID_PAT) != 0;
+    info.vga_cache = info.pat ? VGA_CACHE_WC : VGA_CACHE_UC;
+    info.large_pages = 0;
+    info.small_pages = 0;
+
+    // Low 4 MB: kernel, stack, VGA and the start of the heap
+    fill_table(low_table, 0, 0);
+    low_table[KERNEL_STACK_GUARD / PAGE_SIZE] = 0;
+    low_table[KERNEL_STACK_TOP / PAGE_SIZE] = 0;
+    for (uint32_t addr = VGA_START; addr < VGA_END; addr += PAGE_SIZE) {
+        low_table[addr / PAGE_SIZE] |= vga_flags(info.vga_cache);
+    }
+    page_directory[0] = (uint32_t)low_table | PTE_PRESENT | PTE_WRITABLE;
+    info.small_pages = ENTRIES - 2;
+
+    // The rest of RAM, rounded up to whole directory entries
+    PageStats pages;
+    page_get_stats(&pages);
+    uint32_t top = pages.highest_address;
+    uint32_t used = (top >> LARGE_PAGE_SHIFT) + ((top & ((1 << LARGE_PAGE_SHIFT) - 1)) != 0);
+
+    uint32_t pde;
+    for (pde = 1; pde < used && pde < ENTRIES; pde++) {
+        uint32_t base = pde << LARGE_PAGE_SHIFT;
+        if (info.pse) {
+            page_directory[pde] = base | PDE_LARGE | PTE_PRESENT | PTE_WRITABLE;
+            info.large_pages++;
+            continue;
+        }
+
+        uint32_t* table = (uint32_t*)page_alloc(1);
+        if (table == 0) break;
+        fill_table(table, base, 0);
+        page_directory[pde] = (uint32_t)table | PTE_PRESENT | PTE_WRITABLE;
+        info.small_pages += ENTRIES;
+    }
+    info.mapped_bytes = pde << LARGE_PAGE_SHIFT;
+    map_framebuffer(boot_info);
+
+    // The PAT is reprogrammed while paging is still off, so no mapping
+    // can be using the old entry 4
+    if (info.pat) {
+        wrmsr(MSR_PAT, PAT_VALUE);
+        __asm__ volatile ("wbinvd");
+    }
+
+    uint32_t cr;
+    if (info.pse) {
+        __asm__ volatile ("mov %%cr4, %0" : "=r"(cr));
+        cr |= CR4_PSE;
+        __asm__ volatile ("mov %0, %%cr4" : : "r"(cr));
+    }
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(page_directory) : "memory");
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr));
+    cr |= CR0_PG | CR0_WP;
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(cr) : "memory");
+}
+
+int paging_set_vga_cache(int type) {
+    if (type == VGA_CACHE_WC && !info.pat) type = VGA_CACHE_UC;
+
+    // Drain pending combined writes before the type changes
+    __asm__ volatile ("wbinvd" : : : "memory");
+    for (uint32_t addr = VGA_START; addr < VGA_END; addr += PAGE_SIZE) {
+        uint32_t* pte = &low_table[addr / PAGE_SIZE];
+        *pte = (*pte & ~(PTE_PAT | PTE_PCD | PTE_PWT)) | vga_flags(type);
+        invlpg(addr);
+    }
+
+    info.vga_cache = type;
+    return type;
+}
+
+void paging_get_info(PagingInfo* out) {
+    *out = info;
+}
@@ -0,0 +1,81 @@
+// perf.c - Latency probes reported over the serial port (see perf.h)
+#include "include/perf.h"
+#include "include/serial.h"
+#include "include/kernel.h"
+#include "include/timer.h"
+#include "include/vga.h"
+#include "include/io.h"
+#include "include/string.h"
+
+static const char* const probe_names[PERF_PROBES] = {
+    "key_to_vga_us", "window_open_us", "window_close_us"
+};
+
+// TSC at the start of each probe, 0 while it is idle. Written by IRQs,
+// so read and cleared with interrupts off: 64-bit stores are two moves.
+static volatile uint64_t started[PERF_PROBES];
+static uint32_t last_presents = 0;
+static int boot_reported = 0;
+
+void perf_init(void) {
+    for (int i = 0; i < PERF_PROBES; i++) {
+        started[i] = 0;
+    }
+    last_presents = 0;
+    boot_reported = 0;
+    serial_init();
+}
+
+void perf_start(int probe) {
+    uint32_t flags = irq_save();
+    if (started[probe] == 0) started[probe] = rdtsc();
+    irq_restore(flags);
+}
+
+void perf_report(const char* name, uint32_t value) {
+    char line[64] = "PERF ";
+    strlcpy(line + 5, name, sizeof(line) - 18);
+    int len = strlen(line);
+    line[len++] = ' ';
+    len += fmt_uint(line + len, value);
+    line[len++] = '\n';
+    serial_write(line, len);
+}
+
+// Loader and kernel entry to the first desktop frame, once tsc_to_us
+// has a calibration worth using
+static void report_boot(void) {
+    const BootTimes* boot = get_boot_times();
+    if (boot->desktop_ready == 0 || uptime_ms() < PERF_SETTLE_MS) return;
+
+    if (boot->loader_start != 0) {
+        perf_report("boot_to_desktop_us", tsc_to_us(boot->desktop_ready - boot->loader_start));
+    }
+    perf_report("kernel_to_desktop_us", tsc_to_us(boot->desktop_ready - boot->kernel_entry));
+    serial_print("PERF ready\n");
+    boot_reported = 1;
+}
+
+void perf_idle(uint64_t since) {
+    uint32_t flags = irq_save();
+    if (started[PERF_KEY] != 0 && started[PERF_KEY] < since) started[PERF_KEY] = 0;
+    irq_restore(flags);
+}
+
+void perf_frame(void) {
+    if (!boot_reported) report_boot();
+
+    VgaStats stats;
+    vga_get_stats(&stats);
+    if (stats.presents == last_presents) return;
+    last_presents = stats.presents;
+
+    uint64_t now = rdtsc();
+    for (int i = 0; i < PERF_PROBES; i++) {
+        uint32_t flags = irq_save();
+        uint64_t start = started[i];
+        started[i] = 0;
+        irq_restore(flags);
+        if (start != 0) perf_report(probe_names[i], tsc_to_us(now - start));
+    }
+}
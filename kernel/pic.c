@@ -0,0 +1,66 @@
+// pic.c - 8259 PIC remapping and masking
+#include "include/pic.h"
+#include "include/io.h"
+
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+
+#define PIC_EOI      0x20
+#define ICW1_INIT    0x11  // Init + expect ICW4
+#define ICW4_8086    0x01
+
+void pic_remap(void) {
+    // Start init sequence in cascade mode
+    outb(PIC1_COMMAND, ICW1_INIT);
+    io_wait();
+    outb(PIC2_COMMAND, ICW1_INIT);
+    io_wait();
+
+    // Vector offsets
+    outb(PIC1_DATA, PIC_MASTER_OFFSET);
+    io_wait();
+    outb(PIC2_DATA, PIC_SLAVE_OFFSET);
+    io_wait();
+
+    // Slave is on master's IRQ2
+    outb(PIC1_DATA, 0x04);
+    io_wait();
+    outb(PIC2_DATA, 0x02);
+    io_wait();
+
+    outb(PIC1_DATA, ICW4_8086);
+    io_wait();
+    outb(PIC2_DATA, ICW4_8086);
+    io_wait();
+
+    // Mask everything except the cascade line; drivers unmask their own IRQ
+    outb(PIC1_DATA, 0xFB);
+    outb(PIC2_DATA, 0xFF);
+}
+
+void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        outb(PIC2_COMMAND, PIC_EOI);
+    }
+    outb(PIC1_COMMAND, PIC_EOI);
+}
+
+void pic_mask_irq(uint8_t irq) {
+    uint16_t port = PIC1_DATA;
+    if (irq >= 8) {
+        port = PIC2_DATA;
+        irq -= 8;
+    }
+    outb(port, inb(port) | (1 << irq));
+}
+
+void pic_unmask_irq(uint8_t irq) {
+    uint16_t port = PIC1_DATA;
+    if (irq >= 8) {
+        port = PIC2_DATA;
+        irq -= 8;
+    }
+    outb(port, inb(port) & ~(1 << irq));
+}
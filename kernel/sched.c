@@ -0,0 +1,317 @@
+// sched.c - Threads, round-robin scheduler and event delivery
+//
+// All threads sit on one circular list. schedule() walks it from the
+// current thread to the next runnable one and switches stacks with
+// switch_context. It runs with interrupts off, either from a thread that
+// yields or waits, or at the end of the timer IRQ (after EOI) when the
+// running thread's slice is used up.
+//
+// kernel_main becomes the first thread and never waits for events, so
+// there is always a runnable thread. A thread that exits cannot free the
+// stack it is running on; the next thread to run frees it.
+//
+// x87 state (the calculator works in doubles) is switched lazily: a
+// switch only sets CR0.TS, and the first FPU instruction after it traps
+// (#NM) into sched_fpu_trap(), which saves the previous owner's
+// registers and loads the running thread's, or gives it a clean FPU.
+#include "include/sched.h"
+#include "include/heap.h"
+#include "include/page.h"
+#include "include/io.h"
+
+#define THREAD_RUNNABLE 0
+#define THREAD_WAITING  1           // For an event
+#define THREAD_DEAD     2
+
+#define CR0_MP (1 << 1)
+#define CR0_EM (1 << 2)
+#define CR0_TS (1 << 3)
+#define CR0_NE (1 << 5)
+#define CPUID_FXSR (1 << 24)
+
+#define FPU_STATE_SIZE 512          // fxsave; fnsave needs 108
+
+struct Thread {
+    uint32_t esp;                   // Saved by switch_context
+    const char* name;
+    int state;
+    void* stack;                    // 0 for the kernel_main thread
+    void (*entry)(void*);
+    void* arg;
+    uint64_t wake_tsc;              // When an event made it runnable
+    int fpu_used;                   // fpu_state holds its registers
+    uint8_t fpu_state[FPU_STATE_SIZE + 16];    // Aligned to 16 on use
+    EventQueue queue;
+    Event events[THREAD_EVENTS];
+    Thread* next;
+};
+
+static KmemCache thread_cache;
+static Thread* current = 0;
+static Thread* zombie = 0;          // Exited, stack not yet freed
+static int slice_left = SCHED_SLICE_TICKS;
+static volatile int need_resched = 0;
+static uint64_t switch_start = 0;
+static Thread* fpu_owner = 0;       // Whose registers the FPU holds
+static int has_fxsr = 0;
+static SchedStats stats;
+
+extern void switch_context(uint32_t* old_esp, uint32_t new_esp);
+
+static uint32_t read_cr0(void) {
+    uint32_t cr0;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    return cr0;
+}
+
+static void write_cr0(uint32_t cr0) {
+    __asm__ volatile ("mov %0, %%cr0" : : "r"(cr0));
+}
+
+static void* fpu_area(Thread* thread) {
+    return (void*)(((uint32_t)thread->fpu_state + 15) & ~15u);
+}
+
+// Moving average over roughly the last 8 samples
+static void average(uint32_t* avg, uint32_t sample) {
+    if (*avg == 0) *avg = sample;
+    else *avg = *avg - *avg / 8 + sample / 8;
+}
+
+static uint32_t clamp32(uint64_t value) {
+    return (value >> 32) ? 0xFFFFFFFF : (uint32_t)value;
+}
+
+// First code a thread runs after a switch: account for it and free the
+// stack of a thread that exited
+static void finish_switch(void) {
+    uint64_t now = rdtsc();
+    average(&stats.switch_cycles, clamp32(now - switch_start));
+
+    if (current->wake_tsc) {
+        uint32_t latency = clamp32(now - current->wake_tsc);
+        average(&stats.latency_cycles, latency);
+        if (latency > stats.max_latency_cycles) stats.max_latency_cycles = latency;
+        current->wake_tsc = 0;
+    }
+
+    if (zombie && zombie != current) {
+        page_free(zombie->stack, THREAD_STACK_PAGES);
+        kmem_cache_free(&thread_cache, zombie);
+        zombie = 0;
+    }
+}
+
+// Interrupts must be off
+static void schedule(void) {
+    Thread* prev = current;
+    Thread* next = prev->next;
+    while (next != prev && next->state != THREAD_RUNNABLE) {
+        next = next->next;
+    }
+
+    slice_left = SCHED_SLICE_TICKS;
+    need_resched = 0;
+    if (next == prev) return;
+
+    current = next;
+    stats.switches++;
+    switch_start = rdtsc();
+
+    // Leave the FPU untouched until the next thread uses it
+    uint32_t cr0 = read_cr0();
+    if (next == fpu_owner) {
+        if (cr0 & CR0_TS) write_cr0(cr0 & ~CR0_TS);
+    } else if (!(cr0 & CR0_TS)) {
+        write_cr0(cr0 | CR0_TS);
+    }
+
+    switch_context(&prev->esp, next->esp);
+    finish_switch();
+}
+
+// A new thread's first "return" from switch_context lands here
+static void thread_start(void) {
+    finish_switch();
+    enable_interrupts();
+    current->entry(current->arg);
+    thread_exit();
+}
+
+void sched_init(void) {
+    kmem_cache_init(&thread_cache, "thread", sizeof(Thread));
+
+    // Native x87 errors, FPU instructions trap while TS is set
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    has_fxsr = (edx & CPUID_FXSR) != 0;
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+    fpu_owner = 0;
+
+    Thread* main = (Thread*)kmem_cache_alloc(&thread_cache);
+    main->name = "desktop";
+    main->state = THREAD_RUNNABLE;
+    main->stack = 0;
+    main->wake_tsc = 0;
+    main->fpu_used = 0;
+    event_queue_init(&main->queue, main->events, THREAD_EVENTS);
+    main->next = main;
+
+    current = main;
+    stats.threads = 1;
+}
+
+Thread* thread_create(const char* name, void (*entry)(void*), void* arg) {
+    Thread* thread = (Thread*)kmem_cache_alloc(&thread_cache);
+    if (thread == 0) return 0;
+    thread->stack = page_alloc(THREAD_STACK_PAGES);
+    if (thread->stack == 0) {
+        kmem_cache_free(&thread_cache, thread);
+        return 0;
+    }
+
+    thread->name = name;
+    thread->state = THREAD_RUNNABLE;
+    thread->entry = entry;
+    thread->arg = arg;
+    thread->wake_tsc = 0;
+    thread->fpu_used = 0;
+    event_queue_init(&thread->queue, thread->events, THREAD_EVENTS);
+
+    // Frame for switch_context to pop: edi, esi, ebx, ebp, then return
+    // into thread_start (with a dummy return address of its own above)
+    uint32_t* sp = (uint32_t*)((uint8_t*)thread->stack + THREAD_STACK_PAGES * PAGE_SIZE);
+    *--sp = 0;
+    *--sp = (uint32_t)thread_start;
+    for (int i = 0; i < 4; i++) {
+        *--sp = 0;
+    }
+    thread->esp = (uint32_t)sp;
+
+    uint32_t flags = irq_save();
+    thread->next = current->next;
+    current->next = thread;
+    stats.threads++;
+    irq_restore(flags);
+    return thread;
+}
+
+void thread_exit(void) {
+    disable_interrupts();
+
+    // Unlink; current->next stays valid for schedule() to start from
+    Thread* prev = current;
+    while (prev->next != current) {
+        prev = prev->next;
+    }
+    prev->next = current->next;
+
+    current->state = THREAD_DEAD;
+    zombie = current;
+    if (fpu_owner == current) fpu_owner = 0;
+    stats.threads--;
+    schedule();
+
+    while (1) {
+        __asm__ volatile ("hlt");   // Not reached
+    }
+}
+
+void thread_yield(void) {
+    uint32_t flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+int sched_others_runnable(void) {
+    for (Thread* t = current->next; t != current; t = t->next) {
+        if (t->state == THREAD_RUNNABLE) return 1;
+    }
+    return 0;
+}
+
+// The queue itself is lock-free; interrupts are only off to change the
+// receiver's state without racing its check for an empty queue
+int msg_send(Thread* thread, const Event* event) {
+    if (event_queue_push(&thread->queue, event) < 0) {
+        stats.queue_overflows++;
+        return -1;
+    }
+
+    uint32_t flags = irq_save();
+    if (thread->state == THREAD_WAITING) {
+        thread->state = THREAD_RUNNABLE;
+        thread->wake_tsc = rdtsc();
+        stats.wakeups++;
+    }
+    irq_restore(flags);
+    return 0;
+}
+
+void msg_receive(Event* event) {
+    uint32_t flags = irq_save();
+    while (event_queue_empty(&current->queue)) {
+        current->state = THREAD_WAITING;
+        schedule();
+    }
+    irq_restore(flags);
+
+    event_queue_pop(&current->queue, event);
+}
+
+void mutex_lock(Mutex* mutex) {
+    uint32_t flags = irq_save();
+    while (mutex->owner != 0 && mutex->owner != current) {
+        mutex->contended++;
+        schedule();
+    }
+    mutex->owner = current;
+    mutex->depth++;
+    irq_restore(flags);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    uint32_t flags = irq_save();
+    if (mutex->owner == current && --mutex->depth == 0) {
+        mutex->owner = 0;
+    }
+    irq_restore(flags);
+}
+
+void sched_tick(void) {
+    if (current && --slice_left <= 0) {
+        need_resched = 1;
+    }
+}
+
+void sched_irq_exit(void) {
+    if (!need_resched) return;
+    stats.preemptions++;
+    schedule();
+}
+
+void sched_fpu_trap(void) {
+    __asm__ volatile ("clts");
+    if (fpu_owner == current) return;
+
+    if (fpu_owner) {
+        if (has_fxsr) __asm__ volatile ("fxsave %0" : "=m"(*(uint8_t (*)[512])fpu_area(fpu_owner)));
+        else __asm__ volatile ("fnsave %0" : "=m"(*(uint8_t (*)[108])fpu_area(fpu_owner)));
+        fpu_owner->fpu_used = 1;
+    }
+
+    if (current->fpu_used) {
+        if (has_fxsr) __asm__ volatile ("fxrstor %0" : : "m"(*(uint8_t (*)[512])fpu_area(current)));
+        else __asm__ volatile ("frstor %0" : : "m"(*(uint8_t (*)[108])fpu_area(current)));
+    } else {
+        __asm__ volatile ("fninit");
+    }
+    fpu_owner = current;
+    stats.fpu_switches++;
+}
+
+void sched_get_stats(SchedStats* out) {
+    uint32_t flags = irq_save();
+    *out = stats;
+    irq_restore(flags);
+}
@@ -0,0 +1,57 @@
+// serial.c - COM1 output through a 16550 UART, polled
+//
+// Used for machine-readable reports (see perf.h). There is no receive
+// side and no interrupt: each byte waits for room in the transmit
+// holding register, with a bound so a stuck UART cannot hang the kernel.
+#include "include/serial.h"
+#include "include/io.h"
+#include "include/string.h"
+
+#define COM1 0x3F8
+
+#define REG_DATA     0          // Divisor low byte with DLAB set
+#define REG_IER      1          // Divisor high byte with DLAB set
+#define REG_FCR      2
+#define REG_LCR      3
+#define REG_MCR      4
+#define REG_LSR      5
+#define REG_SCRATCH  7
+
+#define LCR_DLAB     0x80
+#define LCR_8N1      0x03
+#define FCR_ENABLE   0xC7       // FIFOs on and cleared, 14-byte trigger
+#define MCR_DTR_RTS  0x03
+#define LSR_THR_EMPTY 0x20
+
+#define SEND_TIMEOUT 100000
+
+static int present = 0;
+
+int serial_init(void) {
+    // Nothing there reads back 0xFF, not what was written
+    outb(COM1 + REG_SCRATCH, 0x5A);
+    present = inb(COM1 + REG_SCRATCH) == 0x5A;
+    if (!present) return -1;
+
+    outb(COM1 + REG_IER, 0);
+    outb(COM1 + REG_LCR, LCR_DLAB);
+    outb(COM1 + REG_DATA, 1);   // 115200 / 1
+    outb(COM1 + REG_IER, 0);
+    outb(COM1 + REG_LCR, LCR_8N1);
+    outb(COM1 + REG_FCR, FCR_ENABLE);
+    outb(COM1 + REG_MCR, MCR_DTR_RTS);
+    return 0;
+}
+
+void serial_write(const char* data, uint32_t len) {
+    if (!present) return;
+    for (uint32_t i = 0; i < len; i++) {
+        for (int t = 0; t < SEND_TIMEOUT && !(inb(COM1 + REG_LSR) & LSR_THR_EMPTY); t++) {
+        }
+        outb(COM1 + REG_DATA, data[i]);
+    }
+}
+
+void serial_print(const char* text) {
+    serial_write(text, strlen(text));
+}
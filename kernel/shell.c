@@ -0,0 +1,336 @@
+// shell.c - Command line parsing, the command registry and file commands
+#include "include/shell.h"
+#include "include/filesystem.h"
+#include "include/string.h"
+
+static ShellCommand* buckets[SHELL_BUCKETS];
+static ShellCommand* first_command = 0;
+static ShellCommand* last_command = 0;
+
+void shell_append(char* line, const char* text, int max) {
+    int len = strlen(line);
+    strlcpy(line + len, text, max - len);
+}
+
+void shell_append_number(char* line, uint32_t value, int max) {
+    char digits[12];
+    fmt_uint(digits, value);
+    shell_append(line, digits, max);
+}
+
+// "<command>: <name>: <problem>"
+static int fail(ShellOutput* out, const char* command, const char* name, const char* problem) {
+    char line[80] = "";
+    shell_append(line, command, 80);
+    shell_append(line, ": ", 80);
+    if (name) {
+        shell_append(line, name, 80);
+        shell_append(line, ": ", 80);
+    }
+    shell_append(line, problem, 80);
+    shell_print(out, line);
+    return -1;
+}
+
+// FNV-1a
+static uint32_t name_hash(const char* name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int shell_register(ShellCommand* command) {
+    if (shell_find(command->name)) return -1;
+
+    ShellCommand** bucket = &buckets[name_hash(command->name) & (SHELL_BUCKETS - 1)];
+    command->next = *bucket;
+    *bucket = command;
+
+    command->order = 0;
+    if (last_command) {
+        last_command->order = command;
+    } else {
+        first_command = command;
+    }
+    last_command = command;
+    return 0;
+}
+
+const ShellCommand* shell_find(const char* name) {
+    ShellCommand* command = buckets[name_hash(name) & (SHELL_BUCKETS - 1)];
+    while (command && strcmp(command->name, name) != 0) {
+        command = command->next;
+    }
+    return command;
+}
+
+const ShellCommand* shell_commands(void) {
+    return first_command;
+}
+
+int shell_tokenize(char* line, char** argv) {
+    // Words are copied down over the quotes and backslashes they drop,
+    // so out never passes in
+    char* in = line;
+    char* out = line;
+    int argc = 0;
+
+    while (1) {
+        while (*in == ' ' || *in == '\t') in++;
+        if (*in == '\0') return argc;
+        if (argc == SHELL_MAX_ARGS) return -1;
+        argv[argc++] = out;
+
+        char quote = 0;
+        while (*in != '\0') {
+            char c = *in;
+            if (quote && c == quote) {
+                quote = 0;
+                in++;
+                continue;
+            }
+            if (!quote && (c == ' ' || c == '\t')) break;
+            if (!quote && (c == '"' || c == '\'')) {
+                quote = c;
+                in++;
+                continue;
+            }
+            if (c == '\\' && quote != '\'' && in[1] != '\0') {
+                c = *++in;
+            }
+            *out++ = c;
+            in++;
+        }
+        if (quote) return -1;
+
+        int more = *in != '\0';
+        *out++ = '\0';
+        if (more) in++;
+        else return argc;
+    }
+}
+
+int shell_run(ShellOutput* out, char* line) {
+    char* argv[SHELL_MAX_ARGS];
+    int argc = shell_tokenize(line, argv);
+    if (argc < 0) return fail(out, "shell", 0, "unterminated quote or too many words");
+    if (argc == 0) return 0;
+
+    const ShellCommand* command = shell_find(argv[0]);
+    if (command == 0) return fail(out, argv[0], 0, "unknown command, type 'help'");
+    return command->run(out, argc, argv);
+}
+
+void shell_write(ShellOutput* out, const char* data, uint32_t len) {
+    out->write(out->ctx, data, len);
+}
+
+void shell_print(ShellOutput* out, const char* text) {
+    out->write(out->ctx, text, strlen(text));
+    out->write(out->ctx, "\n", 1);
+}
+
+// ---- File commands ----
+//
+// File data is read and written in place in the sector cache, an extent
+// (at most a block) at a time, through fs_borrow and fs_extent.
+
+// Append len bytes at *offset, committing each extent as it fills
+static int write_extents(int handle, uint32_t* offset, const char* data, uint32_t len) {
+    while (len > 0) {
+        char* extent;
+        int room = fs_extent(handle, *offset, &extent);
+        if (room < 0) return -1;
+
+        uint32_t chunk = (uint32_t)room < len ? (uint32_t)room : len;
+        memcpy(extent, data, chunk);
+        if (fs_commit(handle, chunk) < 0) return -1;
+        *offset += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+// Create the file or empty it, and open it for write_extents
+static int open_empty(const char* name) {
+    if (fs_write_file(name, "", 0) < 0) return -1;
+    return fs_open(name);
+}
+
+static int cmd_cat(ShellOutput* out, int argc, char** argv) {
+    if (argc < 2) return fail(out, "usage", 0, "cat <file>...");
+
+    int result = 0;
+    for (int i = 1; i < argc; i++) {
+        int handle = fs_open(argv[i]);
+        if (handle < 0) {
+            result = fail(out, "cat", argv[i], "not found");
+            continue;
+        }
+        if (fs_is_dir(handle)) {
+            fs_close(handle);
+            result = fail(out, "cat", argv[i], "is a directory");
+            continue;
+        }
+
+        const char* data;
+        uint32_t offset = 0;
+        char last = '\n';
+        int got;
+        while ((got = fs_borrow(handle, offset, &data)) > 0) {
+            shell_write(out, data, got);
+            last = data[got - 1];
+            fs_release(data);
+            offset += got;
+        }
+        if (last != '\n') shell_write(out, "\n", 1);
+        if (got < 0) result = fail(out, "cat", argv[i], "read error");
+        fs_close(handle);
+    }
+    return result;
+}
+
+// The words after the file name, separated by spaces, as one line
+static int cmd_write(ShellOutput* out, int argc, char** argv) {
+    if (argc < 2) return fail(out, "usage", 0, "write <file> [text...]");
+
+    int handle = open_empty(argv[1]);
+    if (handle < 0) return fail(out, "write", argv[1], "cannot write");
+
+    uint32_t offset = 0;
+    int result = 0;
+    for (int i = 2; i < argc && result == 0; i++) {
+        result = write_extents(handle, &offset, argv[i], strlen(argv[i]));
+        if (result == 0) result = write_extents(handle, &offset, i + 1 < argc ? " " : "\n", 1);
+    }
+    fs_close(handle);
+    if (result < 0) return fail(out, "write", argv[1], "cannot write");
+    return 0;
+}
+
+static int cmd_rm(ShellOutput* out, int argc, char** argv) {
+    if (argc < 2) return fail(out, "usage", 0, "rm <file>...");
+
+    int result = 0;
+    for (int i = 1; i < argc; i++) {
+        if (fs_delete_file(argv[i]) < 0) {
+            result = fail(out, "rm", argv[i], "cannot remove");
+        }
+    }
+    return result;
+}
+
+static int cmd_cp(ShellOutput* out, int argc, char** argv) {
+    if (argc != 3) return fail(out, "usage", 0, "cp <source> <dest>");
+
+    int handle = fs_open(argv[1]);
+    if (handle < 0) return fail(out, "cp", argv[1], "not found");
+    if (fs_is_dir(handle)) {
+        fs_close(handle);
+        return fail(out, "cp", argv[1], "is a directory");
+    }
+
+    // Emptying the destination first would lose the source, whatever
+    // path names it
+    int existing = fs_open(argv[2]);
+    int same = existing >= 0 && fs_inode(existing) == fs_inode(handle);
+    fs_close(existing);
+    if (same) {
+        fs_close(handle);
+        return fail(out, "cp", argv[2], "same file");
+    }
+    int dest = open_empty(argv[2]);
+    if (dest < 0) {
+        fs_close(handle);
+        return fail(out, "cp", argv[2], "cannot write");
+    }
+
+    // Block by block from one cached sector to the other
+    const char* data;
+    uint32_t offset = 0;
+    int got = 0;
+    int result = 0;
+    while (result == 0 && (got = fs_borrow(handle, offset, &data)) > 0) {
+        result = write_extents(dest, &offset, data, got);
+        fs_release(data);
+    }
+    fs_close(dest);
+    fs_close(handle);
+    if (got < 0) return fail(out, "cp", argv[1], "cannot read");
+    if (result < 0) return fail(out, "cp", argv[2], "cannot write");
+    return 0;
+}
+
+static int cmd_stat(ShellOutput* out, int argc, char** argv) {
+    if (argc < 2) return fail(out, "usage", 0, "stat <path>...");
+
+    int result = 0;
+    for (int i = 1; i < argc; i++) {
+        int handle = fs_open(argv[i]);
+        if (handle < 0) {
+            result = fail(out, "stat", argv[i], "not found");
+            continue;
+        }
+
+        char line[80] = "";
+        shell_append(line, argv[i], 80);
+        if (fs_is_dir(handle)) {
+            shell_append(line, ": directory", 80);
+        } else {
+            uint32_t size = fs_size(handle);
+            shell_append(line, ": file, ", 80);
+            shell_append_number(line, size, 80);
+            shell_append(line, " bytes, ", 80);
+            shell_append_number(line, (size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE, 80);
+            shell_append(line, " blocks", 80);
+        }
+        shell_print(out, line);
+        fs_close(handle);
+    }
+    return result;
+}
+
+static int cmd_df(ShellOutput* out, int argc, char** argv) {
+    (void)argc;
+    (void)argv;
+    FsStats stats;
+    fs_get_stats(&stats);
+    if (stats.total_blocks == 0) return fail(out, "df", 0, "no file system");
+
+    char line[80] = "disk: ";
+    shell_append_number(line, (stats.total_blocks - stats.free_blocks) * FS_BLOCK_SIZE / 1024, 80);
+    shell_append(line, " KB used, ", 80);
+    shell_append_number(line, stats.free_blocks * FS_BLOCK_SIZE / 1024, 80);
+    shell_append(line, " KB free of ", 80);
+    shell_append_number(line, stats.total_blocks * FS_BLOCK_SIZE / 1024, 80);
+    shell_append(line, " KB", 80);
+    shell_print(out, line);
+
+    line[0] = '\0';
+    shell_append(line, "inodes: ", 80);
+    shell_append_number(line, stats.inode_count - stats.free_inodes, 80);
+    shell_append(line, " used, ", 80);
+    shell_append_number(line, stats.free_inodes, 80);
+    shell_append(line, " free", 80);
+    shell_print(out, line);
+    return 0;
+}
+
+static ShellCommand file_commands[] = {
+    { "cat",   "Print files", cmd_cat, 0, 0 },
+    { "write", "Write text to a file", cmd_write, 0, 0 },
+    { "rm",    "Remove files", cmd_rm, 0, 0 },
+    { "cp",    "Copy a file", cmd_cp, 0, 0 },
+    { "stat",  "File type and size", cmd_stat, 0, 0 },
+    { "df",    "Disk space", cmd_df, 0, 0 },
+};
+
+void shell_init(void) {
+    for (uint32_t i = 0; i < sizeof(file_commands) / sizeof(file_commands[0]); i++) {
+        shell_register(&file_commands[i]);
+    }
+}
@@ -0,0 +1,350 @@
+// string.c - Freestanding string and memory functions
+//
+// Bulk moves and fills use rep movsb / rep stosb on CPUs with enhanced
+// rep strings (ERMS), which run them at cache bandwidth from any
+// alignment. Elsewhere they align the destination and use rep movsd /
+// rep stosd. The string functions scan a word at a time. Short runs and
+// unaligned edges go byte by byte.
+//
+// Host builds with SSE2 (the tools, "make strbench STRBENCH_FLAGS=") also
+// move 16 bytes per instruction. The kernel never does: it does not
+// enable SSE (CR4.OSFXSR), its threads only save x87 state, and memcpy
+// runs in IRQs, where the FPU may belong to another thread.
+//
+// Built with -fno-tree-loop-distribute-patterns (see the Makefile) so gcc
+// does not turn the byte loops here back into calls to memcpy or memset.
+// The same file is built into the host tools, where it stands in for the
+// C library's versions.
+#include "include/string.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#define STRING_X86 1
+#endif
+
+// Freestanding means the kernel, even if built with -msse2
+#if defined(__SSE2__) && __STDC_HOSTED__
+#define STRING_SSE2 1
+#endif
+
+// Below these, setting up a rep instruction costs more than it saves
+#define SHORT_MIN 16
+#define REP_MIN 256
+#define SSE_MIN 128
+
+#define ONES 0x01010101u
+#define HIGHS 0x80808080u
+
+// Words read from and written to byte arrays
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+// Nonzero if any byte of word is zero
+static inline uint32_t has_zero(uint32_t word) {
+    return (word - ONES) & ~word & HIGHS;
+}
+
+#ifdef STRING_X86
+// 0 until checked, then 1 with ERMS (CPUID leaf 7, EBX bit 9), 2 without
+static int erms_state;
+
+static int have_erms(void) {
+    if (erms_state == 0) {
+        uint32_t max, features = 0, ecx, edx;
+        __asm__ volatile ("cpuid" : "=a"(max), "=b"(features), "=c"(ecx), "=d"(edx) : "a"(0), "c"(0));
+        features = 0;
+        if (max >= 7) {
+            __asm__ volatile ("cpuid" : "=a"(max), "=b"(features), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+        }
+        erms_state = (features & (1u << 9)) ? 1 : 2;
+    }
+    return erms_state == 1;
+}
+#endif
+
+// Copy n bytes forward, the destination already 4-byte aligned
+static void copy_words(uint8_t* d, const uint8_t* s, size_t n) {
+#ifdef STRING_SSE2
+    if (n >= SSE_MIN) {
+        while ((uintptr_t)d & 15) {
+            *(word_t*)d = *(const word_t*)s;
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+        for (; n >= 16; n -= 16, d += 16, s += 16) {
+            __asm__ volatile ("movdqu (%1), %%xmm0\n\t"
+                              "movdqa %%xmm0, (%0)"
+                              : : "r"(d), "r"(s) : "xmm0", "memory");
+        }
+    }
+#endif
+#ifdef STRING_X86
+    if (n >= REP_MIN) {
+        size_t words = n / 4;
+        __asm__ volatile ("rep movsl"
+                          : "+D"(d), "+S"(s), "+c"(words) : : "memory");
+        n &= 3;
+    }
+#endif
+    for (; n >= 4; n -= 4, d += 4, s += 4) {
+        *(word_t*)d = *(const word_t*)s;
+    }
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (n >= SHORT_MIN) {
+#ifdef STRING_X86
+        if (have_erms()) {
+            __asm__ volatile ("rep movsb"
+                              : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+            return dest;
+        }
+#endif
+        while ((uintptr_t)d & 3) {
+            *d++ = *s++;
+            n--;
+        }
+        copy_words(d, s, n);
+        return dest;
+    }
+    while (n--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (d + n <= s || d >= s + n) {
+        return memcpy(dest, src, n);
+    }
+
+    // Overlapping: forwards if the destination is below the source. Rep
+    // strings lose their fast path on nearby overlapping regions.
+    if (d < s) {
+        while (n && ((uintptr_t)d & 3)) {
+            *d++ = *s++;
+            n--;
+        }
+        for (; n >= 4; n -= 4, d += 4, s += 4) {
+            *(word_t*)d = *(const word_t*)s;
+        }
+        while (n--) {
+            *d++ = *s++;
+        }
+        return dest;
+    }
+
+    // Backwards, a word at a time once the destination end is aligned
+    d += n;
+    s += n;
+    while (n && ((uintptr_t)d & 3)) {
+        *--d = *--s;
+        n--;
+    }
+    for (; n >= 4; n -= 4) {
+        d -= 4;
+        s -= 4;
+        *(word_t*)d = *(const word_t*)s;
+    }
+    while (n--) {
+        *--d = *--s;
+    }
+    return dest;
+}
+
+void* memset(void* s, int c, size_t n) {
+    uint8_t* d = (uint8_t*)s;
+    uint32_t fill = (uint8_t)c * ONES;
+
+    if (n >= SHORT_MIN) {
+#ifdef STRING_X86
+        if (have_erms()) {
+            __asm__ volatile ("rep stosb"
+                              : "+D"(d), "+c"(n) : "a"(c) : "memory");
+            return s;
+        }
+#endif
+        while ((uintptr_t)d & 3) {
+            *d++ = (uint8_t)c;
+            n--;
+        }
+#ifdef STRING_SSE2
+        if (n >= SSE_MIN) {
+            while ((uintptr_t)d & 15) {
+                *(word_t*)d = fill;
+                d += 4;
+                n -= 4;
+            }
+            size_t blocks = n / 16;
+            __asm__ volatile ("movd %2, %%xmm0\n\t"
+                              "pshufd $0, %%xmm0, %%xmm0\n"
+                              "1:\n\t"
+                              "movdqa %%xmm0, (%0)\n\t"
+                              "add $16, %0\n\t"
+                              "dec %1\n\t"
+                              "jnz 1b"
+                              : "+r"(d), "+r"(blocks) : "r"(fill) : "xmm0", "memory");
+            n &= 15;
+        }
+#endif
+#ifdef STRING_X86
+        if (n >= REP_MIN) {
+            size_t words = n / 4;
+            __asm__ volatile ("rep stosl"
+                              : "+D"(d), "+c"(words) : "a"(fill) : "memory");
+            n &= 3;
+        }
+#endif
+        for (; n >= 4; n -= 4, d += 4) {
+            *(word_t*)d = fill;
+        }
+    }
+    while (n--) {
+        *d++ = (uint8_t)c;
+    }
+    return s;
+}
+
+int memcmp(const void* s1, const void* s2, size_t n) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+
+    // Skip equal words, then find the differing byte
+    if ((((uintptr_t)a ^ (uintptr_t)b) & 3) == 0) {
+        while (n && ((uintptr_t)a & 3) && *a == *b) {
+            a++;
+            b++;
+            n--;
+        }
+        if (((uintptr_t)a & 3) == 0) {
+            while (n >= 4 && *(const word_t*)a == *(const word_t*)b) {
+                a += 4;
+                b += 4;
+                n -= 4;
+            }
+        }
+    }
+    for (; n; n--, a++, b++) {
+        if (*a != *b) return *a - *b;
+    }
+    return 0;
+}
+
+size_t strlen(const char* s) {
+    const char* p = s;
+
+    while ((uintptr_t)p & 3) {
+        if (*p == '\0') return p - s;
+        p++;
+    }
+    // Aligned words never cross a page, so reading past the end is safe
+    const word_t* w = (const word_t*)p;
+    while (!has_zero(*w)) {
+        w++;
+    }
+    p = (const char*)w;
+    while (*p) {
+        p++;
+    }
+    return p - s;
+}
+
+char* strcpy(char* dest, const char* src) {
+    memcpy(dest, src, strlen(src) + 1);
+    return dest;
+}
+
+size_t strlcpy(char* dest, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dest, src, n);
+        dest[n] = '\0';
+    }
+    return len;
+}
+
+char* strcat(char* dest, const char* src) {
+    strcpy(dest + strlen(dest), src);
+    return dest;
+}
+
+int strcmp(const char* s1, const char* s2) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+
+    // Whole words while they match and hold no terminator
+    if ((((uintptr_t)a ^ (uintptr_t)b) & 3) == 0) {
+        while ((uintptr_t)a & 3) {
+            if (*a != *b || *a == '\0') return *a - *b;
+            a++;
+            b++;
+        }
+        while (*(const word_t*)a == *(const word_t*)b && !has_zero(*(const word_t*)a)) {
+            a += 4;
+            b += 4;
+        }
+    }
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a - *b;
+}
+
+int strncmp(const char* s1, const char* s2, size_t n) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+
+    for (; n; n--, a++, b++) {
+        if (*a != *b || *a == '\0') return *a - *b;
+    }
+    return 0;
+}
+
+// "00" to "99": two digits per division
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint32_t powers_of_ten[9] = {
+    10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+int fmt_uint(char* out, uint32_t value) {
+    int len = 1;
+    while (len < 10 && value >= powers_of_ten[len - 1]) {
+        len++;
+    }
+
+    char* p = out + len;
+    *p = '\0';
+    while (value >= 100) {
+        const char* pair = &digit_pairs[(value % 100) * 2];
+        value /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (value >= 10) {
+        *--p = digit_pairs[value * 2 + 1];
+        *--p = digit_pairs[value * 2];
+    } else {
+        *--p = '0' + value;
+    }
+    return len;
+}
+
+int fmt_int(char* out, int32_t value) {
+    if (value >= 0) return fmt_uint(out, value);
+    *out = '-';
+    return fmt_uint(out + 1, 0u - (uint32_t)value) + 1;
+}
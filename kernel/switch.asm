@@ -0,0 +1,25 @@
+; switch.asm - Kernel thread context switch
+[bits 32]
+
+global switch_context
+
+section .text
+
+; void switch_context(uint32_t* old_esp, uint32_t new_esp)
+; Pushes the callee-saved registers, stores the stack pointer through
+; old_esp and continues the thread whose stack pointer is new_esp. The
+; caller-saved registers are already on the stack, by C convention.
+switch_context:
+    mov eax, [esp + 4]
+    mov edx, [esp + 8]
+    push ebp
+    push ebx
+    push esi
+    push edi
+    mov [eax], esp
+    mov esp, edx
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret
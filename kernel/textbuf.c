@@ -0,0 +1,241 @@
+// textbuf.c - Gap buffer text storage with a line index
+#include "include/textbuf.h"
+#include "include/heap.h"
+#include "include/string.h"
+
+#define TEXT_INITIAL_SIZE 256
+#define NEWLINE_INITIAL_SIZE 16
+
+static uint32_t gap_length(const TextBuffer* tb) {
+    return tb->gap_end - tb->gap_start;
+}
+
+static uint32_t physical(const TextBuffer* tb, uint32_t pos) {
+    return pos < tb->gap_start ? pos : pos + gap_length(tb);
+}
+
+// Logical offset of the i-th newline
+static uint32_t newline_at(const TextBuffer* tb, uint32_t i) {
+    if (i >= tb->line_gap_start) {
+        return tb->newlines[i + tb->line_gap_end - tb->line_gap_start] - gap_length(tb);
+    }
+    return tb->newlines[i];
+}
+
+static uint32_t newline_count(const TextBuffer* tb) {
+    return tb->newline_size - (tb->line_gap_end - tb->line_gap_start);
+}
+
+int text_init(TextBuffer* tb) {
+    tb->text = (char*)kmalloc(TEXT_INITIAL_SIZE);
+    tb->newlines = (uint32_t*)kmalloc(NEWLINE_INITIAL_SIZE * sizeof(uint32_t));
+    if (tb->text == 0 || tb->newlines == 0) {
+        kfree(tb->text);
+        kfree(tb->newlines);
+        tb->text = 0;
+        tb->newlines = 0;
+        return -1;
+    }
+
+    tb->size = TEXT_INITIAL_SIZE;
+    tb->gap_start = 0;
+    tb->gap_end = TEXT_INITIAL_SIZE;
+    tb->newline_size = NEWLINE_INITIAL_SIZE;
+    tb->line_gap_start = 0;
+    tb->line_gap_end = NEWLINE_INITIAL_SIZE;
+    return 0;
+}
+
+void text_free(TextBuffer* tb) {
+    kfree(tb->text);
+    kfree(tb->newlines);
+    tb->text = 0;
+    tb->newlines = 0;
+}
+
+// Move the gap so it starts at logical offset pos. Newlines that cross
+// the gap move across the line gap too, with their offsets adjusted.
+static void move_gap(TextBuffer* tb, uint32_t pos) {
+    uint32_t gap = gap_length(tb);
+
+    if (pos < tb->gap_start) {
+        uint32_t n = tb->gap_start - pos;
+        while (tb->line_gap_start > 0 && tb->newlines[tb->line_gap_start - 1] >= pos) {
+            tb->newlines[--tb->line_gap_end] = tb->newlines[--tb->line_gap_start] + gap;
+        }
+        memmove(tb->text + tb->gap_end - n, tb->text + pos, n);
+        tb->gap_start = pos;
+        tb->gap_end -= n;
+    } else if (pos > tb->gap_start) {
+        uint32_t n = pos - tb->gap_start;
+        while (tb->line_gap_end < tb->newline_size && tb->newlines[tb->line_gap_end] < tb->gap_end + n) {
+            tb->newlines[tb->line_gap_start++] = tb->newlines[tb->line_gap_end++] - gap;
+        }
+        memmove(tb->text + tb->gap_start, tb->text + tb->gap_end, n);
+        tb->gap_start = pos;
+        tb->gap_end += n;
+    }
+}
+
+// Double the text block (at least), keeping the gap where it is
+static int grow_text(TextBuffer* tb, uint32_t needed) {
+    uint32_t size = tb->size * 2;
+    while (size - tb->size + gap_length(tb) < needed) size *= 2;
+
+    char* text = (char*)kmalloc(size);
+    if (text == 0) return -1;
+
+    uint32_t tail = tb->size - tb->gap_end;
+    uint32_t delta = size - tb->size;
+    memcpy(text, tb->text, tb->gap_start);
+    memcpy(text + size - tail, tb->text + tb->gap_end, tail);
+    for (uint32_t i = tb->line_gap_end; i < tb->newline_size; i++) {
+        tb->newlines[i] += delta;
+    }
+
+    kfree(tb->text);
+    tb->text = text;
+    tb->gap_end += delta;
+    tb->size = size;
+    return 0;
+}
+
+static int grow_newlines(TextBuffer* tb) {
+    uint32_t size = tb->newline_size * 2;
+    uint32_t* lines = (uint32_t*)kmalloc(size * sizeof(uint32_t));
+    if (lines == 0) return -1;
+
+    uint32_t tail = tb->newline_size - tb->line_gap_end;
+    memcpy(lines, tb->newlines, tb->line_gap_start * sizeof(uint32_t));
+    memcpy(lines + size - tail, tb->newlines + tb->line_gap_end, tail * sizeof(uint32_t));
+
+    kfree(tb->newlines);
+    tb->newlines = lines;
+    tb->line_gap_end = size - tail;
+    tb->newline_size = size;
+    return 0;
+}
+
+int text_insert(TextBuffer* tb, uint32_t pos, char c) {
+    if (pos > text_length(tb)) return -1;
+    if (gap_length(tb) == 0 && grow_text(tb, 1) < 0) return -1;
+    if (c == '\n' && tb->line_gap_start == tb->line_gap_end && grow_newlines(tb) < 0) return -1;
+
+    move_gap(tb, pos);
+    if (c == '\n') {
+        tb->newlines[tb->line_gap_start++] = tb->gap_start;
+    }
+    tb->text[tb->gap_start++] = c;
+    return 0;
+}
+
+// Done at the end of the gap so that backspacing at the edit point
+// leaves the gap in place
+void text_delete(TextBuffer* tb, uint32_t pos) {
+    if (pos >= text_length(tb)) return;
+
+    move_gap(tb, pos + 1);
+    tb->gap_start--;
+    if (tb->text[tb->gap_start] == '\n') {
+        tb->line_gap_start--;
+    }
+}
+
+int text_set(TextBuffer* tb, const char* data, uint32_t len) {
+    tb->gap_start = 0;
+    tb->gap_end = tb->size;
+    tb->line_gap_start = 0;
+    tb->line_gap_end = tb->newline_size;
+    return text_append(tb, data, len);
+}
+
+int text_reserve(TextBuffer* tb, uint32_t len) {
+    if (gap_length(tb) < len) return grow_text(tb, len);
+    return 0;
+}
+
+int text_append(TextBuffer* tb, const char* data, uint32_t len) {
+    uint32_t lines = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        if (data[i] == '\n') lines++;
+    }
+
+    // Make room for everything at once, at the end
+    move_gap(tb, text_length(tb));
+    if (text_reserve(tb, len) < 0) return -1;
+    while (lines > tb->line_gap_end - tb->line_gap_start) {
+        if (grow_newlines(tb) < 0) return -1;
+    }
+
+    // With the gap at the end, physical offsets before it are logical ones
+    memcpy(tb->text + tb->gap_start, data, len);
+    for (uint32_t i = 0; i < len; i++) {
+        if (data[i] == '\n') tb->newlines[tb->line_gap_start++] = tb->gap_start + i;
+    }
+    tb->gap_start += len;
+    return 0;
+}
+
+uint32_t text_length(const TextBuffer* tb) {
+    return tb->size - gap_length(tb);
+}
+
+char text_char_at(const TextBuffer* tb, uint32_t pos) {
+    if (pos >= text_length(tb)) return '\0';
+    return tb->text[physical(tb, pos)];
+}
+
+uint32_t text_line_count(const TextBuffer* tb) {
+    return newline_count(tb) + 1;
+}
+
+uint32_t text_line_start(const TextBuffer* tb, uint32_t line) {
+    if (line == 0) return 0;
+    if (line > newline_count(tb)) return text_length(tb);
+    return newline_at(tb, line - 1) + 1;
+}
+
+uint32_t text_line_length(const TextBuffer* tb, uint32_t line) {
+    uint32_t start = text_line_start(tb, line);
+    uint32_t end = line < newline_count(tb) ? newline_at(tb, line) : text_length(tb);
+    return end - start;
+}
+
+// Binary search for the number of newlines before pos
+uint32_t text_line_of(const TextBuffer* tb, uint32_t pos) {
+    uint32_t lo = 0;
+    uint32_t hi = newline_count(tb);
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (newline_at(tb, mid) < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+uint32_t text_copy(const TextBuffer* tb, uint32_t pos, char* out, uint32_t len) {
+    uint32_t length = text_length(tb);
+    if (pos >= length) return 0;
+    if (len > length - pos) len = length - pos;
+
+    // Up to two pieces, either side of the gap
+    uint32_t copied = 0;
+    if (pos < tb->gap_start) {
+        uint32_t n = tb->gap_start - pos;
+        if (n > len) n = len;
+        memcpy(out, tb->text + pos, n);
+        copied = n;
+    }
+    if (copied < len) {
+        memcpy(out + copied, tb->text + physical(tb, pos + copied), len - copied);
+    }
+    return len;
+}
+
+const char* text_contiguous(TextBuffer* tb) {
+    move_gap(tb, text_length(tb));
+    return tb->text;
+}
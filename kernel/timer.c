@@ -0,0 +1,134 @@
+// timer.c - PIT (IRQ0) driver and HLT-based sleeping
+#include "include/timer.h"
+#include "include/idt.h"
+#include "include/io.h"
+#include "include/sched.h"
+#include "include/event.h"
+#include "include/keyboard.h"
+
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND  0x43
+#define PIT_BASE_HZ  1193182
+#define PIT_IRQ      0
+
+static volatile uint64_t ticks = 0;
+static volatile int pending_event = 0;
+static uint32_t frequency = 0;
+static uint64_t tsc_at_init = 0;
+static uint32_t second_countdown = 0;   // Ticks until the next EVENT_TIMER
+static uint32_t seconds = 0;
+
+static void timer_irq(registers_t* regs) {
+    (void)regs;
+    ticks++;
+    if (--second_countdown == 0) {
+        second_countdown = frequency;
+        event_post(EVENT_TIMER, 0, 0, ++seconds);
+    }
+    keyboard_tick();
+    sched_tick();
+}
+
+void timer_init(uint32_t hz) {
+    if (hz < 19) hz = 19;            // Divisor must fit in 16 bits
+    if (hz > PIT_BASE_HZ) hz = PIT_BASE_HZ;
+
+    uint32_t divisor = PIT_BASE_HZ / hz;
+    frequency = PIT_BASE_HZ / divisor;
+    ticks = 0;
+    tsc_at_init = rdtsc();
+    second_countdown = frequency;
+    seconds = 0;
+
+    // Channel 0, lobyte/hibyte, mode 2 (rate generator)
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+
+    irq_install_handler(PIT_IRQ, timer_irq);
+}
+
+uint32_t timer_frequency(void) {
+    return frequency;
+}
+
+uint64_t timer_ticks(void) {
+    // 64-bit reads are two loads; retry if IRQ0 fired in between
+    uint64_t a, b;
+    do {
+        a = ticks;
+        b = ticks;
+    } while (a != b);
+    return a;
+}
+
+// Conversions stay in 32-bit arithmetic: there is no libgcc to provide
+// 64-bit division in this kernel.
+uint32_t uptime_ms(void) {
+    if (frequency == 0) return 0;
+    uint32_t t = (uint32_t)timer_ticks();
+    return (t / frequency) * 1000 + (t % frequency) * 1000 / frequency;
+}
+
+// Cycles per ms measured so far, with cycles scaled down alongside
+static uint32_t cycles_per_ms(uint64_t* cycles) {
+    uint32_t elapsed_ms = uptime_ms();
+    if (elapsed_ms == 0) return 0;
+
+    // Drop low bits until both counts fit 32-bit division
+    uint64_t elapsed = rdtsc() - tsc_at_init;
+    while ((elapsed >> 32) != 0 || (*cycles >> 32) != 0) {
+        elapsed >>= 1;
+        *cycles >>= 1;
+    }
+    return (uint32_t)elapsed / elapsed_ms;
+}
+
+uint32_t tsc_to_ms(uint64_t cycles) {
+    uint32_t per_ms = cycles_per_ms(&cycles);
+    if (per_ms == 0) return 0;
+    return (uint32_t)cycles / per_ms;
+}
+
+uint32_t tsc_to_us(uint64_t cycles) {
+    uint32_t per_us = cycles_per_ms(&cycles) / 1000;
+    if (per_us == 0) return 0;
+    return (uint32_t)cycles / per_us;
+}
+
+static uint32_t ms_to_ticks(uint32_t ms) {
+    // Round up so short sleeps last at least one tick
+    return (ms / 1000) * frequency + ((ms % 1000) * frequency + 999) / 1000;
+}
+
+void sleep_ms(uint32_t ms) {
+    uint64_t deadline = timer_ticks() + ms_to_ticks(ms);
+    while (timer_ticks() < deadline) {
+        __asm__ volatile ("hlt");
+    }
+}
+
+void event_signal(void) {
+    pending_event = 1;
+}
+
+int wait_for_event(uint32_t timeout_ms) {
+    uint64_t deadline = timer_ticks() + ms_to_ticks(timeout_ms);
+
+    while (1) {
+        // Check and halt with interrupts off, then "sti; hlt": STI takes
+        // effect after the next instruction, so a wakeup IRQ cannot slip in
+        // between the check and the HLT.
+        disable_interrupts();
+        if (pending_event) {
+            pending_event = 0;
+            enable_interrupts();
+            return 1;
+        }
+        if (timeout_ms != 0 && ticks >= deadline) {
+            enable_interrupts();
+            return 0;
+        }
+        __asm__ volatile ("sti; hlt");
+    }
+}
@@ -0,0 +1,131 @@
+// vga.c - Shadow text buffer and diffed flush to VGA memory
+//
+// Menu, windows and desktop all draw into back_buffer. vga_present()
+// compares the rows touched since the last present against front_buffer
+// (a RAM copy of what VGA memory holds) two cells at a time and copies
+// only the differing runs with 32-bit string moves. Nothing reads VGA
+// memory, and a frame reaches the screen in one pass instead of being
+// painted back to front where the user can see it.
+//
+// Built with VIN_FB the same cells are rendered into the mode 13h
+// framebuffer instead (see fb.c), so nothing above this layer changes.
+#include "include/vga.h"
+#ifdef VIN_FB
+#include "include/fb.h"
+#endif
+
+volatile uint16_t* vga_buffer = (uint16_t*)0xB8000;
+
+#define VGA_CELLS (VGA_WIDTH * VGA_HEIGHT)
+#define ROW_PAIRS (VGA_WIDTH / 2)
+
+// Two cells compared/copied as one 32-bit word
+typedef uint32_t __attribute__((may_alias)) cell_pair_t;
+
+static uint16_t back_buffer[VGA_CELLS] __attribute__((aligned(4)));
+static uint16_t front_buffer[VGA_CELLS] __attribute__((aligned(4)));
+static uint8_t row_dirty[VGA_HEIGHT];
+static int front_valid = 0;
+
+static VgaStats stats;
+
+static uint16_t make_vga_entry(char c, uint8_t color) {
+    return (uint16_t)(uint8_t)c | ((uint16_t)color << 8);
+}
+
+#ifndef VIN_FB
+static void copy_dwords(volatile void* dest, const void* src, uint32_t count) {
+    __asm__ volatile ("rep movsl"
+                      : "+D"(dest), "+S"(src), "+c"(count)
+                      :
+                      : "memory");
+}
+#endif
+
+void vga_init(uint8_t color) {
+    stats.presents = 0;
+    stats.last_cells = 0;
+    stats.total_cells = 0;
+    stats.runs = 0;
+
+#ifdef VIN_FB
+    fb_init();
+#endif
+
+    // Contents of VGA memory are unknown until the first full present
+    front_valid = 0;
+    vga_fill(0, 0, VGA_WIDTH, VGA_HEIGHT, ' ', color);
+}
+
+void vga_putchar(char c, uint8_t color, uint8_t x, uint8_t y) {
+    if (x >= VGA_WIDTH || y >= VGA_HEIGHT) return;
+    back_buffer[y * VGA_WIDTH + x] = make_vga_entry(c, color);
+    row_dirty[y] = 1;
+}
+
+void vga_fill(uint8_t x, uint8_t y, uint8_t width, uint8_t height, char c, uint8_t color) {
+    uint16_t entry = make_vga_entry(c, color);
+    for (int row = y; row < y + height && row < VGA_HEIGHT; row++) {
+        for (int col = x; col < x + width && col < VGA_WIDTH; col++) {
+            back_buffer[row * VGA_WIDTH + col] = entry;
+        }
+        row_dirty[row] = 1;
+    }
+}
+
+void vga_present(void) {
+    uint32_t cells = 0;
+
+    for (int row = 0; row < VGA_HEIGHT; row++) {
+        if (!row_dirty[row] && front_valid) continue;
+        row_dirty[row] = 0;
+
+        cell_pair_t* back = (cell_pair_t*)&back_buffer[row * VGA_WIDTH];
+        cell_pair_t* front = (cell_pair_t*)&front_buffer[row * VGA_WIDTH];
+
+        int i = 0;
+        while (i < ROW_PAIRS) {
+            if (front_valid && back[i] == front[i]) {
+                i++;
+                continue;
+            }
+
+            int start = i;
+            while (i < ROW_PAIRS && (!front_valid || back[i] != front[i])) {
+                front[i] = back[i];
+                i++;
+            }
+
+#ifdef VIN_FB
+            for (int col = start * 2; col < i * 2; col++) {
+                fb_draw_text_cell(col, row, back_buffer[row * VGA_WIDTH + col]);
+            }
+#else
+            volatile cell_pair_t* screen = (volatile cell_pair_t*)&vga_buffer[row * VGA_WIDTH];
+            copy_dwords(screen + start, back + start, i - start);
+#endif
+            cells += (i - start) * 2;
+            stats.runs++;
+        }
+    }
+
+    front_valid = 1;
+
+#ifdef VIN_FB
+    fb_present();
+#endif
+
+    if (cells > 0) {
+        stats.presents++;
+        stats.last_cells = cells;
+        stats.total_cells += cells;
+    }
+}
+
+void vga_invalidate(void) {
+    front_valid = 0;
+}
+
+void vga_get_stats(VgaStats* out) {
+    *out = stats;
+}
@@ -1,84 +1,295 @@
 // window.c - Window management implementation
+//
+// Drawing is damage driven: every change to a window (creation, move,
+// focus, title, text rows) records the screen cells it affects, and
+// draw_all_windows() repaints only those cells. Rows 1..24 are owned by
+// the compositor; row 0 belongs to the menu bar.
+//
+// Windows are kept in a z-order list (bottom to top). From it we build an
+// ownership map holding, for every cell, the topmost window covering it.
+// That map is each window's visible region: damage to a window is clipped
+// to the cells it owns and every damaged cell is painted exactly once, by
+// its owner, so occluded cells are never drawn.
+//
+// Window objects come from a slab cache and are indexed by id through a
+// table that doubles when it fills, so there is no fixed window limit.
+//
+// Window text is a set of rows that apps update one at a time: a row
+// damages only the columns that differ from what it shows, and scrolling
+// rotates the row-to-slot map so no row text is copied.
 #include "include/window.h"
 #include "include/vga.h"
+#include "include/heap.h"
+#include "include/sched.h"
+#include "include/string.h"
 
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 #define VGA_COLOR(fg, bg) ((bg << 4) | fg)
 
-extern volatile uint16_t* vga_buffer;
+#define DESKTOP_TOP 1
+#define DESKTOP_COLOR VGA_COLOR(7, 1)
 
-
-
-static Window windows[MAX_WINDOWS];
+static KmemCache window_cache;
+static Window** windows = 0;    // By id, 0 for a free id
+static int window_capacity = 0;
 static int window_count = 0;
 static int focused_window = -1;
 
+// Stacking order, z_order[0] is the bottom window
+static int* z_order = 0;
+static int z_count = 0;
+
+// Topmost window id per screen cell, -1 for desktop
+static int16_t owner[VGA_HEIGHT * VGA_WIDTH];
+
+// Desktop layer under all windows
+static uint16_t desktop[VGA_HEIGHT * VGA_WIDTH];
+
+// Damaged span per screen row: [damage_x0, damage_x1), empty when x0 >= x1
+static uint8_t damage_x0[VGA_HEIGHT];
+static uint8_t damage_x1[VGA_HEIGHT];
+
+static CompositorStats stats;
+static uint32_t frame_cells = 0;
+
+static Mutex wm_mutex;
+
+void wm_lock(void) {
+    mutex_lock(&wm_mutex);
+}
+
+void wm_unlock(void) {
+    mutex_unlock(&wm_mutex);
+}
+
 static uint16_t make_vga_entry(char c, uint8_t color) {
-    return (uint16_t)c | ((uint16_t)color << 8);
+    return (uint16_t)(uint8_t)c | ((uint16_t)color << 8);
 }
 
 static void putchar_at(char c, uint8_t color, uint8_t x, uint8_t y) {
-    if (x >= VGA_WIDTH || y >= VGA_HEIGHT) return;
-    vga_buffer[y * VGA_WIDTH + x] = make_vga_entry(c, color);
+    vga_putchar(c, color, x, y);
+    frame_cells++;
+}
+
+void wm_damage(int x, int y, int width, int height) {
+    int x_end = x + width;
+    int y_end = y + height;
+    if (x < 0) x = 0;
+    if (y < DESKTOP_TOP) y = DESKTOP_TOP;
+    if (x_end > VGA_WIDTH) x_end = VGA_WIDTH;
+    if (y_end > VGA_HEIGHT) y_end = VGA_HEIGHT;
+    if (x >= x_end) return;
+
+    for (int row = y; row < y_end; row++) {
+        if (damage_x0[row] >= damage_x1[row]) {
+            damage_x0[row] = x;
+            damage_x1[row] = x_end;
+        } else {
+            if (x < damage_x0[row]) damage_x0[row] = x;
+            if (x_end > damage_x1[row]) damage_x1[row] = x_end;
+        }
+    }
+}
+
+static void damage_whole_window(Window* win) {
+    wm_damage(win->x, win->y, win->width, win->height);
 }
 
-static void puts_at(const char* str, uint8_t color, uint8_t x, uint8_t y) {
-    for (uint8_t i = 0; str[i] != '\0' && x + i < VGA_WIDTH; i++) {
-        putchar_at(str[i], color, x + i, y);
+// Damage the cells of row y, columns [x, x + width), that the window owns
+static void damage_visible_span(int window_id, int x, int y, int width) {
+    int x_end = x + width;
+    if (y < DESKTOP_TOP || y >= VGA_HEIGHT) return;
+    if (x < 0) x = 0;
+    if (x_end > VGA_WIDTH) x_end = VGA_WIDTH;
+
+    const int16_t* row = &owner[y * VGA_WIDTH];
+    int first = -1;
+    int last = -1;
+    for (int col = x; col < x_end; col++) {
+        if (row[col] == window_id) {
+            if (first < 0) first = col;
+            last = col;
+        }
+    }
+    if (first >= 0) {
+        wm_damage(first, y, last - first + 1, 1);
     }
 }
 
-static void draw_box(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t color) {
-    // Top border
-    putchar_at('+', color, x, y);
-    for (uint8_t i = 1; i < width - 1; i++) {
-        putchar_at('-', color, x + i, y);
+static void damage_visible_window(int window_id) {
+    Window* win = windows[window_id];
+    for (int r = 0; r < win->height; r++) {
+        damage_visible_span(window_id, win->x, win->y + r, win->width);
     }
-    putchar_at('+', color, x + width - 1, y);
-    
-    // Sides
-    for (uint8_t i = 1; i < height - 1; i++) {
-        putchar_at('|', color, x, y + i);
-        putchar_at('|', color, x + width - 1, y + i);
-        // Fill interior
-        for (uint8_t j = 1; j < width - 1; j++) {
-            putchar_at(' ', color, x + j, y + i);
+}
+
+// Damage columns [from, to) of a content line, clipped to the interior
+static void damage_text_span(int window_id, int line, int from, int to) {
+    Window* win = windows[window_id];
+    int interior = win->width - 2;
+    if (to > interior) to = interior;
+    if (from >= to) return;
+    damage_visible_span(window_id, win->x + 1 + from, win->y + 1 + line, to - from);
+}
+
+static void z_remove(int window_id) {
+    int j = 0;
+    for (int i = 0; i < z_count; i++) {
+        if (z_order[i] != window_id) {
+            z_order[j++] = z_order[i];
         }
     }
-    
-    // Bottom border
-    putchar_at('+', color, x, y + height - 1);
-    for (uint8_t i = 1; i < width - 1; i++) {
-        putchar_at('-', color, x + i, y + height - 1);
+    z_count = j;
+}
+
+static void z_push_top(int window_id) {
+    z_order[z_count++] = window_id;
+}
+
+static void z_push_bottom(int window_id) {
+    for (int i = z_count; i > 0; i--) {
+        z_order[i] = z_order[i - 1];
     }
-    putchar_at('+', color, x + width - 1, y + height - 1);
+    z_order[0] = window_id;
+    z_count++;
 }
 
-static void str_copy(char* dest, const char* src, int max_len) {
-    int i = 0;
-    while (src[i] != '\0' && i < max_len - 1) {
-        dest[i] = src[i];
-        i++;
+// Recompute visible regions after any stacking or geometry change.
+// Top-down, so each cell is claimed once by the highest window over it.
+static void rebuild_owner_map(void) {
+    for (int i = 0; i < VGA_HEIGHT * VGA_WIDTH; i++) {
+        owner[i] = -1;
+    }
+
+    for (int z = z_count - 1; z >= 0; z--) {
+        int id = z_order[z];
+        Window* win = windows[id];
+        for (int y = win->y; y < win->y + win->height && y < VGA_HEIGHT; y++) {
+            int16_t* row = &owner[y * VGA_WIDTH];
+            for (int x = win->x; x < win->x + win->width && x < VGA_WIDTH; x++) {
+                if (row[x] < 0) row[x] = id;
+            }
+        }
+    }
+}
+
+// Blank rows [from, to), damaging the text they showed
+static void blank_rows(int window_id, int from, int to) {
+    Window* win = windows[window_id];
+    for (int row = from; row < to; row++) {
+        int slot = win->row_slot[row];
+        damage_text_span(window_id, row, 0, win->slot_length[slot]);
+        win->text_lines[slot][0] = '\0';
+        win->slot_length[slot] = 0;
+    }
+}
+
+// Character the window shows at window-relative column c, row r
+static uint16_t window_cell(Window* win, int c, int r) {
+    uint8_t border_color = win->focused ? VGA_COLOR(15, 4) : win->color;
+    int last_col = win->width - 1;
+    int last_row = win->height - 1;
+
+    if (r == 0) {
+        int t = c - 2;
+        if (t >= 0 && c < last_col && t < win->title_length) {
+            return make_vga_entry(win->title[t], border_color);
+        }
+    }
+    if (r == 0 || r == last_row) {
+        char edge = (c == 0 || c == last_col) ? '+' : '-';
+        return make_vga_entry(edge, border_color);
+    }
+    if (c == 0 || c == last_col) {
+        return make_vga_entry('|', border_color);
     }
-    dest[i] = '\0';
+
+    int line = r - 1;
+    int col = c - 1;
+    if (line < MAX_WINDOW_TEXT_LINES) {
+        int slot = win->row_slot[line];
+        if (col < win->slot_length[slot]) {
+            return make_vga_entry(win->text_lines[slot][col], win->color);
+        }
+    }
+    return make_vga_entry(' ', border_color);
+}
+
+
+// Double the id table and the z-order list together
+static int grow_window_table(void) {
+    int capacity = window_capacity ? window_capacity * 2 : 8;
+    Window** table = (Window**)kzalloc(capacity * sizeof(Window*));
+    int* order = (int*)kmalloc(capacity * sizeof(int));
+    if (table == 0 || order == 0) {
+        kfree(table);
+        kfree(order);
+        return -1;
+    }
+
+    for (int i = 0; i < window_capacity; i++) {
+        table[i] = windows[i];
+    }
+    for (int i = 0; i < z_count; i++) {
+        order[i] = z_order[i];
+    }
+    kfree(windows);
+    kfree(z_order);
+    windows = table;
+    z_order = order;
+    window_capacity = capacity;
+    return 0;
+}
+
+static Window* lookup_window(int window_id) {
+    if (window_id < 0 || window_id >= window_capacity) return 0;
+    return windows[window_id];
 }
 
 void init_window_manager(void) {
+    kmem_cache_init(&window_cache, "window", sizeof(Window));
     window_count = 0;
     focused_window = -1;
-    for (int i = 0; i < MAX_WINDOWS; i++) {
-        windows[i].active = 0;
-        windows[i].focused = 0;
+    z_count = 0;
+    grow_window_table();
+    rebuild_owner_map();
+
+    for (int i = 0; i < VGA_HEIGHT; i++) {
+        damage_x0[i] = 0;
+        damage_x1[i] = 0;
     }
+    stats.frames = 0;
+    stats.last_frame_cells = 0;
+    stats.total_cells = 0;
+
+    desktop_fill(0, DESKTOP_TOP, VGA_WIDTH, VGA_HEIGHT - DESKTOP_TOP, ' ', DESKTOP_COLOR);
+}
+
+void desktop_fill(uint8_t x, uint8_t y, uint8_t width, uint8_t height, char c, uint8_t color) {
+    for (int row = y; row < y + height && row < VGA_HEIGHT; row++) {
+        for (int col = x; col < x + width && col < VGA_WIDTH; col++) {
+            desktop[row * VGA_WIDTH + col] = make_vga_entry(c, color);
+        }
+    }
+    wm_damage(x, y, width, height);
+}
+
+void desktop_puts(const char* str, uint8_t color, uint8_t x, uint8_t y) {
+    if (y >= VGA_HEIGHT) return;
+    int i = 0;
+    for (; str[i] != '\0' && x + i < VGA_WIDTH; i++) {
+        desktop[y * VGA_WIDTH + x + i] = make_vga_entry(str[i], color);
+    }
+    wm_damage(x, y, i, 1);
 }
 
 int create_window(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const char* title, uint8_t color) {
-    if (window_count >= MAX_WINDOWS) return -1;
+    if (window_count >= window_capacity && grow_window_table() < 0) return -1;
     
     int id = -1;
-    for (int i = 0; i < MAX_WINDOWS; i++) {
-        if (!windows[i].active) {
+    for (int i = 0; i < window_capacity; i++) {
+        if (windows[i] == 0) {
             id = i;
             break;
         }
@@ -86,122 +297,159 @@ int create_window(uint8_t x, uint8_t y, uint8_t width, uint8_t height, const cha
     
     if (id < 0) return -1;
     
-    windows[id].x = x;
-    windows[id].y = y;
-    windows[id].width = width;
-    windows[id].height = height;
-    windows[id].color = color;
-    windows[id].active = 1;
-    windows[id].focused = 0;
-    windows[id].text_line_count = 0;
+    windows[id] = (Window*)kmem_cache_alloc(&window_cache);
+    if (windows[id] == 0) return -1;
     
-    str_copy(windows[id].title, title, 32);
+    windows[id]->x = x;
+    windows[id]->y = y;
+    windows[id]->width = width;
+    windows[id]->height = height;
+    windows[id]->color = color;
+    windows[id]->active = 1;
+    windows[id]->focused = 0;
+    windows[id]->text_line_count = 0;
+    windows[id]->shown_line_count = 0;
+    
+    strlcpy(windows[id]->title, title, 32);
+    windows[id]->title_length = strlen(windows[id]->title);
     
     for (int i = 0; i < MAX_WINDOW_TEXT_LINES; i++) {
-        windows[id].text_lines[i][0] = '\0';
+        windows[id]->text_lines[i][0] = '\0';
+        windows[id]->row_slot[i] = i;
+        windows[id]->slot_length[i] = 0;
     }
     
     window_count++;
+    z_push_top(id);
+    rebuild_owner_map();
+    damage_whole_window(windows[id]);
     return id;
 }
 
 void close_window(int window_id) {
-    if (window_id < 0 || window_id >= MAX_WINDOWS) return;
-    if (!windows[window_id].active) return;
+    Window* win = lookup_window(window_id);
+    if (win == 0) return;
     
-    windows[window_id].active = 0;
-    windows[window_id].focused = 0;
     window_count--;
+    z_remove(window_id);
+    rebuild_owner_map();
+    damage_whole_window(win);
+    windows[window_id] = 0;
+    kmem_cache_free(&window_cache, win);
     
     if (focused_window == window_id) {
         focused_window = -1;
-        // Find another window to focus
-        for (int i = 0; i < MAX_WINDOWS; i++) {
-            if (windows[i].active) {
-                focus_window(i);
-                break;
-            }
+        // Focus whatever is now on top
+        if (z_count > 0) {
+            focus_window(z_order[z_count - 1]);
         }
     }
 }
 
 void close_all_windows(void) {
-    for (int i = 0; i < MAX_WINDOWS; i++) {
-        if (windows[i].active) {
-            windows[i].active = 0;
-            windows[i].focused = 0;
+    for (int i = 0; i < window_capacity; i++) {
+        if (windows[i]) {
+            damage_whole_window(windows[i]);
+            kmem_cache_free(&window_cache, windows[i]);
+            windows[i] = 0;
         }
     }
     window_count = 0;
     focused_window = -1;
+    z_count = 0;
+    rebuild_owner_map();
 }
 
 void draw_window(int window_id) {
-    if (window_id < 0 || window_id >= MAX_WINDOWS) return;
-    if (!windows[window_id].active) return;
+    Window* win = lookup_window(window_id);
+    if (win == 0) return;
     
-    Window* win = &windows[window_id];
-    
-    // Determine border color based on focus
-    uint8_t border_color = win->focused ? VGA_COLOR(15, 4) : win->color;
-    
-    // Draw window box
-    draw_box(win->x, win->y, win->width, win->height, border_color);
-    
-    // Draw title bar
-    int title_x = win->x + 2;
-    puts_at(win->title, border_color, title_x, win->y);
-    
-    // Draw window content
-    int content_y = win->y + 1;
-    for (int i = 0; i < win->text_line_count && i < (win->height - 2); i++) {
-        puts_at(win->text_lines[i], win->color, win->x + 1, content_y + i);
-    }
+    damage_whole_window(win);
+    draw_all_windows();
 }
 
+// Compositor: paint each damaged cell once, from the desktop or the
+// window that owns it. Undamaged cells are never touched.
 void draw_all_windows(void) {
-    // Draw unfocused windows first
-    for (int i = 0; i < MAX_WINDOWS; i++) {
-        if (windows[i].active && !windows[i].focused) {
-            draw_window(i);
-        }
+    // Rows dropped since the last frame leave stale cells behind
+    for (int i = 0; i < window_capacity; i++) {
+        Window* win = windows[i];
+        if (win == 0) continue;
+        blank_rows(i, win->text_line_count, win->shown_line_count);
+        win->shown_line_count = win->text_line_count;
     }
+
+    frame_cells = 0;
     
-    // Draw focused window last (on top)
-    if (focused_window >= 0 && focused_window < MAX_WINDOWS) {
-        if (windows[focused_window].active) {
-            draw_window(focused_window);
+    for (int y = DESKTOP_TOP; y < VGA_HEIGHT; y++) {
+        int x0 = damage_x0[y];
+        int x1 = damage_x1[y];
+        if (x0 >= x1) continue;
+        
+        const int16_t* row = &owner[y * VGA_WIDTH];
+        for (int x = x0; x < x1; x++) {
+            uint16_t cell;
+            if (row[x] < 0) {
+                cell = desktop[y * VGA_WIDTH + x];
+            } else {
+                Window* win = windows[row[x]];
+                cell = window_cell(win, x - win->x, y - win->y);
+            }
+            putchar_at(cell & 0xFF, cell >> 8, x, y);
         }
+        
+        damage_x0[y] = 0;
+        damage_x1[y] = 0;
+    }
+    
+    if (frame_cells > 0) {
+        stats.frames++;
+        stats.last_frame_cells = frame_cells;
+        stats.total_cells += frame_cells;
     }
 }
 
+void wm_get_stats(CompositorStats* out) {
+    *out = stats;
+}
+
 void focus_window(int window_id) {
-    if (window_id < 0 || window_id >= MAX_WINDOWS) return;
-    if (!windows[window_id].active) return;
+    if (lookup_window(window_id) == 0) return;
+    if (focused_window == window_id) return;
+    
+    // Old focus only changes border color where it is still visible
+    Window* old = lookup_window(focused_window);
+    if (old) {
+        old->focused = 0;
+        damage_visible_window(focused_window);
+    }
     
-    // Unfocus all windows
-    for (int i = 0; i < MAX_WINDOWS; i++) {
-        windows[i].focused = 0;
+    // Raise to the top of the stack
+    if (z_order[z_count - 1] != window_id) {
+        z_remove(window_id);
+        z_push_top(window_id);
+        rebuild_owner_map();
     }
+    damage_whole_window(windows[window_id]);
     
     // Focus the selected window
-    windows[window_id].focused = 1;
+    windows[window_id]->focused = 1;
     focused_window = window_id;
 }
 
+// Rotate the stack: send the top window to the bottom, focus the new top
 void cycle_focus(void) {
-    if (window_count == 0) return;
-    
-    int start = focused_window + 1;
-    if (start >= MAX_WINDOWS) start = 0;
+    if (z_count == 0) return;
     
-    for (int i = 0; i < MAX_WINDOWS; i++) {
-        int idx = (start + i) % MAX_WINDOWS;
-        if (windows[idx].active) {
-            focus_window(idx);
-            return;
-        }
+    if (z_count > 1) {
+        int top = z_order[z_count - 1];
+        damage_whole_window(windows[top]);
+        z_remove(top);
+        z_push_bottom(top);
+        rebuild_owner_map();
     }
+    
+    focus_window(z_order[z_count - 1]);
 }
 
 int get_focused_window(void) {
@@ -209,19 +457,149 @@ int get_focused_window(void) {
 }
 
 Window* get_window(int window_id) {
-    if (window_id < 0 || window_id >= MAX_WINDOWS) return 0;
-    if (!windows[window_id].active) return 0;
-    return &windows[window_id];
+    return lookup_window(window_id);
+}
+
+void move_window(int window_id, int x, int y) {
+    Window* win = get_window(window_id);
+    if (win == 0) return;
+    if (win->x == x && win->y == y) return;
+    
+    damage_whole_window(win);
+    win->x = x;
+    win->y = y;
+    rebuild_owner_map();
+    damage_whole_window(win);
+}
+
+void set_window_title(int window_id, const char* title) {
+    Window* win = get_window(window_id);
+    if (win == 0) return;
+    
+    strlcpy(win->title, title, 32);
+    win->title_length = strlen(win->title);
+    damage_visible_span(window_id, win->x, win->y, win->width);
+}
+
+// Start rebuilding the text; unchanged lines re-added afterwards cost nothing
+void clear_window_text(int window_id) {
+    window_clear_rows(window_id, 0);
 }
 
 void add_window_text(int window_id, const char* text) {
-    if (window_id < 0 || window_id >= MAX_WINDOWS) return;
-    if (!windows[window_id].active) return;
+    Window* win = lookup_window(window_id);
+    if (win == 0) return;
+    
+    window_set_row(window_id, win->text_line_count, text, strlen(text));
+}
+
+// Rows from from_row on are blanked by the next frame unless set again
+void window_clear_rows(int window_id, int from_row) {
+    Window* win = lookup_window(window_id);
+    if (win == 0) return;
+    
+    if (from_row < 0) from_row = 0;
+    if (from_row < win->text_line_count) {
+        win->text_line_count = from_row;
+    }
+}
+
+void window_set_row(int window_id, int row, const char* text, int len) {
+    Window* win = lookup_window(window_id);
+    if (win == 0) return;
+    if (row < 0 || row >= MAX_WINDOW_TEXT_LINES) return;
+    if (len > 79) len = 79;
     
-    Window* win = &windows[window_id];
+    // Rows dropped by window_clear_rows() below this one stay blank
+    if (row > win->text_line_count) {
+        blank_rows(window_id, win->text_line_count, row);
+    }
     
-    if (win->text_line_count >= MAX_WINDOW_TEXT_LINES) return;
+    // Damage only the columns that differ from what the row shows
+    int slot = win->row_slot[row];
+    char* dest = win->text_lines[slot];
+    int old_len = win->slot_length[slot];
+    int first = -1;
+    int last = -1;
+    for (int i = 0; i < len; i++) {
+        if (i >= old_len || dest[i] != text[i]) {
+            if (first < 0) first = i;
+            last = i;
+            dest[i] = text[i];
+        }
+    }
+    dest[len] = '\0';
+    if (old_len > len) {
+        if (first < 0) first = len;
+        last = old_len - 1;
+    }
+    win->slot_length[slot] = len;
+    if (first >= 0) {
+        damage_text_span(window_id, row, first, last + 1);
+    }
     
-    str_copy(win->text_lines[win->text_line_count], text, 80);
-    win->text_line_count++;
-}
\ No newline at end of file
+    if (row >= win->text_line_count) {
+        win->text_line_count = row + 1;
+    }
+    if (win->text_line_count > win->shown_line_count) {
+        win->shown_line_count = win->text_line_count;
+    }
+}
+
+void window_scroll_rows(int window_id, int top, int bottom, int delta) {
+    Window* win = lookup_window(window_id);
+    if (win == 0) return;
+    if (top < 0) top = 0;
+    if (bottom > MAX_WINDOW_TEXT_LINES) bottom = MAX_WINDOW_TEXT_LINES;
+    int count = bottom - top;
+    if (count <= 0 || delta == 0) return;
+    
+    if (top > win->text_line_count) {
+        blank_rows(window_id, win->text_line_count, top);
+    }
+    if (delta <= -count || delta >= count) {
+        for (int row = top; row < bottom; row++) {
+            window_set_row(window_id, row, "", 0);
+        }
+        return;
+    }
+    
+    // Rotate the slot map; the slots shifted out come back as the
+    // vacated rows. A cell changes when either occupant has text there.
+    // Rows dropped by window_clear_rows() still show text but move as blank.
+    uint8_t old_slot[MAX_WINDOW_TEXT_LINES];
+    uint8_t old_length[MAX_WINDOW_TEXT_LINES];
+    for (int i = 0; i < count; i++) {
+        int slot = win->row_slot[top + i];
+        old_slot[i] = slot;
+        old_length[i] = win->slot_length[slot];
+        if (top + i >= win->text_line_count) {
+            win->text_lines[slot][0] = '\0';
+            win->slot_length[slot] = 0;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        int from = i - delta;
+        if (from < 0) from += count;
+        else if (from >= count) from -= count;
+        
+        int slot = old_slot[from];
+        int vacated = (i - delta < 0 || i - delta >= count);
+        if (vacated) {
+            win->text_lines[slot][0] = '\0';
+            win->slot_length[slot] = 0;
+        }
+        win->row_slot[top + i] = slot;
+        
+        int shown = old_length[i];
+        int width = win->slot_length[slot];
+        damage_text_span(window_id, top + i, 0, shown > width ? shown : width);
+    }
+    
+    if (bottom > win->text_line_count) {
+        win->text_line_count = bottom;
+    }
+    if (win->text_line_count > win->shown_line_count) {
+        win->shown_line_count = win->text_line_count;
+    }
+}
@@ -0,0 +1,192 @@
+// bench.c - Time file lookup, compositing and key handling on the host
+//
+// Usage: hostbench [iterations]
+//
+// Runs the kernel's own filesystem.c, window.c, keyboard.c and apps.c on
+// the harness in host.c, so the numbers show the cost of the code paths
+// rather than of the disk or VGA memory. Prints nanoseconds per
+// operation, the best of several runs.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "../kernel/include/filesystem.h"
+#include "../kernel/include/window.h"
+#include "../kernel/include/vga.h"
+#include "../kernel/include/event.h"
+#include "../kernel/include/string.h"
+
+#define RUNS 5
+#define DIR_FILES 200
+
+static volatile int sink;
+static AppInstance notepad;
+
+// ---- File lookup ----
+
+static void lookup_hit(uint32_t i) {
+    sink = fs_file_exists((i & 1) ? "docs/file137" : "docs/file12");
+}
+
+static void lookup_miss(uint32_t i) {
+    (void)i;
+    sink = fs_file_exists("docs/nothing");
+}
+
+static void lookup_deep(uint32_t i) {
+    (void)i;
+    sink = fs_file_exists("a/b/c/d/leaf");
+}
+
+static void open_close(uint32_t i) {
+    int handle = fs_open((i & 1) ? "docs/file137" : "docs/file12");
+    fs_close(handle);
+}
+
+static void setup_files(void) {
+    host_boot(HOST_DISK_SECTORS);
+    fs_mkdir("docs");
+    char path[32] = "docs/file";
+    for (int i = 0; i < DIR_FILES; i++) {
+        fmt_int(path + 9, i);
+        fs_create_file(path);
+    }
+    fs_mkdir("a");
+    fs_mkdir("a/b");
+    fs_mkdir("a/b/c");
+    fs_mkdir("a/b/c/d");
+    fs_create_file("a/b/c/d/leaf");
+}
+
+// ---- Compositing ----
+
+static void setup_windows(void) {
+    host_boot(HOST_DISK_SECTORS);
+    static const char* titles[] = { " Terminal ", " Notepad ", " Files ", " Calculator " };
+    char line[64];
+    for (int w = 0; w < 4; w++) {
+        uint8_t background = 11 + w;
+        int id = create_window(4 + w * 8, 2 + w * 3, 44, 14, titles[w], VGA_COLOR(0, background));
+        for (int r = 0; r < 12; r++) {
+            strcpy(line, "line ");
+            fmt_int(line + 5, r);
+            strcat(line, " of some window text, long enough to clip");
+            add_window_text(id, line);
+        }
+    }
+    focus_window(0);
+    draw_all_windows();
+    vga_present();
+}
+
+// Everything damaged: the worst case, a move or a full redraw
+static void draw_full(uint32_t i) {
+    (void)i;
+    wm_damage(0, 1, VGA_WIDTH, VGA_HEIGHT - 1);
+    draw_all_windows();
+}
+
+// A typical app update: one row of the focused window changes
+static void draw_row(uint32_t i) {
+    window_set_row(0, 3, (i & 1) ? "odd frame" : "even frame", (i & 1) ? 9 : 10);
+    draw_all_windows();
+}
+
+static void draw_idle(uint32_t i) {
+    (void)i;
+    draw_all_windows();
+}
+
+// ---- Key handling ----
+
+static void setup_notepad(void) {
+    host_boot(HOST_DISK_SECTORS);
+    app_launch(1, &notepad);
+    focus_window(notepad.window_id);
+    notepad.ops->render(notepad.data);
+    host_type("The quick brown fox jumps over the lazy dog\nsecond line\n");
+    host_run(&notepad);
+}
+
+// Controller byte to decoded event, press and release
+static void key_decode(uint32_t i) {
+    static const uint8_t key[] = { 0x1E, 0x9E };
+    (void)i;
+    host_keys(key, 2);
+    host_keyboard_irq();
+    host_keyboard_irq();
+    Event event;
+    while (event_poll(&event)) {
+    }
+}
+
+// The whole path: IRQ, event, app, render, compositor, screen. Moving
+// the cursor keeps the text, and so the work per key, the same.
+static void key_to_screen(uint32_t i) {
+    static const uint8_t left[] = { 0xE0, 0x4B, 0xE0, 0xCB };
+    static const uint8_t right[] = { 0xE0, 0x4D, 0xE0, 0xCD };
+    host_keys((i & 1) ? right : left, 4);
+    host_run(&notepad);
+}
+
+// Typing a character and deleting it again
+static void key_type(uint32_t i) {
+    static const uint8_t type_x[] = { 0x2D, 0xAD };
+    static const uint8_t backspace[] = { 0x0E, 0x8E };
+    host_keys((i & 1) ? backspace : type_x, 2);
+    host_run(&notepad);
+}
+
+// ---- Cases ----
+
+typedef struct {
+    const char* name;
+    void (*setup)(void);
+    void (*run)(uint32_t i);
+    uint32_t scale;         // Iterations are divided by this
+} Case;
+
+static const Case cases[] = {
+    { "lookup, 200-entry dir",   setup_files,   lookup_hit,    1 },
+    { "lookup miss",             setup_files,   lookup_miss,   1 },
+    { "lookup, 5 levels deep",   setup_files,   lookup_deep,   1 },
+    { "fs_open + fs_close",      setup_files,   open_close,    1 },
+    { "draw_all_windows, full",  setup_windows, draw_full,     20 },
+    { "draw_all_windows, row",   setup_windows, draw_row,      1 },
+    { "draw_all_windows, idle",  setup_windows, draw_idle,     1 },
+    { "key decode",              setup_notepad, key_decode,    1 },
+    { "key to screen (arrow)",   setup_notepad, key_to_screen, 10 },
+    { "key to screen (typing)",  setup_notepad, key_type,      10 },
+};
+
+// Best of RUNS, in picoseconds per call
+static uint64_t time_case(void (*run)(uint32_t), uint32_t iterations) {
+    uint64_t best = ~(uint64_t)0;
+    for (int r = 0; r < RUNS; r++) {
+        uint64_t start = host_now_ns();
+        for (uint32_t i = 0; i < iterations; i++) {
+            run(i);
+        }
+        uint64_t elapsed = (host_now_ns() - start) * 1000 / iterations;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)atoi(argv[1]) : 100000;
+    if (iterations == 0) iterations = 1;
+
+    printf("%-26s %12s\n", "operation", "ns/op");
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint32_t n = iterations / cases[i].scale;
+        if (n == 0) n = 1;
+
+        cases[i].setup();
+        time_case(cases[i].run, n / 10 + 1);    // Warm up
+        uint64_t ps = time_case(cases[i].run, n);
+        printf("%-26s %8llu.%03llu\n", cases[i].name,
+               (unsigned long long)(ps / 1000), (unsigned long long)(ps % 1000));
+    }
+    return 0;
+}
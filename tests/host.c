@@ -0,0 +1,373 @@
+// host.c - The machine under the kernel modules in host builds (see host.h)
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "host.h"
+#include "../kernel/include/io.h"
+#include "../kernel/include/idt.h"
+#include "../kernel/include/ata.h"
+#include "../kernel/include/heap.h"
+#include "../kernel/include/sched.h"
+#include "../kernel/include/timer.h"
+#include "../kernel/include/paging.h"
+#include "../kernel/include/kernel.h"
+#include "../kernel/include/vga.h"
+#include "../kernel/include/window.h"
+#include "../kernel/include/event.h"
+#include "../kernel/include/keyboard.h"
+#include "../kernel/include/filesystem.h"
+#include "../kernel/include/bcache.h"
+#include "../kernel/include/shell.h"
+#include "../kernel/include/string.h"
+
+#define KEYBOARD_DATA_PORT 0x60
+#define KEYBOARD_STATUS_PORT 0x64
+#define STATUS_OUTPUT_FULL 0x01
+#define KBD_ACK 0xFA
+
+int host_checks;
+int host_failures;
+
+void host_check(int ok, const char* what, const char* file, int line) {
+    host_checks++;
+    if (!ok) {
+        host_failures++;
+        printf("FAIL %s:%d: %s\n", file, line, what);
+    }
+}
+
+// ---- Disk ----
+
+static uint8_t* disk;
+static uint32_t disk_sectors;
+static uint32_t disk_writes;
+
+int ata_init(void) {
+    return disk ? 0 : -1;
+}
+
+uint32_t ata_sector_count(void) {
+    return disk_sectors;
+}
+
+int ata_read(uint32_t lba, uint32_t count, void* buffer) {
+    if (lba + count > disk_sectors) return -1;
+    memcpy(buffer, disk + (size_t)lba * ATA_SECTOR_SIZE, (size_t)count * ATA_SECTOR_SIZE);
+    return 0;
+}
+
+int ata_write(uint32_t lba, uint32_t count, const void* buffer) {
+    if (lba + count > disk_sectors) return -1;
+    memcpy(disk + (size_t)lba * ATA_SECTOR_SIZE, buffer, (size_t)count * ATA_SECTOR_SIZE);
+    disk_writes += count;
+    return 0;
+}
+
+uint32_t host_disk_writes(void) {
+    return disk_writes;
+}
+
+// ---- Heap and threads ----
+
+void kmem_cache_init(KmemCache* cache, const char* name, uint32_t object_size) {
+    memset(cache, 0, sizeof(*cache));
+    cache->name = name;
+    cache->object_size = object_size;
+}
+
+void* kmem_cache_alloc(KmemCache* cache) {
+    return malloc(cache->object_size);
+}
+
+void kmem_cache_free(KmemCache* cache, void* object) {
+    (void)cache;
+    free(object);
+}
+
+void* kmalloc(uint32_t size) {
+    return malloc(size);
+}
+
+void* kzalloc(uint32_t size) {
+    return calloc(1, size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+void heap_get_stats(HeapStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void mutex_lock(Mutex* mutex) {
+    (void)mutex;
+}
+
+void mutex_unlock(Mutex* mutex) {
+    (void)mutex;
+}
+
+void sched_get_stats(SchedStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+// ---- Timer, paging and the desktop ----
+
+uint64_t host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+uint32_t timer_frequency(void) {
+    return TIMER_HZ;
+}
+
+uint32_t uptime_ms(void) {
+    return (uint32_t)(host_now_ns() / 1000000);
+}
+
+// rdtsc() below counts nanoseconds
+uint32_t tsc_to_ms(uint64_t cycles) {
+    return (uint32_t)(cycles / 1000000);
+}
+
+uint32_t tsc_to_us(uint64_t cycles) {
+    return (uint32_t)(cycles / 1000);
+}
+
+void event_signal(void) {
+}
+
+void paging_get_info(PagingInfo* info) {
+    memset(info, 0, sizeof(*info));
+}
+
+int paging_set_vga_cache(int type) {
+    return type;
+}
+
+static BootTimes boot_times;
+
+const BootTimes* get_boot_times(void) {
+    return &boot_times;
+}
+
+static AppInstance registered;
+static int have_registered;
+
+void app_register(const AppInstance* instance) {
+    registered = *instance;
+    have_registered = 1;
+}
+
+const AppInstance* host_registered_app(void) {
+    return have_registered ? &registered : 0;
+}
+
+// ---- CPU and ports ----
+
+static irq_handler_t irq_handlers[16];
+
+void irq_install_handler(int irq, irq_handler_t handler) {
+    irq_handlers[irq] = handler;
+}
+
+uint32_t irq_save(void) {
+    return 0;
+}
+
+void irq_restore(uint32_t flags) {
+    (void)flags;
+}
+
+uint64_t rdtsc(void) {
+    return host_now_ns();
+}
+
+// Keyboard controller: replies to commands come out before scripted keys
+#define KEY_SCRIPT_SIZE 4096
+
+static uint8_t replies[16];
+static int reply_count;
+static uint8_t script[KEY_SCRIPT_SIZE];
+static int script_head;
+static int script_tail;
+
+volatile uint8_t host_bda_keyboard_flags;
+
+static int output_full(void) {
+    return reply_count > 0 || script_head != script_tail;
+}
+
+uint8_t inb(uint16_t port) {
+    if (port == KEYBOARD_STATUS_PORT) {
+        return output_full() ? STATUS_OUTPUT_FULL : 0;
+    }
+    if (port == KEYBOARD_DATA_PORT) {
+        if (reply_count > 0) {
+            uint8_t byte = replies[0];
+            memmove(replies, replies + 1, --reply_count);
+            return byte;
+        }
+        if (script_head != script_tail) {
+            uint8_t byte = script[script_tail];
+            script_tail = (script_tail + 1) % KEY_SCRIPT_SIZE;
+            return byte;
+        }
+    }
+    return 0;
+}
+
+// Every byte sent to the keyboard (LED command, LED value) is acknowledged
+void outb(uint16_t port, uint8_t value) {
+    (void)value;
+    if (port == KEYBOARD_DATA_PORT && reply_count < (int)sizeof(replies)) {
+        replies[reply_count++] = KBD_ACK;
+    }
+}
+
+void host_keys(const uint8_t* scancodes, int count) {
+    for (int i = 0; i < count; i++) {
+        int next = (script_head + 1) % KEY_SCRIPT_SIZE;
+        if (next == script_tail) return;
+        script[script_head] = scancodes[i];
+        script_head = next;
+    }
+}
+
+int host_keys_pending(void) {
+    return (script_head - script_tail + KEY_SCRIPT_SIZE) % KEY_SCRIPT_SIZE;
+}
+
+int host_keyboard_irq(void) {
+    if (!output_full() || irq_handlers[1] == 0) return 0;
+    irq_handlers[1](0);
+    return 1;
+}
+
+// Set 1 make codes by character, from 0x02 and 0x10 on
+static const char number_row[] = "1234567890-=";
+static const char upper_rows[] = "qwertyuiop[]\n\0asdfghjkl;'`\0\\zxcvbnm,./";
+static const char shifted[] = "!@#$%^&*()_+QWERTYUIOP{}ASDFGHJKL:\"~|ZXCVBNM<>?";
+static const char unshifted[] = "1234567890-=qwertyuiop[]asdfghjkl;'`\\zxcvbnm,./";
+
+static uint8_t make_code(char c) {
+    if (c == ' ') return KEY_SPACE;
+    for (int i = 0; number_row[i]; i++) {
+        if (number_row[i] == c) return 0x02 + i;
+    }
+    for (int i = 0; i < (int)sizeof(upper_rows) - 1; i++) {
+        if (upper_rows[i] == c) return 0x10 + i;
+    }
+    return 0;
+}
+
+void host_type(const char* text) {
+    for (; *text; text++) {
+        char c = *text;
+        int shift = 0;
+        for (int i = 0; shifted[i]; i++) {
+            if (shifted[i] == c) {
+                c = unshifted[i];
+                shift = 1;
+                break;
+            }
+        }
+        uint8_t code = make_code(c);
+        if (code == 0) continue;
+
+        uint8_t bytes[4];
+        int n = 0;
+        if (shift) bytes[n++] = KEY_LSHIFT;
+        bytes[n++] = code;
+        bytes[n++] = code | 0x80;
+        if (shift) bytes[n++] = KEY_LSHIFT | 0x80;
+        host_keys(bytes, n);
+    }
+}
+
+int host_run(const AppInstance* app) {
+    while (host_keyboard_irq()) {
+    }
+
+    int events = 0;
+    Event event;
+    while (event_poll(&event)) {
+        events++;
+        if (app == 0) continue;
+        int dirty = app->ops->on_event(app->data, &event);
+        if (event.type == EVENT_REDRAW) dirty = 1;
+        if (dirty) {
+            wm_lock();
+            app->ops->render(app->data);
+            wm_unlock();
+        }
+    }
+
+    wm_lock();
+    draw_all_windows();
+    vga_present();
+    wm_unlock();
+    return events;
+}
+
+// ---- Screen ----
+
+static uint16_t screen[VGA_WIDTH * VGA_HEIGHT];
+
+uint16_t host_screen_cell(int x, int y) {
+    return screen[y * VGA_WIDTH + x];
+}
+
+void host_screen_row(int y, char* out) {
+    for (int x = 0; x < VGA_WIDTH; x++) {
+        out[x] = (char)(screen[y * VGA_WIDTH + x] & 0xFF);
+    }
+    out[VGA_WIDTH] = '\0';
+}
+
+int host_screen_find(const char* text) {
+    char row[VGA_WIDTH + 1];
+    size_t len = strlen(text);
+    for (int y = 0; y < VGA_HEIGHT; y++) {
+        host_screen_row(y, row);
+        for (size_t x = 0; x + len <= VGA_WIDTH; x++) {
+            if (memcmp(row + x, text, len) == 0) return y;
+        }
+    }
+    return -1;
+}
+
+// ---- Boot ----
+
+void host_boot(uint32_t sectors) {
+    free(disk);
+    disk = (uint8_t*)calloc(sectors, ATA_SECTOR_SIZE);
+    disk_sectors = sectors;
+    disk_writes = 0;
+    have_registered = 0;
+
+    vga_buffer = screen;
+    memset(screen, 0, sizeof(screen));
+    vga_init(VGA_COLOR(7, 1));
+
+    event_init();
+    reply_count = 0;
+    script_head = script_tail = 0;
+    host_bda_keyboard_flags = 0;
+    init_keyboard();
+    // Let the LED update at the end of init_keyboard finish
+    while (host_keyboard_irq()) {
+    }
+
+    close_all_windows();
+    init_window_manager();
+    init_apps();
+    init_filesystem();
+    shell_init();
+    draw_all_windows();
+    vga_present();
+}
@@ -0,0 +1,70 @@
+// host.h - Harness for running kernel modules as a Linux program
+//
+// "make test" and "make bench" build kernel/filesystem.c, window.c,
+// keyboard.c, apps.c and what they use, unchanged, with -DVIN_HOST. This
+// harness (host.c) stands in for everything below them:
+//
+//   - the disk is a RAM array behind the ata_* functions
+//   - the kernel heap maps onto malloc; there is one thread, so mutexes
+//     do nothing
+//   - vga_buffer points at an array the tests read back
+//   - port I/O goes to an emulated keyboard controller that hands out
+//     scancodes from a script; host_keyboard_irq() runs the driver's IRQ
+//     handler as the hardware would
+#ifndef HOST_H
+#define HOST_H
+
+#include "../kernel/include/stdint.h"
+#include "../kernel/include/apps.h"
+#include "../kernel/include/filesystem.h"
+
+// ---- Checks ----
+
+extern int host_checks;
+extern int host_failures;
+
+void host_check(int ok, const char* what, const char* file, int line);
+#define CHECK(cond) host_check((cond) != 0, #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) host_check((a) == (b), #a " == " #b, __FILE__, __LINE__)
+
+// ---- Machine ----
+
+// Disk size for host_boot: 512 KB of file system after the kernel area
+#define HOST_DISK_SECTORS (FS_START_LBA + 1024)
+
+// Fresh kernel state: a blank RAM disk of sectors sectors (formatted by
+// init_filesystem), an empty screen, window manager and input queue,
+// and the apps and shell initialised
+void host_boot(uint32_t sectors);
+
+// Disk sectors written since boot
+uint32_t host_disk_writes(void);
+
+// Queue scancode bytes at the keyboard controller
+void host_keys(const uint8_t* scancodes, int count);
+int host_keys_pending(void);
+// Queue the presses and releases that type text: US layout letters,
+// digits and punctuation, space and newline
+void host_type(const char* text);
+// Deliver one keyboard IRQ if a byte is waiting; returns 0 if none was
+int host_keyboard_irq(void);
+
+// One pass of the desktop: keyboard IRQs for every queued byte, the
+// events routed to app (may be 0) the way its thread runs them, then a
+// frame drawn and presented. Returns the number of events.
+int host_run(const AppInstance* app);
+
+// Text shown on screen row y (VGA memory, after vga_present), 80
+// characters and a terminator
+void host_screen_row(int y, char* out);
+// Row of the first screen line containing text, or -1
+int host_screen_find(const char* text);
+uint16_t host_screen_cell(int x, int y);
+
+// The last app passed to app_register (0 if none since host_boot)
+const AppInstance* host_registered_app(void);
+
+// Monotonic nanoseconds
+uint64_t host_now_ns(void);
+
+#endif
@@ -0,0 +1,425 @@
+// test_fs.c - The fs_* functions on a RAM disk
+#include "host.h"
+#include "../kernel/include/filesystem.h"
+#include "../kernel/include/shell.h"
+#include "../kernel/include/string.h"
+
+static char big[3 * FS_BLOCK_SIZE + 100];
+
+static void fill_pattern(char* data, int len, int seed) {
+    for (int i = 0; i < len; i++) {
+        data[i] = 'a' + (i * 7 + seed) % 26;
+    }
+}
+
+static int listed(char names[][MAX_FILENAME], int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+static void test_mount(void) {
+    host_boot(HOST_DISK_SECTORS);
+    CHECK(fs_is_mounted());
+
+    FsStats stats;
+    fs_get_stats(&stats);
+    CHECK_EQ(stats.total_blocks, 1024u);
+    CHECK(stats.free_blocks > 0 && stats.free_blocks < stats.total_blocks);
+    CHECK_EQ(stats.free_inodes, stats.inode_count - 2);
+
+    // Written files survive a remount of the same disk
+    CHECK_EQ(fs_write_file("keep.txt", "kept", 4), 4);
+    init_filesystem();
+    CHECK(fs_is_mounted());
+    char buffer[16];
+    CHECK_EQ(fs_read_file("keep.txt", buffer, sizeof(buffer)), 4);
+    CHECK(memcmp(buffer, "kept", 4) == 0);
+
+    // Reformatting empties it
+    CHECK_EQ(fs_format(512), 0);
+    CHECK(!fs_file_exists("keep.txt"));
+    fs_get_stats(&stats);
+    CHECK_EQ(stats.total_blocks, 512u);
+    CHECK_EQ(fs_format(10), -1);
+    CHECK(!fs_is_mounted());
+    CHECK_EQ(fs_open("keep.txt"), -1);
+}
+
+static void test_files(void) {
+    host_boot(HOST_DISK_SECTORS);
+    char buffer[sizeof(big)];
+
+    CHECK(fs_create_file("empty.txt") > 0);
+    CHECK(fs_file_exists("empty.txt"));
+    CHECK_EQ(fs_get_file_size("empty.txt"), 0);
+    CHECK_EQ(fs_read_file("empty.txt", buffer, sizeof(buffer)), 0);
+
+    // Creating an existing file leaves it alone
+    CHECK_EQ(fs_write_file("empty.txt", "x", 1), 1);
+    CHECK(fs_create_file("empty.txt") > 0);
+    CHECK_EQ(fs_get_file_size("empty.txt"), 1);
+
+    // Across direct blocks, and rewritten shorter
+    fill_pattern(big, sizeof(big), 3);
+    CHECK_EQ(fs_write_file("big.txt", big, sizeof(big)), (int)sizeof(big));
+    CHECK_EQ(fs_get_file_size("big.txt"), (int)sizeof(big));
+    CHECK_EQ(fs_read_file("big.txt", buffer, sizeof(buffer)), (int)sizeof(big));
+    CHECK(memcmp(buffer, big, sizeof(big)) == 0);
+    CHECK_EQ(fs_read_file("big.txt", buffer, 10), 10);
+
+    CHECK_EQ(fs_write_file("big.txt", "short", 5), 5);
+    CHECK_EQ(fs_get_file_size("big.txt"), 5);
+    CHECK_EQ(fs_read_file("big.txt", buffer, sizeof(buffer)), 5);
+    CHECK(memcmp(buffer, "short", 5) == 0);
+
+    // Past the direct blocks into the indirect one
+    static char large[FS_BLOCK_SIZE * (FS_DIRECT_BLOCKS + 4)];
+    static char back[sizeof(large)];
+    fill_pattern(large, sizeof(large), 11);
+    CHECK_EQ(fs_write_file("large.bin", large, sizeof(large)), (int)sizeof(large));
+    CHECK_EQ(fs_read_file("large.bin", back, sizeof(back)), (int)sizeof(large));
+    CHECK(memcmp(back, large, sizeof(large)) == 0);
+
+    // Missing files and bad arguments
+    CHECK(!fs_file_exists("missing"));
+    CHECK_EQ(fs_get_file_size("missing"), -1);
+    CHECK_EQ(fs_read_file("missing", buffer, sizeof(buffer)), -1);
+    CHECK_EQ(fs_write_file("x.txt", "x", -1), -1);
+    CHECK_EQ(fs_write_file("nodir/x.txt", "x", 1), -1);
+    CHECK_EQ(fs_delete_file("missing"), -1);
+
+    // Deleting gives the space back
+    FsStats before, after;
+    fs_get_stats(&before);
+    CHECK_EQ(fs_delete_file("large.bin"), 0);
+    fs_get_stats(&after);
+    CHECK(!fs_file_exists("large.bin"));
+    CHECK(after.free_blocks >= before.free_blocks + FS_DIRECT_BLOCKS + 4);
+    CHECK_EQ(after.free_inodes, before.free_inodes + 1);
+}
+
+static void test_directories(void) {
+    host_boot(HOST_DISK_SECTORS);
+    char names[MAX_FILES][MAX_FILENAME];
+
+    CHECK_EQ(fs_list_files(names, MAX_FILES), 0);
+    CHECK_EQ(fs_mkdir("docs"), 0);
+    CHECK_EQ(fs_mkdir("docs"), 0);          // Already there
+    CHECK_EQ(fs_mkdir("docs/old"), 0);
+    CHECK_EQ(fs_mkdir("nodir/sub"), -1);
+    CHECK_EQ(fs_write_file("docs/todo.txt", "milk", 4), 4);
+    CHECK_EQ(fs_write_file("readme", "hi", 2), 2);
+
+    // A file and a directory cannot share a name
+    CHECK_EQ(fs_mkdir("readme"), -1);
+    CHECK_EQ(fs_create_file("docs"), -1);
+
+    int count = fs_list_files(names, MAX_FILES);
+    CHECK_EQ(count, 2);
+    CHECK(listed(names, count, "docs/"));
+    CHECK(listed(names, count, "readme"));
+
+    count = fs_list_dir("docs", names, MAX_FILES);
+    CHECK_EQ(count, 2);
+    CHECK(listed(names, count, "old/"));
+    CHECK(listed(names, count, "todo.txt"));
+    CHECK_EQ(fs_list_dir("readme", names, MAX_FILES), -1);
+    CHECK_EQ(fs_list_dir("missing", names, MAX_FILES), -1);
+    CHECK_EQ(fs_list_dir("docs", names, 1), 1);
+
+    // Paths resolve through directories
+    char buffer[8];
+    CHECK(fs_file_exists("docs/todo.txt"));
+    CHECK(!fs_file_exists("todo.txt"));
+    CHECK_EQ(fs_read_file("docs/todo.txt", buffer, sizeof(buffer)), 4);
+
+    // Only empty directories can be removed
+    CHECK_EQ(fs_delete_file("docs"), -1);
+    CHECK_EQ(fs_delete_file("docs/todo.txt"), 0);
+    CHECK_EQ(fs_delete_file("docs/old"), 0);
+    CHECK_EQ(fs_delete_file("docs"), 0);
+    CHECK_EQ(fs_list_files(names, MAX_FILES), 1);
+
+    // More entries than one directory block holds
+    char name[16];
+    for (int i = 0; i < 40; i++) {
+        strcpy(name, "f");
+        fmt_int(name + 1, i);
+        CHECK(fs_create_file(name) > 0);
+    }
+    CHECK_EQ(fs_list_files(names, MAX_FILES), MAX_FILES);
+    CHECK(fs_file_exists("f0"));
+    CHECK(fs_file_exists("f39"));
+    CHECK_EQ(fs_delete_file("f20"), 0);
+    CHECK(!fs_file_exists("f20"));
+    CHECK(fs_file_exists("f21"));
+}
+
+static void test_generation(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    uint32_t generation = fs_generation();
+    CHECK_EQ(fs_write_file("a", "1", 1), 1);
+    CHECK(fs_generation() != generation);
+
+    // Rewriting a file changes no names
+    generation = fs_generation();
+    CHECK_EQ(fs_write_file("a", "2", 1), 1);
+    CHECK_EQ(fs_generation(), generation);
+
+    CHECK_EQ(fs_delete_file("a"), 0);
+    CHECK(fs_generation() != generation);
+}
+
+static void test_handles(void) {
+    host_boot(HOST_DISK_SECTORS);
+    char buffer[sizeof(big)];
+
+    fill_pattern(big, sizeof(big), 5);
+    CHECK_EQ(fs_write_file("data", big, sizeof(big)), (int)sizeof(big));
+    CHECK_EQ(fs_mkdir("dir"), 0);
+
+    int handle = fs_open("data");
+    CHECK(handle >= 0);
+    CHECK_EQ(fs_size(handle), (int)sizeof(big));
+    CHECK(!fs_is_dir(handle));
+    CHECK_EQ(fs_read(handle, 0, buffer, sizeof(buffer)), (int)sizeof(big));
+    CHECK(memcmp(buffer, big, sizeof(big)) == 0);
+    CHECK_EQ(fs_read(handle, 500, buffer, 100), 100);
+    CHECK(memcmp(buffer, big + 500, 100) == 0);
+    CHECK_EQ(fs_read(handle, sizeof(big) - 10, buffer, 100), 10);
+    CHECK_EQ(fs_read(handle, sizeof(big), buffer, 100), 0);
+    CHECK_EQ(fs_read(handle, 0, buffer, -1), -1);
+
+    int dir = fs_open("dir");
+    CHECK(dir >= 0 && dir != handle);
+    CHECK(fs_is_dir(dir));
+    CHECK_EQ(fs_read(dir, 0, buffer, 10), -1);
+    fs_close(dir);
+
+    // A deleted file's handle stays open but fails
+    CHECK_EQ(fs_delete_file("data"), 0);
+    CHECK_EQ(fs_size(handle), -1);
+    CHECK_EQ(fs_read(handle, 0, buffer, 10), -1);
+    fs_close(handle);
+
+    CHECK_EQ(fs_open("missing"), -1);
+    CHECK_EQ(fs_size(-1), -1);
+    CHECK_EQ(fs_size(handle), -1);        // Closed
+    CHECK(!fs_is_dir(12345));
+    fs_close(12345);
+
+    // Handles are reused, and the table grows past its first size
+    int first = fs_open("dir");
+    fs_close(first);
+    CHECK_EQ(fs_open("dir"), first);
+    int opened[40];
+    for (int i = 0; i < 40; i++) {
+        opened[i] = fs_open("dir");
+        CHECK(opened[i] >= 0);
+    }
+    for (int i = 0; i < 40; i++) {
+        fs_close(opened[i]);
+    }
+    fs_close(first);
+}
+
+static void discard(void* ctx, const char* data, uint32_t len) {
+    (void)ctx;
+    (void)data;
+    (void)len;
+}
+
+// cp must not empty a file by copying it onto itself under another name
+static void test_copy_onto_itself(void) {
+    host_boot(HOST_DISK_SECTORS);
+    ShellOutput out = { discard, 0, 0 };
+    char buffer[64];
+
+    CHECK_EQ(fs_mkdir("docs"), 0);
+    CHECK_EQ(fs_write_file("notes.txt", "keep me", 7), 7);
+    CHECK_EQ(fs_write_file("docs/a", "and me", 6), 6);
+
+    int a = fs_open("docs/a");
+    int b = fs_open("/docs//a");
+    CHECK(a >= 0 && b >= 0 && a != b);
+    CHECK(fs_inode(a) != 0);
+    CHECK_EQ(fs_inode(a), fs_inode(b));
+    int other = fs_open("notes.txt");
+    CHECK(fs_inode(a) != fs_inode(other));
+    fs_close(other);
+    fs_close(a);
+    fs_close(b);
+    CHECK_EQ(fs_inode(a), 0u);
+
+    char same[] = "cp notes.txt /notes.txt";
+    CHECK_EQ(shell_run(&out, same), -1);
+    CHECK_EQ(fs_read_file("notes.txt", buffer, sizeof(buffer)), 7);
+    char aliased[] = "cp docs/a docs//a";
+    CHECK_EQ(shell_run(&out, aliased), -1);
+    CHECK_EQ(fs_read_file("docs/a", buffer, sizeof(buffer)), 6);
+    CHECK(memcmp(buffer, "and me", 6) == 0);
+
+    // A real copy still replaces the destination
+    char copy[] = "cp notes.txt docs/a";
+    CHECK_EQ(shell_run(&out, copy), 0);
+    CHECK_EQ(fs_read_file("docs/a", buffer, sizeof(buffer)), 7);
+    CHECK(memcmp(buffer, "keep me", 7) == 0);
+}
+
+static void test_borrow(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    fill_pattern(big, sizeof(big), 9);
+    CHECK_EQ(fs_write_file("data", big, sizeof(big)), (int)sizeof(big));
+    int handle = fs_open("data");
+
+    // Extents end at block boundaries and at the end of the file
+    const char* data;
+    CHECK_EQ(fs_borrow(handle, 0, &data), FS_BLOCK_SIZE);
+    CHECK(memcmp(data, big, FS_BLOCK_SIZE) == 0);
+    fs_release(data);
+    CHECK_EQ(fs_borrow(handle, 100, &data), FS_BLOCK_SIZE - 100);
+    CHECK(memcmp(data, big + 100, FS_BLOCK_SIZE - 100) == 0);
+    fs_release(data);
+    CHECK_EQ(fs_borrow(handle, 3 * FS_BLOCK_SIZE, &data), 100);
+    CHECK(memcmp(data, big + 3 * FS_BLOCK_SIZE, 100) == 0);
+    fs_release(data);
+    CHECK_EQ(fs_borrow(handle, sizeof(big), &data), 0);
+
+    // The whole file, block by block
+    uint32_t offset = 0;
+    int got;
+    int same = 1;
+    while ((got = fs_borrow(handle, offset, &data)) > 0) {
+        same &= memcmp(data, big + offset, got) == 0;
+        fs_release(data);
+        offset += got;
+    }
+    CHECK_EQ(got, 0);
+    CHECK_EQ(offset, (uint32_t)sizeof(big));
+    CHECK(same);
+
+    // Several borrows may be out at once
+    const char* a;
+    const char* b;
+    CHECK_EQ(fs_borrow(handle, 0, &a), FS_BLOCK_SIZE);
+    CHECK_EQ(fs_borrow(handle, FS_BLOCK_SIZE, &b), FS_BLOCK_SIZE);
+    CHECK(a != b);
+    CHECK(memcmp(b, big + FS_BLOCK_SIZE, FS_BLOCK_SIZE) == 0);
+    fs_release(a);
+    fs_release(b);
+    fs_release("not in the cache");         // Ignored
+
+    fs_mkdir("dir");
+    int dir_handle = fs_open("dir");
+    CHECK_EQ(fs_borrow(dir_handle, 0, &data), -1);
+    fs_close(dir_handle);
+    fs_close(handle);
+    CHECK_EQ(fs_borrow(handle, 0, &data), -1);
+}
+
+static void test_extents(void) {
+    host_boot(HOST_DISK_SECTORS);
+    char buffer[sizeof(big)];
+
+    CHECK(fs_create_file("out") > 0);
+    int handle = fs_open("out");
+
+    // Write the pattern in uneven pieces, an extent at a time
+    fill_pattern(big, sizeof(big), 1);
+    uint32_t offset = 0;
+    while (offset < sizeof(big)) {
+        char* extent;
+        int room = fs_extent(handle, offset, &extent);
+        CHECK(room > 0 && room <= FS_BLOCK_SIZE);
+        if (room <= 0) break;
+        uint32_t chunk = room < 300 ? room : 300;
+        if (chunk > sizeof(big) - offset) chunk = sizeof(big) - offset;
+        memcpy(extent, big + offset, chunk);
+        CHECK_EQ(fs_commit(handle, chunk), (int)chunk);
+        offset += chunk;
+    }
+    CHECK_EQ(fs_size(handle), (int)sizeof(big));
+    fs_close(handle);
+
+    // Closing flushed it: still there after a remount
+    uint32_t writes = host_disk_writes();
+    CHECK(writes > 0);
+    init_filesystem();
+    CHECK_EQ(fs_read_file("out", buffer, sizeof(buffer)), (int)sizeof(big));
+    CHECK(memcmp(buffer, big, sizeof(big)) == 0);
+
+    // Overwriting in the middle keeps the size; the skipped-over part of
+    // a block past the end reads as zeros
+    handle = fs_open("out");
+    char* extent;
+    CHECK_EQ(fs_extent(handle, 10, &extent), FS_BLOCK_SIZE - 10);
+    memcpy(extent, "XYZ", 3);
+    CHECK_EQ(fs_commit(handle, 3), 3);
+    CHECK_EQ(fs_size(handle), (int)sizeof(big));
+
+    uint32_t far = 6 * FS_BLOCK_SIZE + 8;
+    CHECK_EQ(fs_extent(handle, far, &extent), FS_BLOCK_SIZE - 8);
+    memcpy(extent, "end", 3);
+    CHECK_EQ(fs_commit(handle, 3), 3);
+    CHECK_EQ(fs_size(handle), (int)(far + 3));
+    CHECK_EQ(fs_read(handle, 6 * FS_BLOCK_SIZE, buffer, 11), 11);
+    CHECK(memcmp(buffer, "\0\0\0\0\0\0\0\0end", 11) == 0);
+    CHECK_EQ(fs_read(handle, 5 * FS_BLOCK_SIZE, buffer, 4), 4);
+    CHECK(memcmp(buffer, "\0\0\0\0", 4) == 0);
+    CHECK_EQ(fs_read(handle, 9, buffer, 5), 5);
+    CHECK(buffer[0] == big[9] && memcmp(buffer + 1, "XYZ", 3) == 0 && buffer[4] == big[13]);
+
+    // Commit needs an open extent and must fit in it
+    CHECK_EQ(fs_commit(handle, 1), -1);
+    CHECK_EQ(fs_extent(handle, 0, &extent), FS_BLOCK_SIZE);
+    CHECK_EQ(fs_commit(handle, FS_BLOCK_SIZE + 1), -1);
+
+    // An extent left open is released by fs_close
+    CHECK_EQ(fs_extent(handle, 0, &extent), FS_BLOCK_SIZE);
+    fs_close(handle);
+    CHECK_EQ(fs_extent(handle, 0, &extent), -1);
+    CHECK_EQ(fs_commit(handle, 0), -1);
+
+    // Directories have no extents
+    fs_mkdir("dir");
+    handle = fs_open("dir");
+    CHECK_EQ(fs_extent(handle, 0, &extent), -1);
+    fs_close(handle);
+}
+
+static void test_full_disk(void) {
+    host_boot(FS_START_LBA + 64);
+
+    // Fill the disk: a write that does not fit fails, others still work
+    static char data[64 * FS_BLOCK_SIZE];
+    CHECK(fs_write_file("huge", data, sizeof(data)) < (int)sizeof(data));
+    CHECK_EQ(fs_delete_file("huge"), 0);
+    CHECK_EQ(fs_write_file("small", "ok", 2), 2);
+
+    int handle = fs_open("small");
+    char* extent;
+    uint32_t offset = 0;
+    int room;
+    while ((room = fs_extent(handle, offset, &extent)) > 0) {
+        fs_commit(handle, room);
+        offset += room;
+    }
+    CHECK_EQ(room, -1);
+    fs_close(handle);
+}
+
+void test_fs(void) {
+    test_mount();
+    test_files();
+    test_directories();
+    test_generation();
+    test_handles();
+    test_copy_onto_itself();
+    test_borrow();
+    test_extents();
+    test_full_disk();
+}
@@ -0,0 +1,273 @@
+// test_keys.c - Scancode decoding and keys reaching the apps
+#include "host.h"
+#include "../kernel/include/keyboard.h"
+#include "../kernel/include/event.h"
+#include "../kernel/include/window.h"
+#include "../kernel/include/timer.h"
+#include "../kernel/include/string.h"
+
+extern volatile uint8_t host_bda_keyboard_flags;
+
+// Deliver the bytes and collect the events they post
+static int decode(const uint8_t* bytes, int count, Event* events, int max) {
+    host_keys(bytes, count);
+    while (host_keyboard_irq()) {
+    }
+    int n = 0;
+    Event event;
+    while (event_poll(&event)) {
+        if (n < max) events[n] = event;
+        n++;
+    }
+    return n;
+}
+
+static void test_decoding(void) {
+    host_boot(HOST_DISK_SECTORS);
+    Event events[16];
+
+    static const uint8_t press_a[] = { 0x1E, 0x9E };
+    CHECK_EQ(decode(press_a, 2, events, 16), 2);
+    CHECK(events[0].type == EVENT_KEY_DOWN && events[0].key == 0x1E && events[0].modifiers == 0);
+    CHECK(events[1].type == EVENT_KEY_UP && events[1].key == 0x1E);
+    CHECK_EQ(scancode_to_char(events[0].key, events[0].modifiers), 'a');
+
+    // Modifiers go out with the keys pressed while they are held
+    static const uint8_t shift_a[] = { 0x2A, 0x1E, 0x9E, 0xAA, 0x1E };
+    CHECK_EQ(decode(shift_a, 5, events, 16), 5);
+    CHECK(events[0].key == KEY_LSHIFT && events[0].modifiers == MOD_SHIFT);
+    CHECK(events[1].key == 0x1E && events[1].modifiers == MOD_SHIFT);
+    CHECK_EQ(scancode_to_char(events[1].key, events[1].modifiers), 'A');
+    CHECK(events[3].type == EVENT_KEY_UP && events[3].modifiers == 0);
+    CHECK(events[4].modifiers == 0);
+
+    // Right Ctrl (extended) holds Ctrl like the left one
+    static const uint8_t ctrl_c[] = { 0x9E, 0xE0, 0x1D, 0x2E, 0xAE, 0xE0, 0x9D };
+    CHECK_EQ(decode(ctrl_c, 7, events, 16), 5);
+    CHECK(events[1].key == KEY_RCTRL && events[1].modifiers == MOD_CTRL);
+    CHECK_EQ(scancode_to_char(events[2].key, events[2].modifiers), 3);
+    CHECK(events[4].key == KEY_RCTRL && events[4].type == EVENT_KEY_UP);
+
+    // Extended keys, with the fake shifts around them dropped
+    static const uint8_t arrows[] = { 0xE0, 0x48, 0xE0, 0xC8, 0xE0, 0x2A, 0xE0, 0x53, 0xE0, 0xD3, 0xE0, 0xAA };
+    CHECK_EQ(decode(arrows, 12, events, 16), 4);
+    CHECK(events[0].key == KEY_UP && events[0].type == EVENT_KEY_DOWN);
+    CHECK(events[1].key == KEY_UP && events[1].type == EVENT_KEY_UP);
+    CHECK(events[2].key == KEY_DELETE && events[3].key == KEY_DELETE);
+    CHECK_EQ(scancode_to_char(KEY_UP, 0), 0);
+
+    // The Pause sequence posts nothing
+    static const uint8_t pause[] = { 0xE1, 0x1D, 0x45, 0xE1, 0x9D, 0xC5 };
+    CHECK_EQ(decode(pause, 6, events, 16), 0);
+
+    // Hardware typematic makes are dropped
+    static const uint8_t held[] = { 0x30, 0x30, 0x30, 0xB0 };
+    CHECK_EQ(decode(held, 4, events, 16), 2);
+
+    KeyboardStats stats;
+    keyboard_get_stats(&stats);
+    CHECK(stats.scancodes >= 36);
+    CHECK_EQ(stats.dropped, 0u);
+}
+
+static void test_locks(void) {
+    host_boot(HOST_DISK_SECTORS);
+    Event events[8];
+
+    // Caps Lock toggles on press, with an LED update the keyboard ACKs
+    static const uint8_t caps[] = { 0x3A, 0xBA };
+    CHECK_EQ(decode(caps, 2, events, 8), 2);
+    CHECK(events[1].modifiers & MOD_CAPS);
+    KeyboardStats stats;
+    keyboard_get_stats(&stats);
+    CHECK(stats.modifiers & MOD_CAPS);
+    CHECK_EQ(scancode_to_char(0x1E, MOD_CAPS), 'A');
+    CHECK_EQ(scancode_to_char(0x1E, MOD_CAPS | MOD_SHIFT), 'a');
+    CHECK_EQ(scancode_to_char(0x02, MOD_CAPS), '1');
+    CHECK_EQ(decode(caps, 2, events, 8), 2);
+    keyboard_get_stats(&stats);
+    CHECK(!(stats.modifiers & MOD_CAPS));
+
+    // Keypad: navigation keys without Num Lock, digits with it
+    static const uint8_t keypad_8[] = { 0x48, 0xC8 };
+    CHECK_EQ(decode(keypad_8, 2, events, 8), 2);
+    CHECK_EQ(events[0].key, KEY_UP);
+    static const uint8_t num[] = { 0x45, 0xC5 };
+    decode(num, 2, events, 8);
+    CHECK_EQ(decode(keypad_8, 2, events, 8), 2);
+    CHECK_EQ(events[0].key, 0x48);
+    CHECK_EQ(scancode_to_char(events[0].key, events[0].modifiers), '8');
+
+    // Lock states left by the BIOS are kept
+    host_bda_keyboard_flags = 0x20 | 0x40;
+    init_keyboard();
+    while (host_keyboard_irq()) {
+    }
+    keyboard_get_stats(&stats);
+    CHECK_EQ(stats.modifiers & (MOD_NUM | MOD_CAPS), MOD_NUM | MOD_CAPS);
+    host_bda_keyboard_flags = 0;
+}
+
+static void test_repeat_and_overflow(void) {
+    host_boot(HOST_DISK_SECTORS);
+    Event events[4];
+
+    // Held past the delay, a key repeats from the timer at the rate
+    static const uint8_t press_x[] = { 0x2D };
+    CHECK_EQ(decode(press_x, 1, events, 4), 1);
+    uint32_t delay = KEY_REPEAT_DELAY_MS * TIMER_HZ / 1000;
+    uint32_t rate = KEY_REPEAT_RATE_MS * TIMER_HZ / 1000;
+    if (rate == 0) rate = 1;
+    for (uint32_t i = 0; i < delay + rate; i++) {
+        keyboard_tick();
+    }
+    CHECK_EQ(decode(press_x, 0, events, 4), 2);
+    CHECK(events[0].type == EVENT_KEY_DOWN && events[0].key == 0x2D && events[0].data == 1);
+    CHECK_EQ(events[1].data, 2u);
+
+    // Released, it stops
+    static const uint8_t release_x[] = { 0xAD };
+    CHECK_EQ(decode(release_x, 1, events, 4), 1);
+    for (uint32_t i = 0; i < delay * 2; i++) {
+        keyboard_tick();
+    }
+    CHECK_EQ(decode(release_x, 0, events, 4), 0);
+
+    // A full input queue drops keys and counts them
+    for (int i = 0; i < INPUT_QUEUE_SIZE; i++) {
+        host_type("ab");
+        while (host_keyboard_irq()) {
+        }
+    }
+    KeyboardStats stats;
+    keyboard_get_stats(&stats);
+    CHECK(stats.dropped > 0);
+    CHECK(event_dropped() > 0);
+    CHECK(decode(press_x, 0, events, 4) <= INPUT_QUEUE_SIZE);
+}
+
+static void test_notepad(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    AppInstance notepad;
+    CHECK_EQ(app_launch(1, &notepad), 0);
+    focus_window(notepad.window_id);
+    Event redraw = { EVENT_REDRAW, 0, 0, 0 };
+    notepad.ops->on_event(notepad.data, &redraw);
+    notepad.ops->render(notepad.data);
+
+    host_type("Hello, World!\nsecond line");
+    CHECK(host_run(&notepad) > 0);
+    CHECK(host_screen_find("Hello, World!") >= 0);
+    CHECK(host_screen_find("second line") == host_screen_find("Hello, World!") + 1);
+
+    // Backspace and arrows edit at the cursor, shown as _
+    static const uint8_t edit[] = { 0x0E, 0x8E, 0xE0, 0x4B, 0xE0, 0xCB, 0x2D, 0xAD };
+    host_keys(edit, sizeof(edit));
+    host_run(&notepad);
+    CHECK(host_screen_find("second lix_n") >= 0);
+
+    notepad.ops->destroy(notepad.data);
+    close_window(notepad.window_id);
+}
+
+static void test_terminal(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    AppInstance term;
+    CHECK_EQ(app_launch(2, &term), 0);
+    Event redraw = { EVENT_REDRAW, 0, 0, 0 };
+    term.ops->on_event(term.data, &redraw);
+    host_run(&term);
+
+    host_type("ver\n");
+    host_run(&term);
+    CHECK(host_screen_find("VIN OS v0.4") >= 0);
+
+    // Shell file commands run on the RAM disk
+    host_type("write notes.txt \"buy milk\"\ncat notes.txt\n");
+    host_run(&term);
+    CHECK(host_screen_find("buy milk") >= 0);
+    CHECK(fs_file_exists("notes.txt"));
+    host_type("ls nosuchdir\n");
+    host_run(&term);
+    CHECK(host_screen_find("ls: no such directory") >= 0);
+    host_type("nosuchcommand\n");
+    host_run(&term);
+    CHECK(host_screen_find("nosuchcommand: unknown command") >= 0);
+
+    term.ops->destroy(term.data);
+    close_window(term.window_id);
+}
+
+static void test_calculator(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    AppInstance calc;
+    CHECK_EQ(app_launch(0, &calc), 0);
+    calc.ops->render(calc.data);
+
+    // 12 * 34 = (the keypad '*' and '=')
+    host_type("12");
+    static const uint8_t times[] = { 0x37, 0xB7 };
+    host_keys(times, 2);
+    host_type("34=");
+    host_run(&calc);
+    CHECK(host_screen_find("Display: 408") >= 0);
+
+    host_type("c");
+    host_run(&calc);
+    CHECK(host_screen_find("Display: 0") >= 0);
+
+    calc.ops->destroy(calc.data);
+    close_window(calc.window_id);
+}
+
+static void test_file_manager(void) {
+    host_boot(HOST_DISK_SECTORS);
+    CHECK_EQ(fs_write_file("alpha.txt", "first file", 10), 10);
+    CHECK_EQ(fs_write_file("beta.txt", "second file", 11), 11);
+
+    AppInstance fm;
+    CHECK_EQ(app_launch(3, &fm), 0);
+    fm.ops->render(fm.data);
+    host_run(&fm);
+    CHECK(host_screen_find("alpha.txt") >= 0);
+    CHECK(host_screen_find("beta.txt") >= 0);
+
+    // Enter on the second file opens it in a new Notepad
+    static const uint8_t down_enter[] = { 0xE0, 0x50, 0xE0, 0xD0, 0x1C, 0x9C };
+    host_keys(down_enter, sizeof(down_enter));
+    host_run(&fm);
+    const AppInstance* opened = host_registered_app();
+    CHECK(opened != 0);
+    if (opened) {
+        AppInstance notepad = *opened;
+        CHECK(strcmp(notepad.ops->name, "notepad") == 0);
+        notepad.ops->render(notepad.data);
+        host_run(&notepad);
+        CHECK(host_screen_find("second file") >= 0);
+        notepad.ops->destroy(notepad.data);
+        close_window(notepad.window_id);
+    }
+
+    // Delete removes the selected file
+    static const uint8_t del[] = { 0xE0, 0x53, 0xE0, 0xD3 };
+    host_keys(del, sizeof(del));
+    host_run(&fm);
+    CHECK(!fs_file_exists("beta.txt"));
+    CHECK(fs_file_exists("alpha.txt"));
+
+    fm.ops->destroy(fm.data);
+    close_window(fm.window_id);
+}
+
+void test_keys(void) {
+    test_decoding();
+    test_locks();
+    test_repeat_and_overflow();
+    test_notepad();
+    test_terminal();
+    test_calculator();
+    test_file_manager();
+}
@@ -0,0 +1,33 @@
+// test_main.c - Unit tests of the kernel modules, run on the host
+//
+// Usage: hosttest
+//
+// Prints each failed check and a summary; exits 1 if anything failed.
+#include <stdio.h>
+
+#include "host.h"
+
+void test_fs(void);
+void test_window(void);
+void test_keys(void);
+
+static const struct {
+    const char* name;
+    void (*run)(void);
+} groups[] = {
+    { "file system", test_fs },
+    { "window manager", test_window },
+    { "keyboard and apps", test_keys },
+};
+
+int main(void) {
+    for (unsigned i = 0; i < sizeof(groups) / sizeof(groups[0]); i++) {
+        int checks = host_checks;
+        int failures = host_failures;
+        groups[i].run();
+        printf("%-20s %4d checks, %d failed\n", groups[i].name,
+               host_checks - checks, host_failures - failures);
+    }
+    printf("%s: %d checks, %d failed\n", host_failures ? "FAILED" : "OK", host_checks, host_failures);
+    return host_failures ? 1 : 0;
+}
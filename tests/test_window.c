@@ -0,0 +1,319 @@
+// test_window.c - Window manager operations, checked on the screen
+#include "host.h"
+#include "../kernel/include/window.h"
+#include "../kernel/include/vga.h"
+#include "../kernel/include/string.h"
+
+#define DESKTOP_COLOR VGA_COLOR(7, 1)
+#define FOCUS_COLOR VGA_COLOR(15, 4)
+
+// What the desktop loop does once per frame
+static void frame(void) {
+    draw_all_windows();
+    vga_present();
+}
+
+static char char_at(int x, int y) {
+    return (char)(host_screen_cell(x, y) & 0xFF);
+}
+
+static uint8_t color_at(int x, int y) {
+    return (uint8_t)(host_screen_cell(x, y) >> 8);
+}
+
+// Cells drawn by the last frame, 0 if it had no damage
+static uint32_t frame_cells(void) {
+    CompositorStats before, after;
+    wm_get_stats(&before);
+    frame();
+    wm_get_stats(&after);
+    return after.frames == before.frames ? 0 : after.last_frame_cells;
+}
+
+static int screen_has(int x, int y, const char* text) {
+    for (int i = 0; text[i] != '\0'; i++) {
+        if (char_at(x + i, y) != text[i]) return 0;
+    }
+    return 1;
+}
+
+static void test_create(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    int a = create_window(5, 3, 20, 8, "Alpha", VGA_COLOR(0, 15));
+    int b = create_window(40, 10, 30, 10, "Beta", VGA_COLOR(0, 11));
+    CHECK_EQ(a, 0);
+    CHECK_EQ(b, 1);
+    frame();
+
+    Window* win = get_window(a);
+    CHECK(win != 0);
+    CHECK(win->x == 5 && win->y == 3 && win->width == 20 && win->height == 8);
+    CHECK(strcmp(win->title, "Alpha") == 0);
+    CHECK(get_window(7) == 0);
+    CHECK(get_window(-1) == 0);
+    CHECK_EQ(get_focused_window(), -1);
+
+    // Border, title and interior
+    CHECK_EQ(char_at(5, 3), '+');
+    CHECK_EQ(char_at(24, 3), '+');
+    CHECK_EQ(char_at(5, 10), '+');
+    CHECK_EQ(char_at(5, 5), '|');
+    CHECK_EQ(char_at(10, 10), '-');
+    CHECK(screen_has(7, 3, "Alpha"));
+    CHECK(screen_has(42, 10, "Beta"));
+    CHECK_EQ(char_at(10, 5), ' ');
+    CHECK_EQ(color_at(5, 3), VGA_COLOR(0, 15));
+
+    // The desktop around them
+    CHECK_EQ(char_at(0, 1), ' ');
+    CHECK_EQ(color_at(0, 1), DESKTOP_COLOR);
+    CHECK_EQ(color_at(4, 3), DESKTOP_COLOR);
+
+    // Long titles are cut at the border
+    int c = create_window(0, 20, 10, 3, "A very long title", VGA_COLOR(0, 7));
+    frame();
+    CHECK(screen_has(2, 20, "A very "));
+    CHECK_EQ(char_at(9, 20), '+');
+    CHECK(strlen(get_window(c)->title) < 32);
+}
+
+static void test_focus_and_stacking(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    int a = create_window(10, 5, 20, 8, "A", VGA_COLOR(0, 15));
+    int b = create_window(20, 8, 20, 8, "B", VGA_COLOR(0, 11));
+    frame();
+
+    // B is on top: it owns the overlap
+    CHECK_EQ(char_at(20, 8), '+');
+    CHECK_EQ(color_at(25, 10), VGA_COLOR(0, 11));
+
+    focus_window(a);
+    frame();
+    CHECK_EQ(get_focused_window(), a);
+    CHECK(get_window(a)->focused);
+    CHECK_EQ(color_at(10, 5), FOCUS_COLOR);
+    CHECK_EQ(char_at(29, 9), '|');          // A raised over B
+    CHECK_EQ(color_at(29, 9), FOCUS_COLOR);
+
+    focus_window(b);
+    frame();
+    CHECK_EQ(get_focused_window(), b);
+    CHECK(!get_window(a)->focused);
+    CHECK_EQ(color_at(10, 5), VGA_COLOR(0, 15));
+    CHECK_EQ(char_at(29, 9), ' ');          // Inside B again
+    focus_window(99);
+    CHECK_EQ(get_focused_window(), b);
+
+    // Cycling sends the top window to the bottom
+    int c = create_window(0, 2, 15, 5, "C", VGA_COLOR(0, 7));
+    focus_window(c);
+    cycle_focus();
+    CHECK(get_focused_window() != c);
+    cycle_focus();
+    cycle_focus();
+    CHECK_EQ(get_focused_window(), c);
+
+    // Refocusing the focused window draws nothing
+    frame();
+    focus_window(c);
+    CHECK_EQ(frame_cells(), 0u);
+}
+
+static void test_move_and_title(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    int a = create_window(10, 5, 20, 8, "Mover", VGA_COLOR(0, 15));
+    frame();
+    move_window(a, 40, 12);
+    frame();
+    CHECK(get_window(a)->x == 40 && get_window(a)->y == 12);
+    CHECK_EQ(color_at(10, 5), DESKTOP_COLOR);
+    CHECK_EQ(char_at(10, 5), ' ');
+    CHECK(screen_has(42, 12, "Mover"));
+
+    // Moving to the same place repaints nothing
+    move_window(a, 40, 12);
+    CHECK_EQ(frame_cells(), 0u);
+
+    set_window_title(a, "Renamed");
+    CHECK(frame_cells() <= 20u);            // Just the top border
+    CHECK(screen_has(42, 12, "Renamed"));
+    CHECK(strcmp(get_window(a)->title, "Renamed") == 0);
+
+    // Operations on missing windows are ignored
+    move_window(50, 0, 0);
+    set_window_title(50, "x");
+    add_window_text(50, "x");
+    window_set_row(50, 0, "x", 1);
+    window_scroll_rows(50, 0, 5, 1);
+    close_window(50);
+    draw_window(50);
+    CHECK_EQ(frame_cells(), 0u);
+}
+
+static void test_text_rows(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    int a = create_window(10, 5, 30, 12, "Text", VGA_COLOR(0, 15));
+    add_window_text(a, "first line");
+    add_window_text(a, "second line");
+    frame();
+    CHECK_EQ(get_window(a)->text_line_count, 2);
+    CHECK(screen_has(11, 6, "first line"));
+    CHECK(screen_has(11, 7, "second line"));
+
+    // Re-adding the same text draws nothing
+    clear_window_text(a);
+    add_window_text(a, "first line");
+    add_window_text(a, "second line");
+    CHECK_EQ(frame_cells(), 0u);
+
+    // A changed row repaints only the columns that differ
+    window_set_row(a, 0, "first LINE", 10);
+    CHECK_EQ(frame_cells(), 4u);
+    CHECK(screen_has(11, 6, "first LINE"));
+
+    // Text is clipped to the interior
+    window_set_row(a, 2, "0123456789012345678901234567890123456789", 40);
+    frame();
+    CHECK(screen_has(11, 8, "0123456789012345678901234567"));
+    CHECK_EQ(char_at(39, 8), '|');
+
+    // Dropped rows are blanked by the next frame
+    window_clear_rows(a, 1);
+    CHECK_EQ(get_window(a)->text_line_count, 1);
+    frame();
+    CHECK(screen_has(11, 6, "first LINE"));
+    CHECK_EQ(char_at(11, 7), ' ');
+    CHECK_EQ(char_at(11, 8), ' ');
+
+    // Setting a row past the end leaves blank rows in between
+    window_set_row(a, 4, "fifth", 5);
+    frame();
+    CHECK_EQ(get_window(a)->text_line_count, 5);
+    CHECK(screen_has(11, 10, "fifth"));
+    window_set_row(a, MAX_WINDOW_TEXT_LINES, "out", 3);
+    CHECK_EQ(get_window(a)->text_line_count, 5);
+}
+
+static void test_scroll_rows(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    int a = create_window(0, 2, 40, 10, "Scroll", VGA_COLOR(0, 15));
+    char line[8] = "row ";
+    for (int i = 0; i < 6; i++) {
+        line[4] = '0' + i;
+        window_set_row(a, i, line, 5);
+    }
+    frame();
+
+    // Up by two: rows 2..5 move to 0..3, rows 4 and 5 become blank
+    window_scroll_rows(a, 0, 6, -2);
+    frame();
+    CHECK(screen_has(1, 3, "row 2"));
+    CHECK(screen_has(1, 6, "row 5"));
+    CHECK_EQ(char_at(1, 7), ' ');
+    CHECK_EQ(char_at(1, 8), ' ');
+
+    // Down by one inside rows 1..3
+    window_scroll_rows(a, 1, 4, 1);
+    frame();
+    CHECK(screen_has(1, 3, "row 2"));
+    CHECK_EQ(char_at(1, 4), ' ');
+    CHECK(screen_has(1, 5, "row 3"));
+    CHECK(screen_has(1, 6, "row 4"));
+
+    // Scrolling a whole region away blanks it
+    window_scroll_rows(a, 0, 4, -10);
+    frame();
+    for (int r = 0; r < 4; r++) {
+        CHECK_EQ(char_at(1, 3 + r), ' ');
+    }
+}
+
+static void test_close(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    int a = create_window(10, 5, 20, 8, "A", VGA_COLOR(0, 15));
+    int b = create_window(20, 8, 20, 8, "B", VGA_COLOR(0, 11));
+    focus_window(b);
+    frame();
+
+    // Closing the focused window focuses the one below and uncovers it
+    close_window(b);
+    frame();
+    CHECK(get_window(b) == 0);
+    CHECK_EQ(get_focused_window(), a);
+    CHECK_EQ(char_at(29, 9), '|');
+    CHECK_EQ(color_at(35, 14), DESKTOP_COLOR);
+
+    // Ids are reused
+    CHECK_EQ(create_window(0, 2, 10, 4, "C", VGA_COLOR(0, 7)), b);
+
+    // The id table grows past its first size
+    int ids[30];
+    for (int i = 0; i < 30; i++) {
+        ids[i] = create_window(i, 2 + i % 20, 10, 4, "W", VGA_COLOR(0, 7));
+        CHECK(ids[i] >= 0);
+    }
+    CHECK(get_window(ids[29]) != 0);
+    close_window(ids[10]);
+    CHECK(get_window(ids[10]) == 0);
+    CHECK(get_window(ids[11]) != 0);
+
+    close_all_windows();
+    frame();
+    CHECK(get_window(a) == 0);
+    CHECK_EQ(get_focused_window(), -1);
+    CHECK_EQ(color_at(10, 5), DESKTOP_COLOR);
+    CHECK_EQ(create_window(0, 2, 10, 4, "D", VGA_COLOR(0, 7)), 0);
+}
+
+static void test_damage_and_desktop(void) {
+    host_boot(HOST_DISK_SECTORS);
+
+    int a = create_window(10, 5, 20, 8, "A", VGA_COLOR(0, 15));
+    frame();
+    CHECK_EQ(frame_cells(), 0u);
+
+    // Each damaged cell is painted once, occluded cells never
+    wm_damage(0, 0, 80, 25);
+    CHECK_EQ(frame_cells(), 80u * 24);
+    draw_window(a);
+    vga_present();
+    CHECK_EQ(frame_cells(), 0u);
+    wm_damage(12, 6, 4, 2);
+    CHECK_EQ(frame_cells(), 8u);
+
+    // Desktop text shows only where no window covers it
+    desktop_puts("desktop text here", VGA_COLOR(14, 1), 2, 5);
+    frame();
+    CHECK(screen_has(2, 5, "desktop "));
+    CHECK_EQ(char_at(10, 5), '+');
+    move_window(a, 40, 5);
+    frame();
+    CHECK(screen_has(2, 5, "desktop text here"));
+    CHECK_EQ(color_at(2, 5), VGA_COLOR(14, 1));
+
+    desktop_fill(0, 20, 80, 2, '#', VGA_COLOR(2, 1));
+    frame();
+    CHECK_EQ(char_at(0, 20), '#');
+    CHECK_EQ(char_at(79, 21), '#');
+    CHECK_EQ(char_at(0, 22), ' ');
+
+    // Row 0 belongs to the menu bar
+    wm_damage(0, 0, 80, 1);
+    CHECK_EQ(frame_cells(), 0u);
+}
+
+void test_window(void) {
+    test_create();
+    test_focus_and_stacking();
+    test_move_and_title();
+    test_text_rows();
+    test_scroll_rows();
+    test_close();
+    test_damage_and_desktop();
+}
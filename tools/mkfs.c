@@ -0,0 +1,210 @@
+// mkfs.c - Build a VinFS file system into the OS image on the host
+//
+// Usage: mkfs.vinfs <image> <size_kb> [directory]
+//
+// Formats size_kb of VinFS at FS_START_LBA inside the image, after the
+// boot sector and kernel, and copies the directory tree into its root.
+// The file system code is kernel/filesystem.c itself; this file only
+// supplies the ata_* functions, backed by the image file, and maps the
+// kernel heap onto malloc. The tool is single-threaded, so the file
+// system mutex does nothing.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "../kernel/include/filesystem.h"
+#include "../kernel/include/ata.h"
+#include "../kernel/include/bcache.h"
+#include "../kernel/include/heap.h"
+#include "../kernel/include/sched.h"
+
+static FILE* image;
+static uint32_t image_sectors;
+
+int ata_init(void) {
+    return image ? 0 : -1;
+}
+
+uint32_t ata_sector_count(void) {
+    return image_sectors;
+}
+
+int ata_read(uint32_t lba, uint32_t count, void* buffer) {
+    if (lba + count > image_sectors) return -1;
+    if (fseek(image, (long)lba * ATA_SECTOR_SIZE, SEEK_SET) != 0) return -1;
+
+    size_t want = (size_t)count * ATA_SECTOR_SIZE;
+    size_t got = fread(buffer, 1, want, image);
+    memset((char*)buffer + got, 0, want - got);  // Past the end reads as zeros
+    return 0;
+}
+
+int ata_write(uint32_t lba, uint32_t count, const void* buffer) {
+    if (lba + count > image_sectors) return -1;
+    if (fseek(image, (long)lba * ATA_SECTOR_SIZE, SEEK_SET) != 0) return -1;
+
+    size_t want = (size_t)count * ATA_SECTOR_SIZE;
+    return fwrite(buffer, 1, want, image) == want ? 0 : -1;
+}
+
+void kmem_cache_init(KmemCache* cache, const char* name, uint32_t object_size) {
+    memset(cache, 0, sizeof(*cache));
+    cache->name = name;
+    cache->object_size = object_size;
+}
+
+void* kmem_cache_alloc(KmemCache* cache) {
+    return malloc(cache->object_size);
+}
+
+void kmem_cache_free(KmemCache* cache, void* object) {
+    (void)cache;
+    free(object);
+}
+
+void* kmalloc(uint32_t size) {
+    return malloc(size);
+}
+
+void* kzalloc(uint32_t size) {
+    return calloc(1, size);
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+void mutex_lock(Mutex* mutex) {
+    (void)mutex;
+}
+
+void mutex_unlock(Mutex* mutex) {
+    (void)mutex;
+}
+
+static int copy_file(const char* host_path, const char* fs_path) {
+    FILE* f = fopen(host_path, "rb");
+    if (!f) {
+        perror(host_path);
+        return -1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char* data = malloc(size > 0 ? size : 1);
+    if (!data || fread(data, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "mkfs: cannot read %s\n", host_path);
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    int written = fs_write_file(fs_path, data, (int)size);
+    free(data);
+    if (written != size) {
+        fprintf(stderr, "mkfs: cannot write %s (disk full?)\n", fs_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Recursively copy host_dir into fs_dir ("" is the root)
+static int copy_tree(const char* host_dir, const char* fs_dir) {
+    DIR* dir = opendir(host_dir);
+    if (!dir) {
+        perror(host_dir);
+        return -1;
+    }
+
+    struct dirent* entry;
+    int result = 0;
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;  // Also skips . and ..
+
+        if (strlen(entry->d_name) > FS_NAME_MAX) {
+            fprintf(stderr, "mkfs: name too long: %s\n", entry->d_name);
+            result = -1;
+            break;
+        }
+
+        char host_path[1024];
+        char fs_path[1024];
+        snprintf(host_path, sizeof(host_path), "%s/%s", host_dir, entry->d_name);
+        snprintf(fs_path, sizeof(fs_path), "%s%s%s", fs_dir, fs_dir[0] ? "/" : "", entry->d_name);
+
+        DIR* sub = opendir(host_path);
+        if (sub) {
+            closedir(sub);
+            if (fs_mkdir(fs_path) < 0) {
+                fprintf(stderr, "mkfs: cannot create directory %s\n", fs_path);
+                result = -1;
+            } else {
+                result = copy_tree(host_path, fs_path);
+            }
+        } else {
+            result = copy_file(host_path, fs_path);
+        }
+    }
+
+    closedir(dir);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "usage: %s <image> <size_kb> [directory]\n", argv[0]);
+        return 1;
+    }
+
+    long size_kb = atol(argv[2]);
+    if (size_kb < 32) {
+        fprintf(stderr, "mkfs: file system must be at least 32 KB\n");
+        return 1;
+    }
+
+    image = fopen(argv[1], "r+b");
+    if (!image) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // The kernel must end before the file system starts
+    fseek(image, 0, SEEK_END);
+    long existing = ftell(image);
+    if (existing > (long)FS_START_LBA * ATA_SECTOR_SIZE) {
+        fprintf(stderr, "mkfs: %s is %ld bytes, overlaps the file system at sector %d\n",
+                argv[1], existing, FS_START_LBA);
+        fclose(image);
+        return 1;
+    }
+
+    uint32_t blocks = (uint32_t)(size_kb * 1024 / FS_BLOCK_SIZE);
+    image_sectors = FS_START_LBA + blocks;
+
+    // Extend the image to its full size so every block reads back as zeros
+    char zero[ATA_SECTOR_SIZE] = {0};
+    bcache_init();
+    if (ata_write(image_sectors - 1, 1, zero) < 0 || fs_format(blocks) < 0) {
+        fprintf(stderr, "mkfs: cannot format %s\n", argv[1]);
+        fclose(image);
+        return 1;
+    }
+
+    int result = 0;
+    if (argc == 4) {
+        result = copy_tree(argv[3], "");
+    }
+
+    fclose(image);
+    if (result == 0) {
+        BcacheStats cs;
+        bcache_get_stats(&cs);
+        printf("mkfs: %ld KB VinFS at sector %d of %s (%u writes, %u KB)\n",
+               size_kb, FS_START_LBA, argv[1], cs.disk_writes, cs.bytes_written / 1024);
+    }
+    return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// mkkernel.c - Put the boot header in front of the kernel image
+//
+// Usage: mkkernel <kernel.bin> <load_address> <kernel.img> [kernel_end]
+//
+// Writes one header sector (KernelHeader, see kernel/include/bootinfo.h)
+// followed by the kernel padded to whole sectors. The bootloader reads the
+// header from LBA 1, loads that many sectors from LBA 2 to the load
+// address and checks the sum before jumping to it.
+//
+// kernel_end is the linker symbol of the same name (the Makefile takes it
+// from kernel.elf): the end of .bss, which the flat binary leaves out.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../kernel/include/bootinfo.h"
+#include "../kernel/include/filesystem.h"
+#include "../kernel/include/paging.h"
+
+#define SECTOR_SIZE 512
+#define LOW_MEMORY_END 0x100000
+
+int main(int argc, char** argv) {
+    if (argc != 4 && argc != 5) {
+        fprintf(stderr, "usage: %s <kernel.bin> <load_address> <kernel.img> [kernel_end]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+
+    uint32_t load = (uint32_t)strtoul(argv[2], 0, 0);
+    uint32_t end = argc == 5 ? (uint32_t)strtoul(argv[4], 0, 0) : load + (uint32_t)size;
+    if (end < load + (uint32_t)size) {
+        fprintf(stderr, "%s: kernel_end 0x%x is inside the image\n", argv[1], end);
+        return 1;
+    }
+    uint32_t sectors = (uint32_t)((size + SECTOR_SIZE - 1) / SECTOR_SIZE);
+
+    // Room on disk ends where the file system starts (boot sector and
+    // header come first); in memory the kernel and its .bss must stay
+    // clear of the stack guard when it is loaded below 1 MB
+    if (2 + sectors > FS_START_LBA) {
+        fprintf(stderr, "%s: %ld bytes do not fit before the file system\n", argv[1], size);
+        return 1;
+    }
+    if (load < LOW_MEMORY_END && end > KERNEL_STACK_GUARD) {
+        fprintf(stderr, "%s: kernel at 0x%x ends at 0x%x, in the stack guard at 0x%x\n",
+                argv[1], load, end, KERNEL_STACK_GUARD);
+        return 1;
+    }
+
+    uint8_t* image = calloc(sectors, SECTOR_SIZE);
+    if (!image || fread(image, 1, size, in) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+
+    uint8_t header_sector[SECTOR_SIZE];
+    KernelHeader header;
+    memset(header_sector, 0, sizeof(header_sector));
+    header.magic = KERNEL_MAGIC;
+    header.load_address = load;
+    header.sectors = sectors;
+    header.size = (uint32_t)size;
+    header.checksum = 0;
+    for (uint32_t i = 0; i < sectors * SECTOR_SIZE; i += 4) {
+        uint32_t word;
+        memcpy(&word, image + i, 4);
+        header.checksum += word;
+    }
+    memcpy(header_sector, &header, sizeof(header));
+
+    FILE* out = fopen(argv[3], "wb");
+    if (!out) {
+        perror(argv[3]);
+        return 1;
+    }
+    fwrite(header_sector, 1, SECTOR_SIZE, out);
+    fwrite(image, SECTOR_SIZE, sectors, out);
+    fclose(out);
+
+    printf("kernel: %ld bytes, %u sectors at 0x%x, checksum %08x\n",
+           size, sectors, load, header.checksum);
+    free(image);
+    return 0;
+}
@@ -0,0 +1,348 @@
+// perf.c - Boot VIN OS in headless QEMU and record its latency probes
+//
+// Usage: perfrun <image> <output.json> [rounds] [keys] [label]
+//
+// The image must hold a kernel built with PERF=1; "make perf" builds one
+// and runs this. QEMU ($QEMU, default qemu-system-i386) runs without a
+// display. The kernel's serial port is a pipe into this program, and
+// keystrokes go in through the monitor's sendkey command on a Unix
+// socket. After boot, each round opens a Terminal from the menu, types
+// and erases a letter keys times and closes the window again, waiting
+// after every key for the PERF lines it should produce (see
+// kernel/include/perf.h).
+//
+// The output is one JSON object: the label (the commit, for "make perf"),
+// a summary per metric (count, min, median, mean, max, in microseconds)
+// and the samples themselves, so runs on different commits can be
+// compared by a script.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define BOOT_TIMEOUT_MS 30000
+#define KEY_TIMEOUT_MS 3000
+#define SETTLE_MS 300
+#define KEY_HOLD_MS 20
+
+#define MAX_METRICS 16
+#define MAX_SAMPLES 4096
+
+typedef struct {
+    char name[32];
+    unsigned values[MAX_SAMPLES];
+    int count;
+} Metric;
+
+static Metric metrics[MAX_METRICS];
+static int metric_count;
+static int timeouts;
+
+static pid_t qemu_pid = -1;
+static int serial_fd = -1;
+static int monitor_fd = -1;
+static char socket_path[64];
+
+static char serial_buf[4096];
+static int serial_len;
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, 0);
+}
+
+static void stop_qemu(void) {
+    if (qemu_pid > 0) {
+        kill(qemu_pid, SIGTERM);
+        waitpid(qemu_pid, 0, 0);
+        qemu_pid = -1;
+    }
+    if (socket_path[0]) unlink(socket_path);
+}
+
+static void fail(const char* message) {
+    fprintf(stderr, "perfrun: %s\n", message);
+    stop_qemu();
+    exit(1);
+}
+
+// ---- QEMU ----
+
+static void start_qemu(const char* qemu, const char* image) {
+    int out[2];
+    if (pipe(out) < 0) fail("pipe failed");
+
+    char drive[512];
+    char monitor[128];
+    snprintf(drive, sizeof(drive), "format=raw,file=%s", image);
+    snprintf(socket_path, sizeof(socket_path), "/tmp/vin-perf-%d.sock", (int)getpid());
+    snprintf(monitor, sizeof(monitor), "unix:%s,server,nowait", socket_path);
+    unlink(socket_path);
+
+    qemu_pid = fork();
+    if (qemu_pid < 0) fail("fork failed");
+    if (qemu_pid == 0) {
+        // Serial on stdout; stdin is not a terminal QEMU could take over
+        int null = open("/dev/null", O_RDONLY);
+        dup2(null, 0);
+        dup2(out[1], 1);
+        close(out[0]);
+        close(out[1]);
+        execlp(qemu, qemu, "-display", "none", "-no-reboot",
+               "-drive", drive, "-serial", "stdio", "-monitor", monitor, (char*)0);
+        fprintf(stderr, "perfrun: cannot run %s: %s\n", qemu, strerror(errno));
+        _exit(127);
+    }
+    close(out[1]);
+    serial_fd = out[0];
+}
+
+static int qemu_exited(void) {
+    return qemu_pid > 0 && waitpid(qemu_pid, 0, WNOHANG) == qemu_pid;
+}
+
+// Read from fd until text has been seen or timeout_ms passes
+static int read_until(int fd, const char* text, int timeout_ms) {
+    char buf[1024];
+    int len = 0;
+    long deadline = now_ms() + timeout_ms;
+    while (now_ms() < deadline) {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 50) <= 0) continue;
+        if (len == (int)sizeof(buf) - 1) {
+            memmove(buf, buf + len / 2, len - len / 2);
+            len -= len / 2;
+        }
+        int n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0) return 0;
+        len += n;
+        buf[len] = '\0';
+        if (strstr(buf, text)) return 1;
+    }
+    return 0;
+}
+
+static void connect_monitor(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    for (long deadline = now_ms() + 5000; now_ms() < deadline; sleep_ms(50)) {
+        if (qemu_exited()) {
+            qemu_pid = -1;
+            fail("QEMU exited during startup");
+        }
+        monitor_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(monitor_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            if (!read_until(monitor_fd, "(qemu)", 2000)) fail("no prompt from the QEMU monitor");
+            return;
+        }
+        close(monitor_fd);
+        monitor_fd = -1;
+    }
+    fail("cannot connect to the QEMU monitor");
+}
+
+static void monitor_command(const char* command) {
+    char line[128];
+    int len = snprintf(line, sizeof(line), "%s\n", command);
+    if (write(monitor_fd, line, len) != len) fail("monitor write failed");
+    read_until(monitor_fd, "(qemu)", 2000);
+}
+
+static void send_key(const char* key) {
+    char command[64];
+    snprintf(command, sizeof(command), "sendkey %s %d", key, KEY_HOLD_MS);
+    monitor_command(command);
+}
+
+// ---- Probe lines ----
+
+static Metric* find_metric(const char* name) {
+    for (int i = 0; i < metric_count; i++) {
+        if (strcmp(metrics[i].name, name) == 0) return &metrics[i];
+    }
+    if (metric_count == MAX_METRICS) return 0;
+    Metric* metric = &metrics[metric_count++];
+    snprintf(metric->name, sizeof(metric->name), "%s", name);
+    metric->count = 0;
+    return metric;
+}
+
+// Next serial line into line; 0 on timeout, -1 once QEMU is gone
+static int read_line(char* line, int size, long deadline) {
+    for (;;) {
+        char* end = memchr(serial_buf, '\n', serial_len);
+        if (end) {
+            int n = end - serial_buf;
+            snprintf(line, size, "%.*s", n, serial_buf);
+            memmove(serial_buf, end + 1, serial_len - n - 1);
+            serial_len -= n + 1;
+            return 1;
+        }
+        if (serial_len == (int)sizeof(serial_buf)) serial_len = 0;     // Not ours
+
+        long left = deadline - now_ms();
+        if (left <= 0) return 0;
+        struct pollfd p = { serial_fd, POLLIN, 0 };
+        if (poll(&p, 1, (int)left) <= 0) continue;
+        int n = read(serial_fd, serial_buf + serial_len, sizeof(serial_buf) - serial_len);
+        if (n <= 0) return -1;
+        serial_len += n;
+    }
+}
+
+// Record PERF lines until one named name arrives; 0 after timeout_ms
+static int wait_for(const char* name, int timeout_ms) {
+    long deadline = now_ms() + timeout_ms;
+    char line[256];
+    int result;
+    while ((result = read_line(line, sizeof(line), deadline)) > 0) {
+        char probe[32];
+        unsigned value;
+        int fields = sscanf(line, "PERF %31s %u", probe, &value);
+        if (fields < 1) continue;
+        if (fields == 2) {
+            Metric* metric = find_metric(probe);
+            if (metric && metric->count < MAX_SAMPLES) metric->values[metric->count++] = value;
+        }
+        if (name && strcmp(probe, name) == 0) return 1;
+    }
+    if (result < 0) {
+        qemu_pid = -1;
+        fail("QEMU exited");
+    }
+    if (name) timeouts++;
+    return 0;
+}
+
+// A key the desktop or app answers on screen
+static void press(const char* key, const char* expect) {
+    send_key(key);
+    wait_for(expect, KEY_TIMEOUT_MS);
+}
+
+// ---- Output ----
+
+static int compare_unsigned(const void* a, const void* b) {
+    unsigned x = *(const unsigned*)a, y = *(const unsigned*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void sort_samples(const Metric* m, unsigned* sorted) {
+    memcpy(sorted, m->values, m->count * sizeof(unsigned));
+    qsort(sorted, m->count, sizeof(unsigned), compare_unsigned);
+}
+
+static void write_json(FILE* out, const char* label, const char* qemu, int rounds, int keys) {
+    fprintf(out, "{\n  \"label\": \"%s\",\n  \"qemu\": \"%s\",\n", label, qemu);
+    fprintf(out, "  \"rounds\": %d,\n  \"keys_per_round\": %d,\n  \"timeouts\": %d,\n", rounds, keys, timeouts);
+
+    fprintf(out, "  \"metrics\": {");
+    for (int i = 0; i < metric_count; i++) {
+        Metric* m = &metrics[i];
+        unsigned sorted[MAX_SAMPLES];
+        sort_samples(m, sorted);
+        double sum = 0;
+        for (int j = 0; j < m->count; j++) {
+            sum += sorted[j];
+        }
+        fprintf(out, "%s\n    \"%s\": { \"count\": %d, \"min\": %u, \"median\": %u, \"mean\": %.1f, \"max\": %u }",
+                i ? "," : "", m->name, m->count, sorted[0], sorted[m->count / 2],
+                sum / m->count, sorted[m->count - 1]);
+    }
+    fprintf(out, "\n  },\n  \"samples\": {");
+    for (int i = 0; i < metric_count; i++) {
+        fprintf(out, "%s\n    \"%s\": [", i ? "," : "", metrics[i].name);
+        for (int j = 0; j < metrics[i].count; j++) {
+            fprintf(out, "%s%u", j ? ", " : "", metrics[i].values[j]);
+        }
+        fprintf(out, "]");
+    }
+    fprintf(out, "\n  }\n}\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <image> <output.json> [rounds] [keys] [label]\n", argv[0]);
+        return 1;
+    }
+    const char* image = argv[1];
+    const char* output = argv[2];
+    int rounds = argc > 3 ? atoi(argv[3]) : 5;
+    int keys = argc > 4 ? atoi(argv[4]) : 40;
+    const char* label = argc > 5 ? argv[5] : "";
+    const char* qemu = getenv("QEMU");
+    if (!qemu || !*qemu) qemu = "qemu-system-i386";
+    if (access(image, R_OK) != 0) {
+        fprintf(stderr, "perfrun: cannot read %s\n", image);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    start_qemu(qemu, image);
+    connect_monitor();
+
+    // The kernel reports boot times once its TSC calibration settles
+    printf("Booting %s...\n", image);
+    if (!wait_for("ready", BOOT_TIMEOUT_MS)) {
+        fail("no \"PERF ready\" on the serial port (kernel not built with PERF=1?)");
+    }
+
+    for (int r = 0; r < rounds; r++) {
+        printf("Round %d of %d\n", r + 1, rounds);
+
+        // Menu, then the third entry: Terminal
+        press("f1", "key_to_vga_us");
+        press("right", "key_to_vga_us");
+        press("right", "key_to_vga_us");
+        press("ret", "window_open_us");
+        wait_for(0, SETTLE_MS);
+
+        for (int k = 0; k < keys; k++) {
+            press((k & 1) ? "backspace" : "a", "key_to_vga_us");
+        }
+
+        press("delete", "window_close_us");
+        wait_for(0, SETTLE_MS);
+    }
+
+    monitor_command("quit");
+    waitpid(qemu_pid, 0, 0);
+    qemu_pid = -1;
+    stop_qemu();
+
+    FILE* out = fopen(output, "w");
+    if (!out) {
+        fprintf(stderr, "perfrun: cannot write %s\n", output);
+        return 1;
+    }
+    write_json(out, label, qemu, rounds, keys);
+    fclose(out);
+
+    for (int i = 0; i < metric_count; i++) {
+        Metric* m = &metrics[i];
+        unsigned sorted[MAX_SAMPLES];
+        sort_samples(m, sorted);
+        printf("%-22s %5d samples, median %u us\n", m->name, m->count, sorted[m->count / 2]);
+    }
+    if (timeouts) printf("%d expected probes did not arrive\n", timeouts);
+    printf("Results written to %s\n", output);
+    return 0;
+}